@@ -5,12 +5,17 @@
 #include <unordered_set>
 #include <vector>
 #include <unordered_map>
+#include <map>
 
 static constexpr int HEADER_SIZE = 3;
 static const char* DATA_DIRECTIVE = "[data]";
 static const char* PROGRAM_DIRECTIVE = "[program]";
 static const char* INCLUDE_DIRECTIVE = "#include";
 static const char* DEFINE_DIRECTIVE = "#define";
+static const char* IFDEF_DIRECTIVE = "#ifdef";
+static const char* IFNDEF_DIRECTIVE = "#ifndef";
+static const char* ELSE_DIRECTIVE = "#else";
+static const char* ENDIF_DIRECTIVE = "#endif";
 static const char LABEL_LOCAL_PREFIX = '.';
 
 struct InstrData;
@@ -81,7 +86,15 @@ std::unordered_map<std::string, uint8_t> registerNames = {
     {"rbnk",    0x0E},
     {"radr",    0x0F},
 
+    {"rtim",    0x08},
     {"rdis",    0x09},
+
+    {"rdsb",    0x03},
+    {"rdsa",    0x04},
+    {"rddb",    0x05},
+    {"rdda",    0x06},
+    {"rdln",    0x07},
+    {"rdma",    0x0C},
 };
 
 char charLower(char c) {
@@ -245,6 +258,52 @@ bool createTokenWithContext(const std::string& tokenBuffer, std::vector<Token>&
     return true;
 }
 
+// an #ifdef/#ifndef block - tokens are kept while every enclosing block is active
+struct Condition {
+    bool parentActive;
+    bool value;
+    bool inElse;
+    size_t line;
+
+    bool active() const {
+        return parentActive && (inElse ? !value : value);
+    }
+};
+
+// handle a conditional directive, or the name following #ifdef/#ifndef - false
+// if the token is not part of one
+bool parseCondition(const std::string& tokenBuffer, std::vector<Condition>& conditions,
+    const std::unordered_map<std::string, Token>& defines, const std::string& filename, size_t line,
+    std::string& conditionDirective, bool& error) {
+    bool active = conditions.empty() || conditions.back().active();
+
+    if (!conditionDirective.empty()) {
+        bool defined = defines.contains(tokenBuffer);
+        conditions.push_back(Condition{active, conditionDirective == IFDEF_DIRECTIVE ? defined : !defined, false, line});
+        conditionDirective.clear();
+    } else if (tokenBuffer == IFDEF_DIRECTIVE || tokenBuffer == IFNDEF_DIRECTIVE) {
+        conditionDirective = tokenBuffer;
+    } else if (tokenBuffer == ELSE_DIRECTIVE) {
+        if (conditions.empty() || conditions.back().inElse) {
+            printf("ERROR: Unexpected %s in file \"%s\", line %zu\n", ELSE_DIRECTIVE, filename.c_str(), line);
+            error = true;
+        } else {
+            conditions.back().inElse = true;
+        }
+    } else if (tokenBuffer == ENDIF_DIRECTIVE) {
+        if (conditions.empty()) {
+            printf("ERROR: Unexpected %s in file \"%s\", line %zu\n", ENDIF_DIRECTIVE, filename.c_str(), line);
+            error = true;
+        } else {
+            conditions.pop_back();
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
 bool tokeniseFile(const std::string& filename, std::unordered_set<std::string>& includedFiles, std::vector<Token>& tokens,
     std::unordered_map<std::string, Token>& defines) {
     if (includedFiles.contains(filename)) {
@@ -275,6 +334,11 @@ bool tokeniseFile(const std::string& filename, std::unordered_set<std::string>&
     bool parsingDefine = false;
     std::string defineName = "";
 
+    // blocks are closed in the file that opens them
+    std::vector<Condition> conditions;
+    std::string conditionDirective;
+    bool conditionError = false;
+
     for (char c : text) {
         if (parsingComment) {
             if (c == '\n') {
@@ -288,7 +352,14 @@ bool tokeniseFile(const std::string& filename, std::unordered_set<std::string>&
             && c != '.' && c != ':' && c != '[' && c != ']' && c != '#' && c != '\"'
             && c != '/' && c != '\\' && c != '_') {
             if (!tokenBuffer.empty()) {
-                if (!parsingInclude && tokenBuffer == INCLUDE_DIRECTIVE) {
+                if (!parsingInclude && !parsingDefine &&
+                    parseCondition(tokenBuffer, conditions, defines, filename, line, conditionDirective, conditionError)) {
+                    if (conditionError) {
+                        return false;
+                    }
+                } else if (!conditions.empty() && !conditions.back().active()) {
+                    // skipped
+                } else if (!parsingInclude && tokenBuffer == INCLUDE_DIRECTIVE) {
                     parsingInclude = true;
                 } else if (!parsingDefine && tokenBuffer == DEFINE_DIRECTIVE) {
                     parsingDefine = true;
@@ -313,9 +384,27 @@ bool tokeniseFile(const std::string& filename, std::unordered_set<std::string>&
         tokenBuffer += c;
     }
 
-    if (!tokenBuffer.empty() && !createTokenWithContext(tokenBuffer, tokens, includedFiles, defines, filename, line, parsingInclude,
-        parsingDefine, defineName)) {
-        return {};
+    if (!tokenBuffer.empty()) {
+        if (!parsingInclude && !parsingDefine &&
+            parseCondition(tokenBuffer, conditions, defines, filename, line, conditionDirective, conditionError)) {
+            if (conditionError) {
+                return false;
+            }
+        } else if ((conditions.empty() || conditions.back().active()) && !createTokenWithContext(tokenBuffer, tokens,
+            includedFiles, defines, filename, line, parsingInclude, parsingDefine, defineName)) {
+            return {};
+        }
+    }
+
+    if (!conditionDirective.empty()) {
+        printf("ERROR: Expected name after %s in file \"%s\", line %zu\n", conditionDirective.c_str(), filename.c_str(), line);
+        return false;
+    }
+
+    if (!conditions.empty()) {
+        printf("ERROR: Missing %s for block opened in file \"%s\", line %zu\n", ENDIF_DIRECTIVE, filename.c_str(),
+            conditions.back().line);
+        return false;
     }
 
     tokens[tokens.size() - 1].lastInFile = true;
@@ -323,6 +412,11 @@ bool tokeniseFile(const std::string& filename, std::unordered_set<std::string>&
     return true;
 }
 
+struct LabelExport {
+    uint16_t addr;
+    bool data;
+};
+
 struct LabelRef {
     std::string label;
     std::string labelScope;
@@ -367,13 +461,33 @@ bool assemblePseudoOp(std::vector<Token>& tokens, std::vector<Token>::iterator&
         bytecode.push_back(0x00);
         labelRefs[bytecode.size() - 1] = LabelRef{token->str, labelScope, token->filename, token->line, false, true};
 
+        return true;
+    } else if (token->str == "wait") {
+        token++;
+        if (token == tokens.end() || token->type != TokenType::VALUE) {
+            return false;
+        }
+
+        uint8_t ticks;
+        if (!parseValue(token->str, ticks)) {
+            return false;
+        }
+
+        bytecode.push_back(instructionData.at("imm").opcode | registerNames.at("rtim"));
+        bytecode.push_back(ticks);
+
+        return true;
+    } else if (token->str == "vsync") {
+        bytecode.push_back(instructionData.at("imm").opcode | registerNames.at("rtim"));
+        bytecode.push_back(0x00);
+
         return true;
     }
 
     return false;
 }
 
-std::vector<uint8_t> assemble(const std::string& filename) {
+std::vector<uint8_t> assemble(const std::string& filename, std::map<std::string, LabelExport>& labelExports) {
     std::vector<Token> tokens;
     std::unordered_set<std::string> includedFiles;
     std::unordered_map<std::string, Token> defines;
@@ -402,6 +516,7 @@ std::vector<uint8_t> assemble(const std::string& filename) {
                     }
 
                     labelDefsLocal[labelScope][token->str.substr(0, token->str.size() - 1)] = bytecode.size();
+                    labelExports[labelScope.substr(0, labelScope.size() - 1) + token->str.substr(0, token->str.size() - 1)] = {(uint16_t)bytecode.size(), false};
                 } else {
                     printf("ERROR: Cannot define local label in data section. File \"%s\", on line %zu: %s\n", token->filename.c_str(), token->line, token->str.c_str());
                     return {};
@@ -417,6 +532,7 @@ std::vector<uint8_t> assemble(const std::string& filename) {
                 }
     
                 labelDefs[token->str.substr(0, token->str.size() - 1)] = bytecode.size();
+                labelExports[token->str.substr(0, token->str.size() - 1)] = {(uint16_t)bytecode.size(), !programMode};
             }
 
             token++;
@@ -564,7 +680,8 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    std::vector<uint8_t> bytecode = assemble(argv[1]);
+    std::map<std::string, LabelExport> labelExports;
+    std::vector<uint8_t> bytecode = assemble(argv[1], labelExports);
 
     if (bytecode.empty()) {
         return 1;
@@ -578,5 +695,15 @@ int main(int argc, char** argv) {
     }
     outFile.close();
 
+    // label address map for tooling, one "addr code|data name" per line, local labels as scope.label
+    std::ofstream labelFile(filename.substr(0, filename.find_last_of('.')) + ".labels");
+
+    for (auto& [name, label] : labelExports) {
+        char addr[8];
+        snprintf(addr, sizeof(addr), "%04x", label.addr);
+        labelFile << addr << (label.data ? " data " : " code ") << name << "\n";
+    }
+    labelFile.close();
+
     return 0;
 }
\ No newline at end of file
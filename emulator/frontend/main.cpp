@@ -0,0 +1,447 @@
+#include <SDL2/SDL.h>
+#include <SDL_ttf.h>
+
+#include <stdio.h>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <thread>
+
+#include "bjtcpu.hpp"
+#include "triplebuffer.hpp"
+#include "spscqueue.hpp"
+
+// printable ASCII rasterised once into a single texture, so HUD text costs
+// one SDL_RenderCopy per character and no allocation per frame
+struct glyph_atlas {
+    static constexpr int FIRST = 32;
+    static constexpr int COUNT = 127 - FIRST;
+
+    SDL_Texture* texture = NULL;
+    std::array<SDL_Rect, COUNT> rects{};
+    std::array<int, COUNT> advances{};
+};
+
+bool buildGlyphAtlas(SDL_Renderer* renderer, TTF_Font* font, glyph_atlas& atlas) {
+    std::array<SDL_Surface*, glyph_atlas::COUNT> glyphs{};
+
+    int width = 0;
+    int height = 0;
+    for (int i = 0; i < glyph_atlas::COUNT; i++) {
+        Uint16 ch = glyph_atlas::FIRST + i;
+        glyphs[i] = TTF_RenderGlyph_Shaded(font, ch, SDL_Color{255, 255, 255, 255}, SDL_Color{0, 0, 0, 255});
+        if (!glyphs[i]) {
+            continue;
+        }
+
+        int minX, maxX, minY, maxY;
+        TTF_GlyphMetrics(font, ch, &minX, &maxX, &minY, &maxY, &atlas.advances[i]);
+
+        atlas.rects[i] = SDL_Rect{width, 0, glyphs[i]->w, glyphs[i]->h};
+        width += glyphs[i]->w;
+        height = std::max(height, glyphs[i]->h);
+    }
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, std::max(width, 1), std::max(height, 1), 32, SDL_PIXELFORMAT_ARGB8888);
+    if (surface) {
+        for (int i = 0; i < glyph_atlas::COUNT; i++) {
+            if (glyphs[i]) {
+                SDL_BlitSurface(glyphs[i], NULL, surface, &atlas.rects[i]);
+            }
+        }
+
+        atlas.texture = SDL_CreateTextureFromSurface(renderer, surface);
+        SDL_FreeSurface(surface);
+    }
+
+    for (SDL_Surface* glyph : glyphs) {
+        if (glyph) {
+            SDL_FreeSurface(glyph);
+        }
+    }
+
+    return atlas.texture != NULL;
+}
+
+void drawText(SDL_Renderer* renderer, const glyph_atlas& atlas, const std::string& text, int x, int y) {
+    for (char c : text) {
+        int i = (uint8_t)c - glyph_atlas::FIRST;
+        if (i < 0 || i >= glyph_atlas::COUNT) {
+            continue;
+        }
+
+        const SDL_Rect& src = atlas.rects[i];
+        SDL_Rect dest{x, y, src.w, src.h};
+        SDL_RenderCopy(renderer, atlas.texture, &src, &dest);
+        x += atlas.advances[i];
+    }
+}
+
+// register values for the HUD, published by the CPU thread
+struct cpu_snapshot {
+    uint16_t pc;
+    std::array<uint8_t, 3> instrReg;
+    std::array<uint8_t, 0x10> regFile;
+    uint64_t cycles;
+
+    #if BJTCPU_MEMSTATS
+    uint8_t peakSP;
+    uint32_t peakCallDepth;
+    uint64_t bankSwitches;
+    #endif
+};
+
+// packed 4 bit pixels, expanded to host colours by the render thread
+using cpu_framebuffer = std::array<uint8_t, BJTCPU_DISPLAY_PIXELS / 2>;
+using cpu_heatmap = std::array<uint32_t, 256 * 256>;
+
+enum class cpu_command : uint8_t {
+    QUIT,
+    RESET,
+    PAUSE,
+    HEATMAP,
+    STEP_BACK,      // one cycle
+    REWIND,         // one second
+    BACK_TO_WRITE   // last write to the address in rbnk:radr
+};
+
+// state shared between the two threads, all lock-free
+struct cpu_link {
+    bjtcpu_triple_buffer<cpu_snapshot> snapshot;
+    bjtcpu_triple_buffer<cpu_framebuffer> framebuffer;
+    bjtcpu_spsc_queue<cpu_command, 64> commands;
+
+    #if BJTCPU_MEMSTATS
+    bjtcpu_triple_buffer<cpu_heatmap> heatmap;
+    #endif
+};
+
+#if BJTCPU_MEMSTATS
+// one pixel per RAM byte, x = address, y = bank - red for writes, green for reads on a log scale
+void buildHeatmap(cpu_heatmap& pixels, const bjtcpu_memstats& memstats) {
+    uint64_t maxCount = 1;
+    for (int bank = 0; bank < 0x100; bank++) {
+        for (int addr = 0; addr < 0x100; addr++) {
+            maxCount = std::max({maxCount, memstats.getReads(bank, addr), memstats.getWrites(bank, addr)});
+        }
+    }
+
+    float scale = 255.0f / std::log2((float)maxCount + 1);
+
+    for (int bank = 0; bank < 0x100; bank++) {
+        for (int addr = 0; addr < 0x100; addr++) {
+            uint32_t r = std::log2((float)memstats.getWrites(bank, addr) + 1) * scale;
+            uint32_t g = std::log2((float)memstats.getReads(bank, addr) + 1) * scale;
+            pixels[bank * 0x100 + addr] = (r << 16) | (g << 8);
+        }
+    }
+}
+#endif
+
+#if BJTCPU_EXT_DISPLAY
+// palette expansion straight into the streaming texture, a row at a time as the pitch may be padded
+void updateDisplayTexture(SDL_Texture* texture, const cpu_framebuffer& framebuffer, const bjtcpu_palette& palette) {
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture, NULL, &pixels, &pitch) != 0) {
+        return;
+    }
+
+    for (int y = 0; y < BJTCPU_DISPLAY_HEIGHT; y++) {
+        uint32_t* row = (uint32_t*)((uint8_t*)pixels + y * pitch);
+        expandPixels(framebuffer.data() + y * BJTCPU_DISPLAY_WIDTH / 2, BJTCPU_DISPLAY_WIDTH, row, palette);
+    }
+
+    SDL_UnlockTexture(texture);
+}
+#endif
+
+void publish(bjtcpu& cpu, cpu_link& link, bool heatmap) {
+    cpu_snapshot& snapshot = link.snapshot.getBack();
+    snapshot.pc = cpu.getPCValue();
+    for (int i = 0; i < 3; i++) {
+        snapshot.instrReg[i] = cpu.getIRValue(i);
+    }
+    for (int i = 0; i < 0x10; i++) {
+        snapshot.regFile[i] = cpu.getRegValue(i);
+    }
+    snapshot.cycles = cpu.getCycleCount();
+
+    #if BJTCPU_MEMSTATS
+    snapshot.peakSP = cpu.getMemStats().getPeakSP();
+    snapshot.peakCallDepth = cpu.getMemStats().getPeakCallDepth();
+    snapshot.bankSwitches = cpu.getMemStats().getBankSwitches();
+
+    if (heatmap) {
+        buildHeatmap(link.heatmap.getBack(), cpu.getMemStats());
+        link.heatmap.publish();
+    }
+    #endif
+
+    link.snapshot.publish();
+
+    #if BJTCPU_EXT_DISPLAY
+    // the renderer only uploads a new texture when a framebuffer is published
+    bjtcpu_display& display = cpu.getDisplay();
+    if (display.isDirty()) {
+        const uint8_t* pixels = display.getPixels();
+        std::copy(pixels, pixels + BJTCPU_DISPLAY_PIXELS / 2, link.framebuffer.getBack().begin());
+        link.framebuffer.publish();
+        display.clearDirty();
+    }
+    #endif
+}
+
+// runs the CPU at CLOCK_SPEED independently of the render loop
+void cpuThread(bjtcpu& cpu, cpu_link& link) {
+    constexpr int CLOCK_SPEED = 100;
+    constexpr float MAX_STEP_TIME = 1.0f / CLOCK_SPEED;
+
+    // longest the thread blocks on a timer wait before checking for commands
+    constexpr float MAX_WAIT_TIME = 0.05f;
+
+    auto now = std::chrono::high_resolution_clock::now();
+    auto last = now;
+
+    float stepTime = 0;
+    bool paused = false;
+    bool heatmap = false;
+
+    publish(cpu, link, heatmap);
+
+    bool running = true;
+    while (running) {
+        bool changed = false;
+
+        cpu_command command;
+        while (link.commands.pop(command)) {
+            switch (command) {
+                case cpu_command::QUIT:
+                    running = false;
+                    break;
+                case cpu_command::RESET:
+                    cpu.reset();
+                    changed = true;
+                    break;
+                case cpu_command::PAUSE:
+                    paused = !paused;
+                    break;
+                case cpu_command::HEATMAP:
+                    heatmap = !heatmap;
+                    break;
+                #if BJTCPU_REWIND
+                case cpu_command::STEP_BACK:
+                    paused = true;
+                    changed |= cpu.stepBack();
+                    break;
+                case cpu_command::REWIND:
+                    paused = true;
+                    changed |= cpu.seek(cpu.getCycleCount() > CLOCK_SPEED ? cpu.getCycleCount() - CLOCK_SPEED : 0);
+                    break;
+                case cpu_command::BACK_TO_WRITE:
+                    paused = true;
+                    changed |= cpu.runBackToWrite(cpu.getRegValue(REG_BNK), cpu.getRegValue(REG_ADDR));
+                    break;
+                #endif
+                default:
+                    break;
+            }
+        }
+
+        last = now;
+        now = std::chrono::high_resolution_clock::now();
+        stepTime += std::chrono::duration_cast<std::chrono::microseconds>(now - last).count() / 1000000.0f;
+
+        if (paused) {
+            stepTime = 0;
+        }
+
+        while (stepTime >= MAX_STEP_TIME) {
+            cpu.step();
+            stepTime -= MAX_STEP_TIME;
+            changed = true;
+        }
+
+        if (changed) {
+            publish(cpu, link, heatmap);
+        }
+
+        // halted until a timer event - block until about when it is due rather
+        // than polling, the cycles are stepped through once the time has passed
+        if (!paused && cpu.isWaiting()) {
+            float waitTime = cpu.getWaitCycles() * MAX_STEP_TIME - stepTime;
+            std::this_thread::sleep_for(std::chrono::duration<float>(std::clamp(waitTime, 0.0f, MAX_WAIT_TIME)));
+        } else if (!changed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Must provide ROM file\n");
+        return 1;
+    }
+
+    bjtcpu cpu;
+
+    std::fstream file(argv[1], std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        printf("Could not open ROM file \"%s\"\n", argv[1]);
+        return 1;
+    }
+
+    file.seekg(0, std::ios::end);
+    size_t fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    std::vector<uint8_t> romBin(fileSize, 0);
+    file.read((char*)&romBin[0], fileSize);
+
+    cpu.loadROM(romBin.data(), romBin.size());
+    printf("Loaded ROM of %zu bytes\n", fileSize);
+
+    SDL_Init(SDL_INIT_VIDEO);
+    TTF_Init();
+
+    SDL_Window* window = SDL_CreateWindow("bjtcpu-emu", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 800, 600, 0);
+    SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, 0);
+
+    TTF_Font* font = TTF_OpenFont("Rubik-Regular.ttf", 24);
+    if (!font) {
+        printf("ERROR: Could not load font\n");
+        return 1;
+    }
+
+    glyph_atlas atlas;
+    if (!buildGlyphAtlas(renderer, font, atlas)) {
+        printf("ERROR: Could not build glyph atlas\n");
+        return 1;
+    }
+
+    #if BJTCPU_EXT_DISPLAY
+    SDL_Texture* displayTex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, BJTCPU_DISPLAY_WIDTH, BJTCPU_DISPLAY_HEIGHT);
+    bjtcpu_palette palette = greyscalePalette();
+    #endif
+
+    #if BJTCPU_MEMSTATS
+    SDL_Texture* heatmapTex = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGB888, SDL_TEXTUREACCESS_STREAMING, 256, 256);
+    bool showHeatmap = false;
+    #endif
+
+    // the CPU owns cpu from here on, the render loop only sees what it publishes
+    // heap allocated, the triple buffers are too large for the stack
+    std::unique_ptr<cpu_link> linkPtr = std::make_unique<cpu_link>();
+    cpu_link& link = *linkPtr;
+    std::thread cpuWorker(cpuThread, std::ref(cpu), std::ref(link));
+
+    bool running = true;
+    while (running) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event)) {
+            if (event.type == SDL_QUIT) {
+                running = false;
+            }
+
+            if (event.type == SDL_KEYDOWN) {
+                switch (event.key.keysym.sym) {
+                    case SDLK_r:
+                        link.commands.push(cpu_command::RESET);
+                        break;
+                    case SDLK_SPACE:
+                        link.commands.push(cpu_command::PAUSE);
+                        break;
+                    #if BJTCPU_REWIND
+                    case SDLK_LEFT:
+                        link.commands.push(cpu_command::STEP_BACK);
+                        break;
+                    case SDLK_BACKSPACE:
+                        link.commands.push(cpu_command::REWIND);
+                        break;
+                    case SDLK_w:
+                        link.commands.push(cpu_command::BACK_TO_WRITE);
+                        break;
+                    #endif
+                    #if BJTCPU_MEMSTATS
+                    case SDLK_h:
+                        showHeatmap = !showHeatmap;
+                        link.commands.push(cpu_command::HEATMAP);
+                        break;
+                    #endif
+                    default:
+                        break;
+                }
+            }
+        }
+
+        link.snapshot.update();
+        const cpu_snapshot& snapshot = link.snapshot.getFront();
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0);
+        SDL_RenderClear(renderer);
+
+        drawText(renderer, atlas, std::format("PC {:x}", snapshot.pc), 10, 10);
+
+        drawText(renderer, atlas, std::format("IR0 {:x}", snapshot.instrReg[0]), 10, 40);
+        drawText(renderer, atlas, std::format("IR1 {:x}", snapshot.instrReg[1]), 10, 70);
+        drawText(renderer, atlas, std::format("IR2 {:x}", snapshot.instrReg[2]), 10, 100);
+
+        drawText(renderer, atlas, std::format("RA {:x}", snapshot.regFile[REG_A]), 10, 140);
+        drawText(renderer, atlas, std::format("RB {:x}", snapshot.regFile[REG_B]), 10, 170);
+        drawText(renderer, atlas, std::format("RC {:x}", snapshot.regFile[REG_C]), 10, 200);
+
+        drawText(renderer, atlas, std::format("RSP {:x}", snapshot.regFile[REG_SP]), 10, 240);
+        drawText(renderer, atlas, std::format("RBP {:x}", snapshot.regFile[REG_BP]), 10, 270);
+
+        drawText(renderer, atlas, std::format("RBNK {:x}", snapshot.regFile[REG_BNK]), 10, 340);
+        drawText(renderer, atlas, std::format("RADDR {:x}", snapshot.regFile[REG_ADDR]), 10, 370);
+
+        #if BJTCPU_EXT_DISPLAY
+        {
+            // only a newly published framebuffer is uploaded
+            if (link.framebuffer.update()) {
+                updateDisplayTexture(displayTex, link.framebuffer.getFront(), palette);
+            }
+            SDL_Rect rect{300, 20, 320, 320};
+            SDL_RenderCopy(renderer, displayTex, NULL, &rect);
+        }
+        #endif
+
+        #if BJTCPU_MEMSTATS
+        drawText(renderer, atlas, std::format("PEAK SP {:x}", snapshot.peakSP), 10, 440);
+        drawText(renderer, atlas, std::format("PEAK DEPTH {}", snapshot.peakCallDepth), 10, 470);
+        drawText(renderer, atlas, std::format("BNK SW {}", snapshot.bankSwitches), 10, 500);
+
+        if (showHeatmap) {
+            if (link.heatmap.update()) {
+                SDL_UpdateTexture(heatmapTex, NULL, link.heatmap.getFront().data(), 256 * sizeof(uint32_t));
+            }
+            SDL_Rect rect{300, 20, 480, 480};
+            SDL_RenderCopy(renderer, heatmapTex, NULL, &rect);
+        }
+        #endif
+
+        SDL_RenderPresent(renderer);
+    }
+
+    link.commands.push(cpu_command::QUIT);
+    cpuWorker.join();
+
+    #if BJTCPU_MEMSTATS
+    SDL_DestroyTexture(heatmapTex);
+    #endif
+
+    #if BJTCPU_EXT_DISPLAY
+    SDL_DestroyTexture(displayTex);
+    #endif
+
+    SDL_DestroyTexture(atlas.texture);
+
+    SDL_Quit();
+
+    return 0;
+}
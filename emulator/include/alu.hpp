@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+
+#include "opcodes.hpp"
+
+// FLAGS produced by an ALU result, shared by every execution path
+inline uint8_t aluFlags(uint8_t lastValue, uint8_t value, bool add) {
+    uint8_t flags = 0;
+
+    if (value == 0) {
+        flags |= (1 << FLAG_ZBIT);
+    }
+
+    if (value > 0x7F) {
+        flags |= (1 << FLAG_NBIT);
+
+        if (lastValue <= 0x7F) {
+            flags |= (1 << FLAG_OBIT);
+        }
+    }
+
+    if (add && lastValue > value) {
+        flags |= (1 << FLAG_CBIT);
+    }
+
+    return flags;
+}
+
+// FLAGS kept as the inputs of the last ALU op and only evaluated when read -
+// most results are overwritten before a jump, addc or subc looks at them
+class bjtcpu_lazy_flags {
+public:
+    inline void update(uint8_t lastValue, uint8_t value, bool add) {
+        this->lastValue = lastValue;
+        this->value = value;
+        source = add ? ADD : COMPARE;
+    }
+
+    // architectural value from a snapshot, kept as is
+    inline void load(uint8_t flags) {
+        value = flags;
+        source = LOADED;
+    }
+
+    // same value aluFlags() gave for the last op
+    inline uint8_t get() const {
+        return source == LOADED ? value : aluFlags(lastValue, value, source == ADD);
+    }
+
+    inline bool zero() const {
+        return source == LOADED ? FLAG_ZMASK(value) : value == 0;
+    }
+
+    inline bool negative() const {
+        return source == LOADED ? FLAG_NMASK(value) : value > 0x7F;
+    }
+
+    inline bool overflow() const {
+        return source == LOADED ? FLAG_OMASK(value) : value > 0x7F && lastValue <= 0x7F;
+    }
+
+    inline bool carry() const {
+        return source == LOADED ? FLAG_CMASK(value) : source == ADD && lastValue > value;
+    }
+
+private:
+    enum : uint8_t {
+        ADD,        // add, sub and their variants
+        COMPARE,    // cmp, never sets carry
+        LOADED      // value holds the flags themselves
+    };
+
+    uint8_t lastValue = 0;
+    uint8_t value = 0;
+    uint8_t source = LOADED;
+
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+
+#include "bjtcpu.hpp"
+
+// machine state for a ROM translated ahead of time by bjtcpu-aot. Generated code
+// calls these helpers so every instruction has the same effect, and is charged
+// the same cycles, as bjtcpu::runInstruction()
+struct bjtcpu_aot_machine {
+    std::array<uint8_t, 0x10> regFile{};
+    uint8_t flagsReg = 0;
+
+    std::array<uint8_t, 0x10000> ram{};
+    const uint8_t* rom = nullptr;
+
+    uint16_t pcReg = 0;
+    uint64_t cycleCount = 0;
+    uint64_t instrCount = 0;
+    bool stopped = false;
+
+    #if BJTCPU_EXT_DISPLAY
+    bjtcpu_display display;
+    #endif
+
+    #if BJTCPU_EXT_TIMER
+    bjtcpu_timer timer;
+    #endif
+
+    #if BJTCPU_EXT_DMA
+    bjtcpu_dma dma;
+    uint64_t dmaEnd = 0;
+    #endif
+
+    inline void retire(uint8_t cycles) {
+        cycleCount += cycles;
+        instrCount++;
+    }
+
+    inline void setReg(uint8_t reg, uint8_t value) {
+        #if BJTCPU_EXT_DISPLAY
+        if (reg == REG_DIS && value != regFile[REG_DIS]) {
+            regFile[reg] = value;
+            display.sendSignal(value);
+            return;
+        }
+        #endif
+
+        #if BJTCPU_EXT_TIMER
+        // always headless, a wait just moves the cycle count on
+        if (reg == REG_TIM) {
+            cycleCount = timer.wakeCycle(cycleCount, value);
+        }
+        #endif
+
+        #if BJTCPU_EXT_DMA
+        if (reg == REG_DMA) {
+            startDMA(value);
+            return;
+        }
+        #endif
+
+        regFile[reg] = value;
+    }
+
+    // generated before any instruction with extReg set, after its retire()
+    inline void refreshDMA() {
+        #if BJTCPU_EXT_DMA
+        regFile[REG_DMA] = cycleCount < dmaEnd ? 1 : 0;
+        #endif
+    }
+
+    #if BJTCPU_EXT_DMA
+    // bytes move at once, as in bjtcpu::startDMA()
+    inline void startDMA(uint8_t mode) {
+        uint8_t length = regFile[REG_DMA_LEN];
+        size_t bytes = length == 0 ? 0x100 : length;
+
+        std::array<uint8_t, 0x100> buffer;
+        for (size_t i = 0; i < bytes; i++) {
+            buffer[i] = mode & 1 ? regFile[REG_DMA_SRCA] : readRAM(regFile[REG_DMA_SRCB], regFile[REG_DMA_SRCA] + i);
+        }
+        for (size_t i = 0; i < bytes; i++) {
+            writeRAM(regFile[REG_DMA_DSTB], regFile[REG_DMA_DSTA] + i, buffer[i]);
+        }
+
+        dmaEnd = dma.endCycle(cycleCount, dmaEnd, length);
+        regFile[REG_DMA] = cycleCount < dmaEnd ? 1 : 0;
+    }
+    #endif
+
+    inline void alu(uint8_t dest, uint8_t value) {
+        uint8_t lastValue = regFile[dest];
+        setReg(dest, value);
+        flagsReg = aluFlags(lastValue, value, true);
+    }
+
+    inline void compare(uint8_t first, uint8_t second) {
+        flagsReg = aluFlags(first, first - second, false);
+    }
+
+    inline uint8_t carry() {
+        return FLAG_CMASK(flagsReg) ? 1 : 0;
+    }
+
+    inline uint8_t readRAM(uint8_t bank, uint8_t addr) {
+        return ram[bank * 0x100 + addr];
+    }
+
+    inline void writeRAM(uint8_t bank, uint8_t addr, uint8_t value) {
+        ram[bank * 0x100 + addr] = value;
+    }
+
+    inline uint8_t readROM(uint8_t bank, uint8_t addr) {
+        return rom[bank * 0x100 + addr];
+    }
+
+    inline void push(uint8_t value) {
+        writeRAM(0xFF, regFile[REG_SP]++, value);
+    }
+
+    inline void pop(uint8_t reg) {
+        regFile[REG_SP]--;
+        setReg(reg, readRAM(0xFF, regFile[REG_SP]));
+    }
+
+    inline uint16_t call(uint16_t returnAddr, uint16_t target) {
+        writeRAM(0xFF, regFile[REG_SP]++, regFile[REG_BP]);
+        writeRAM(0xFF, regFile[REG_SP]++, returnAddr & 0xFF);
+        writeRAM(0xFF, regFile[REG_SP]++, (returnAddr >> 8) & 0xFF);
+        regFile[REG_BP] = regFile[REG_SP];
+        return target;
+    }
+
+    inline uint16_t ret() {
+        regFile[REG_SP] = regFile[REG_BP] - 1;
+        uint16_t addr = readRAM(0xFF, regFile[REG_SP]--) << 8;
+        addr |= readRAM(0xFF, regFile[REG_SP]--);
+        regFile[REG_BP] = readRAM(0xFF, regFile[REG_SP]);
+        return addr;
+    }
+
+    inline uint16_t stop(uint16_t nextAddr) {
+        stopped = true;
+        return nextAddr;
+    }
+
+    // reached a PC with no translated entry point
+    uint16_t unknownEntry(uint16_t pc);
+};
+
+// runs the translated entry point at pc, returns the next pc
+using bjtcpu_aot_dispatch = uint16_t (*)(bjtcpu_aot_machine& m, uint16_t pc);
+
+// command line driver for translated ROMs, takes the same options as bjtcpu-run
+int bjtcpu_aot_main(int argc, char** argv, const uint8_t* rom, bjtcpu_aot_dispatch dispatch);
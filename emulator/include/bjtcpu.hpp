@@ -2,66 +2,255 @@
 
 #include <cstdint>
 #include <array>
+#include <vector>
 #include <cstring>
 #include <stdio.h>
 
 #include "opcodes.hpp"
+#include "alu.hpp"
+#include "decode.hpp"
+#include "block.hpp"
+#include "jit.hpp"
+#include "trace.hpp"
+#include "profiler.hpp"
+#include "memstats.hpp"
+#include "display.hpp"
+#include "timer.hpp"
+#include "dma.hpp"
+#include "ram.hpp"
+#include "state.hpp"
+#include "rewind.hpp"
+#include "romimage.hpp"
+#include "fuzz.hpp"
+#include "hle.hpp"
 
 #define BJTCPU_EXT_DISPLAY true
+#define BJTCPU_EXT_TIMER true
+#define BJTCPU_EXT_DMA true
 
-class bjtcpu_display {
-public:
-    bjtcpu_display();
-
-    void sendSignal(uint8_t value);
-
-    uint8_t* getFramebuffer();
+// any per-instruction or per-access hook compiled in - paths that skip them
+// are only taken when this is off
+#define BJTCPU_HOOKS (BJTCPU_PROFILE || BJTCPU_MEMSTATS || BJTCPU_REWIND || BJTCPU_FUZZ || \
+    BJTCPU_TRACE_LEVEL > BJTCPU_TRACE_NONE)
 
-private:
-    void clear();
-
-    void writePixel(uint8_t colour);
+// fused handlers skip the hooks, so sequences are only fused without them
+#define BJTCPU_FUSION (!BJTCPU_HOOKS)
 
-private:
-    std::array<uint8_t, 64 * 64 * 3> framebuffer;
+// native stdlib routines skip the same hooks
+#define BJTCPU_HLE (!BJTCPU_HOOKS)
 
-    uint8_t cursorX;
-    uint8_t cursorY;
-
-};
+// as do translated blocks compiled to native code
+#define BJTCPU_NATIVE_BLOCKS (BJTCPU_JIT && !BJTCPU_HOOKS)
 
 class bjtcpu {
 public:
     bjtcpu();
 
+    // only RAM banks written since the last reset are zeroed, so this stays
+    // cheap when called thousands of times a second
     void reset();
 
-    void loadROM(uint8_t* bytes, size_t size);
+    // reset() to a prepared baseline instead of power-on - restoring the same
+    // state repeatedly only touches banks written since the previous restore.
+    // false if the state was saved with a different ROM
+    bool resetTo(const bjtcpu_state& state);
+
+    // copies into a new image, use setROM() to share one between CPUs
+    void loadROM(const uint8_t* bytes, size_t size);
+
+    void setROM(std::shared_ptr<const bjtcpu_rom_image> image);
+    const std::shared_ptr<const bjtcpu_rom_image>& getROM();
+
+    // capture everything needed to resume from this exact cycle - cheap enough
+    // to call often, RAM is only copied as banks are written afterwards
+    bjtcpu_state saveState();
+
+    // false if the state was saved with a different ROM
+    bool loadState(const bjtcpu_state& state);
 
     void step();
 
+    // execute whole instructions - same cycle counts as step(), far less dispatch
+    void runInstruction();
+    uint64_t run(uint64_t instrs);
+    uint64_t runCycles(uint64_t cycles);
+
+    // stops at whichever budget runs out first - the last instruction may be
+    // left part way through, as with runCycles(). Returns instructions retired
+    uint64_t run(uint64_t instrs, uint64_t cycles);
+
+    // engine used by run()/runCycles() - can be swapped at any time
+    void setEngine(bjtcpu_engine engine);
+    bjtcpu_engine getEngine();
+
     uint8_t readRAM(uint8_t bank, uint8_t addr);
+
+    // copy bytes into RAM from addr, wrapping at the top - seeds a run after
+    // reset(), bypasses the stats hooks and restarts rewind history
+    void loadRAM(uint16_t addr, const uint8_t* bytes, size_t size);
     uint8_t readROM(uint8_t bank, uint8_t addr);
 
     uint8_t getRegValue(uint8_t reg);
+    uint8_t getFlagsValue();
     uint16_t getPCValue();
     uint8_t getIRValue(uint8_t idx);
 
+    uint64_t getCycleCount();
+    uint64_t getInstrCount();
+    bool isStopped();
+
+    // halted by a write to rtim until the timer event it selects - step() idles
+    // through the wait a cycle at a time, run() and runCycles() skip over it
+    bool isWaiting();
+
+    // cycles left until the event, 0 when not waiting
+    uint64_t getWaitCycles();
+
+    // times each fused sequence ran as one handler since the last reset
+    uint64_t getFusionCount(bjtcpu_fusion fusion);
+
+    // run the stdlib routines labelled in symbols natively whenever run() or
+    // runCycles() reaches their entry, with the same registers, RAM, flags and
+    // cycle count as the ROM code. Only routines whose code matches the stdlib
+    // are bound - returns how many, always 0 when BJTCPU_HLE is off. Cleared
+    // by setROM()
+    size_t enableHLE(const bjtcpu_symbols& symbols);
+    void disableHLE();
+
+    // times each routine ran natively since the last reset
+    uint64_t getHLECount(bjtcpu_hle_routine routine);
+
     #if BJTCPU_EXT_DISPLAY
     bjtcpu_display& getDisplay();
     #endif
 
+    #if BJTCPU_EXT_TIMER
+    bjtcpu_timer& getTimer();
+    #endif
+
+    #if BJTCPU_EXT_DMA
+    bjtcpu_dma& getDMA();
+
+    // cycles left until the last transfer started finishes, 0 when idle
+    uint64_t getDMACycles();
+    #endif
+
+    #if BJTCPU_TRACE_LEVEL > BJTCPU_TRACE_NONE
+    bjtcpu_trace_ring& getTrace();
+    #endif
+
+    #if BJTCPU_PROFILE
+    bjtcpu_profiler& getProfiler();
+    #endif
+
+    #if BJTCPU_MEMSTATS
+    bjtcpu_memstats& getMemStats();
+    #endif
+
+    #if BJTCPU_FUZZ
+    bjtcpu_fuzz_monitor& getFuzzMonitor();
+    #endif
+
+    #if BJTCPU_REWIND
+    bjtcpu_rewind& getRewind();
+
+    // restore the nearest keyframe and replay up to cycle, false if that is
+    // older than the oldest keyframe still held
+    bool seek(uint64_t cycle);
+
+    bool stepBack();
+
+    // seek to just after the last write to the RAM address, false if it is no
+    // longer in the delta log
+    bool runBackToWrite(uint8_t bank, uint8_t addr);
+    #endif
+
 private:
-    uint8_t getInstrLen(uint8_t opcode);
+    void restoreState(const bjtcpu_state& state);
+
+    // take a rewind keyframe if one is due
+    void keyframe();
 
     bool callFuncStep(bool funcInAddr);
     bool retFuncStep();
 
     bool pushStep(uint8_t value);
     bool popStep(uint8_t reg);
+
+    void callFunc(bool funcInAddr);
+    void retFunc();
+
+    void push(uint8_t value);
+    void pop(uint8_t reg);
+
+    void executeWhole(const bjtcpu_instr& instr);
+
+    // executeWhole() for instructions with extReg set - rdma reads as busy or
+    // idle at the cycle the instruction retires, then any wait or transfer the
+    // instruction started begins
+    void executeExt(const bjtcpu_instr& instr);
+    void handleExtWrites(const bjtcpu_instr& instr);
+
+    // runInstruction() for callers that have already skipped any wait
+    void executeNext();
+
+    // single stage instructions, shared by step() and runInstruction()
+    void execute(const bjtcpu_instr& instr);
+
+    // run translated blocks while they fit the budget, false if none could run
+    bool runBlocks(uint64_t maxCycles, uint64_t maxInstrs);
+
+    // forget the translated blocks, only touching the index entries in use
+    void clearBlocks();
+
+    #if BJTCPU_NATIVE_BLOCKS
+    // a block's compiled body, with FLAGS carried in and out of it
+    void runNative(bjtcpu_jit_fn native);
+    #endif
+
+    // run the fused sequence tagged at the PC if it fits the budget
+    bool runFused(uint64_t maxCycles, uint64_t maxInstrs);
+
+    // skip to the exit of the spin loop at the PC, or through as many whole
+    // iterations as fit the budget
+    bool runSpinLoop(uint64_t maxCycles, uint64_t maxInstrs);
+
+    // run the stdlib routine entered at the PC natively, through its ret, if
+    // its longest path for the current inputs fits the budget
+    bool runHLE(uint64_t maxCycles, uint64_t maxInstrs);
+
+    // native routines, each ends with the routine's own ret
+    void hleMultiply(const bjtcpu_hle_code& code);
+    void hleShl(const bjtcpu_hle_code& code);
+    void hleShlr(const bjtcpu_hle_code& code);
+    void hleShr(const bjtcpu_hle_code& code, const bjtcpu_hle_code& shlr);
+    void hleMemset(const bjtcpu_hle_code& code);
+    void hleMemcpy(const bjtcpu_hle_code& code);
+    void hleMemcmp(const bjtcpu_hle_code& code);
+
+    void charge(const bjtcpu_hle_cost& cost);
     
     void endCycle();
 
+    // send a display signal if the instruction just executed changed rdis
+    void updateDisplay(uint8_t lastValue);
+
+    #if BJTCPU_EXT_TIMER
+    // halt until the event selected by the value written to rtim, if the
+    // instruction (whose dest is rtim) wrote it - every write starts a wait,
+    // even of the value already there
+    void startWait(const bjtcpu_instr& instr);
+    #endif
+
+    #if BJTCPU_EXT_DMA
+    // set rdma to whether a transfer is still running at cycle
+    void refreshDMA(uint64_t cycle);
+
+    // start the transfer selected by the value written to rdma, if the
+    // instruction wrote it
+    void startDMA(const bjtcpu_instr& instr);
+    #endif
+
     void updateFlags(uint8_t lastValue, uint8_t value, bool add);
 
     void writeRAM(uint8_t bank, uint8_t addr, uint8_t value);
@@ -69,36 +258,100 @@ private:
 private:
     uint16_t pcReg;
     std::array<uint8_t, 3> instrReg;
+    uint16_t instrAddr;
     uint8_t instrFetchIdx;
     uint8_t instrStageIdx;
     
     static constexpr bool REG_WRITABLE[0x10] = {
         true, true, true,   // ra, rb, rc
-        false, false, false, false, false, false,
-        true, true, true,   // rdis, rsp, rbp
-        false, false,
+        true, true, true, true, true,   // rdsb, rdsa, rddb, rdda, rdln
+        true, true, true, true,     // rtim, rdis, rsp, rbp
+        true, false,        // rdma
         true, true          // rbnk, radr
     };
     
     static constexpr bool REG_READABLE[0x10] = {
         true, true, true,   // ra, rb, rc
-        false, false, false, false, false, false,
-        false, true, true,  // rsp, rbp
-        false, false,
+        true, true, true, true, true,   // rdsb, rdsa, rddb, rdda, rdln
+        false, false, true, true,   // rsp, rbp
+        true, false,        // rdma
         true, true          // rbnk, radr
     };
     
     std::array<uint8_t, 0x10> regFile;
 
-    uint8_t flagsReg;
+    bjtcpu_lazy_flags flags;
+
+    bjtcpu_ram ram;
+
+    // shared with every CPU running the same image - rom and decoded point
+    // into it so the hot paths index them directly
+    std::shared_ptr<const bjtcpu_rom_image> romImage;
+    const uint8_t* rom;
+    const bjtcpu_instr* decoded;
+
+    bjtcpu_engine engine;
 
-    std::array<uint8_t, 0x10000> rom;
-    std::array<uint8_t, 0x10000> ram;
+    // translated basic blocks, indexed by start PC through blockIndex (built on
+    // first use of the block engine, cleared when a ROM is loaded). The first
+    // blockCount are in use - the rest keep their storage for the next ROM, so
+    // a harness loading a new ROM every run doesn't reallocate them
+    std::vector<bjtcpu_block> blocks;
+    std::vector<int32_t> blockIndex;
+    size_t blockCount = 0;
+
+    #if BJTCPU_NATIVE_BLOCKS
+    // compiled bodies of the blocks above, freed along with them
+    bjtcpu_jit jit;
+    bjtcpu_jit_context jitContext;
+    #endif
 
     bool stopped;
 
+    // waiting on a timer event while cycleCount is below it
+    uint64_t wakeCycle;
+
+    // rdma reads as busy while cycleCount is below it
+    uint64_t dmaEnd;
+
+    uint64_t cycleCount;
+    uint64_t instrCount;
+
+    std::array<uint64_t, (size_t)bjtcpu_fusion::COUNT> fusionCounts;
+
+    bjtcpu_hle_table hle;
+    std::array<uint64_t, (size_t)bjtcpu_hle_routine::COUNT> hleCounts;
+
     #if BJTCPU_EXT_DISPLAY
     bjtcpu_display display;
     #endif
 
+    #if BJTCPU_EXT_TIMER
+    bjtcpu_timer timer;
+    #endif
+
+    #if BJTCPU_EXT_DMA
+    bjtcpu_dma dma;
+    #endif
+
+    #if BJTCPU_TRACE_LEVEL > BJTCPU_TRACE_NONE
+    bjtcpu_trace_ring trace;
+    #endif
+
+    #if BJTCPU_PROFILE
+    bjtcpu_profiler profiler;
+    #endif
+
+    #if BJTCPU_MEMSTATS
+    bjtcpu_memstats memstats;
+    #endif
+
+    #if BJTCPU_REWIND
+    bjtcpu_rewind rewind;
+    #endif
+
+    #if BJTCPU_FUZZ
+    bjtcpu_fuzz_monitor fuzz;
+    #endif
+
 };
\ No newline at end of file
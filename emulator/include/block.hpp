@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "decode.hpp"
+
+enum class bjtcpu_engine {
+    INTERPRETER,    // one decoded instruction per dispatch
+    BLOCK           // translated basic blocks, as native code where bjtcpu_jit can
+};
+
+struct bjtcpu_jit_context;
+
+// compiled block body, see bjtcpu_jit
+using bjtcpu_jit_fn = void (*)(bjtcpu_jit_context* context);
+
+// straight-line run of instructions ending at a jump, call, pcall, ret or stop
+struct bjtcpu_block {
+    std::vector<bjtcpu_instr> instrs;
+    std::vector<uint16_t> addrs;
+    uint16_t startAddr;
+    uint16_t lastAddr;  // address of the final instruction
+    uint16_t endAddr;   // address following the final instruction
+    uint32_t cycles;
+    bjtcpu_jit_fn native = nullptr;     // every instruction but the last, if compiled
+};
+
+bool isBlockEnd(const bjtcpu_instr& instr);
+
+bool writesReg(const bjtcpu_instr& instr, uint8_t reg);
+
+// register operands, and the dest of an add or subtract - its carry compares
+// against the dest's previous value
+bool readsReg(const bjtcpu_instr& instr, uint8_t reg);
+
+// translate the block starting at pc into block, reusing its storage -
+// instructions that write rdis or have extReg set are left out (the block ends
+// before them) so display signals, timer waits and DMA stay on the interpreter path
+void translateBlock(const bjtcpu_instr* decoded, uint16_t pc, bjtcpu_block& block);
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "opcodes.hpp"
+
+enum class bjtcpu_op : uint8_t {
+    NOP,
+    STOP,
+    RET,
+    PCALL,
+    PUSH,
+    STO,
+    CMP,
+    POP,
+    PLDA,
+    ADD,
+    ADDC,
+    IADD,
+    STRLA,
+    SUB,
+    SUBC,
+    ISUB,
+    LDRL,
+    IMM,
+    NAND,
+    JMP,
+    JMPZ,
+    JMPN,
+    JMPC,
+    JMPO,
+    CALL,
+    LDA
+};
+
+// fixed instruction sequences the interpreter runs as one handler - detected
+// at ROM load and tagged on the first instruction of the sequence
+enum class bjtcpu_fusion : uint8_t {
+    NONE,
+    SCRATCH_CMP,    // push rt; imm rt k; cmp rx ry; pop rt (rt is ra, rb or rc)
+    AND,            // nand d x y; nand d d d
+    CMP_BRANCH,     // cmp rx ry; jmpz/jmpn/jmpc/jmpo a; jmp b
+    SPIN_LOOP,      // loop with no side effects, fast-forwarded (see spinLoop())
+    COUNT
+};
+
+// count, len and cycles are 0 for a spin loop, whose handler checks its own budget
+struct bjtcpu_fusion_info {
+    const char* name;
+    uint8_t count;      // instructions in the sequence
+    uint8_t len;        // bytes
+    uint8_t cycles;     // longest path through it, as counted by step()
+};
+
+const bjtcpu_fusion_info& fusionInfo(bjtcpu_fusion fusion);
+
+// instruction decoded from ROM - operand nibbles are split out so the
+// execution loop never has to shift instruction bytes
+struct bjtcpu_instr {
+    bjtcpu_op op;
+    uint8_t len;
+    uint8_t cycles;     // fetch + execute stages, as counted by step()
+    uint8_t dest;       // Z
+    uint8_t srcX;       // X
+    uint8_t srcY;       // Y
+    uint8_t imm;        // immediate byte (imm, iadd, isub)
+    bjtcpu_fusion fusion;
+    bool extReg;        // writes rtim or rdma, or reads rdma - see bjtcpu::executeExt()
+    uint16_t target;    // jump/call address
+};
+
+bjtcpu_instr decodeInstr(uint8_t byte0, uint8_t byte1, uint8_t byte2);
+
+// decode an instruction starting at every one of the 0x10000 ROM addresses,
+// then tag fused sequences
+void decodeROM(const uint8_t* rom, bjtcpu_instr* decoded);
+
+// straight-line code from a loop head up to the jump back to it, exits only
+// forward past it or back before the head
+struct bjtcpu_spin_loop {
+    static constexpr uint8_t MAX_INSTRS = 16;
+
+    uint8_t count;      // instructions per iteration, the jump back included
+    uint8_t len;        // bytes
+    uint8_t backEdge;   // offset of the jump back
+    uint32_t cycles;    // one whole iteration
+    uint8_t induction;  // the one register carried between iterations, 0x10 for none
+    uint8_t step;       // added to it every iteration
+};
+
+// true if the loop at head only computes registers and flags - no RAM,
+// stack, rdis, rtim, rdma or calls - and each iteration depends on nothing it wrote
+// except one register stepped by a constant (iadd/isub r r k). An iteration
+// is then a function of that register alone, so the loop either exits
+// within 256 iterations or never does
+bool spinLoop(const bjtcpu_instr* decoded, uint32_t head, bjtcpu_spin_loop& loop);
+
+// tag the sequences starting in [begin, end) - a sequence is never fused
+// across the end of ROM, and none of them write rdis or touch an extReg
+// register, so display signals, timer waits and DMA still come from single
+// instructions
+void fuseROM(bjtcpu_instr* decoded, uint32_t begin, uint32_t end);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+
+static constexpr int BJTCPU_DISPLAY_WIDTH = 64;
+static constexpr int BJTCPU_DISPLAY_HEIGHT = 64;
+static constexpr int BJTCPU_DISPLAY_PIXELS = BJTCPU_DISPLAY_WIDTH * BJTCPU_DISPLAY_HEIGHT;
+
+// host colour for each of the 16 grey levels, 0xAARRGGBB
+struct bjtcpu_palette {
+    std::array<uint32_t, 16> colours;
+};
+
+bjtcpu_palette greyscalePalette();
+
+// 64x64 display at 4 bits per pixel - pixels are stored packed in the device's
+// native format and only expanded to host colours when presented
+class bjtcpu_display {
+public:
+    bjtcpu_display();
+
+    // blank screen, cursor and anchor at the origin, auto-increment off
+    void reset();
+
+    // one write to rdis - see the video protocol in specification.txt
+    void sendSignal(uint8_t value);
+
+    // two pixels per byte, row major, even x in the low nibble
+    const uint8_t* getPixels() const;
+
+    // set whenever the pixels change, cleared by whoever presents them
+    bool isDirty() const;
+    void clearDirty();
+
+    uint8_t getCursorX() const;
+    uint8_t getCursorY() const;
+
+    // corner marked for span and rectangle fills
+    uint8_t getAnchorX() const;
+    uint8_t getAnchorY() const;
+
+    // colour writes advance the cursor in raster order
+    bool isAutoIncrement() const;
+
+    // replace the pixels, cursor and fill state, used when loading a saved state
+    void load(const uint8_t* pixels, uint8_t cursorX, uint8_t cursorY, uint8_t anchorX, uint8_t anchorY,
+        bool autoIncrement);
+
+private:
+    void clear(uint8_t colour);
+
+    void writePixel(uint8_t colour);
+
+    // pixels x0 to x1 inclusive of row y
+    void fillSpan(uint8_t y, uint8_t x0, uint8_t x1, uint8_t colour);
+
+    // anchor and cursor are opposite corners, inclusive
+    void fillRect(uint8_t colour);
+
+private:
+    std::array<uint8_t, BJTCPU_DISPLAY_PIXELS / 2> pixels;
+
+    uint8_t cursorX;
+    uint8_t cursorY;
+
+    uint8_t anchorX;
+    uint8_t anchorY;
+
+    bool autoIncrement;
+
+    bool dirty;
+
+};
+
+// expand count packed pixels (a multiple of 2) to 32 bit host colours through a
+// byte pair table, with SSE2 stores on x86-64 and vpermd lookups under AVX2
+void expandPixels(const uint8_t* packed, size_t count, uint32_t* out, const bjtcpu_palette& palette);
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+// cycles the DMA device spends per byte unless the host changes it
+static constexpr uint8_t BJTCPU_DMA_BYTE_CYCLES = 2;
+
+// block copy/fill device behind rdma - the bytes are moved as soon as a
+// transfer is started, and the transfer's length only decides how long rdma
+// reads as busy. Programs must leave both ranges alone until it clears, so the
+// device has nothing to save but the cycle it is free again
+class bjtcpu_dma {
+public:
+    bjtcpu_dma();
+
+    // cycle a transfer of length bytes (0 for 256) started at cycle finishes
+    // on - it queues behind one still running until busyUntil
+    uint64_t endCycle(uint64_t cycle, uint64_t busyUntil, uint8_t length) const;
+
+    // 0 makes every transfer finish as it starts
+    void setByteCycles(uint8_t cycles);
+    uint8_t getByteCycles() const;
+
+private:
+    uint8_t byteCycles;
+
+};
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "display.hpp"
+
+// final state dumps written by the command line tools
+
+bool dumpRegs(const std::string& path, uint16_t pc, const uint8_t* instrReg, const uint8_t* regFile,
+    uint64_t cycles, uint64_t instrs);
+
+bool dumpRAM(const std::string& path, const uint8_t* ram);
+
+// packed display pixels expanded through palette and written as a PPM
+bool dumpFramebuffer(const std::string& path, const uint8_t* pixels, const bjtcpu_palette& palette);
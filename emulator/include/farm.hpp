@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bjtcpu.hpp"
+
+// one independent run, rom is required
+struct bjtcpu_farm_job {
+    std::shared_ptr<const bjtcpu_rom_image> rom;
+    std::shared_ptr<const bjtcpu_state> initialState;  // null to start from reset
+    uint64_t cycles = 0;
+    bjtcpu_engine engine = bjtcpu_engine::INTERPRETER;
+};
+
+// padded to a cache line so workers filling neighbouring results don't contend
+struct alignas(64) bjtcpu_farm_result {
+    bool ok = false;        // false if the initial state was saved with another ROM
+    bool stopped = false;
+    uint16_t pc = 0;
+    std::array<uint8_t, 0x10> regFile{};
+    uint64_t cycles = 0;
+    uint64_t instrs = 0;
+};
+
+// runs batches of jobs on a fixed pool of threads, each with its own reusable
+// bjtcpu. Jobs are split into one contiguous range per worker, and workers that
+// finish early steal from the others' ranges with an atomic increment, so no
+// lock is taken per job and results are written straight into their slot
+class bjtcpu_farm {
+public:
+    // called on the worker once a job finishes, to pull out anything the result lacks
+    using inspect_fn = std::function<void(size_t job, bjtcpu& cpu)>;
+
+    // 0 uses one thread per hardware thread
+    explicit bjtcpu_farm(unsigned threads = 0);
+    ~bjtcpu_farm();
+
+    bjtcpu_farm(const bjtcpu_farm&) = delete;
+    bjtcpu_farm& operator=(const bjtcpu_farm&) = delete;
+
+    // blocks until every job has run, results[i] belongs to jobs[i]
+    std::vector<bjtcpu_farm_result> run(const std::vector<bjtcpu_farm_job>& jobs, const inspect_fn& inspect = nullptr);
+
+    unsigned getThreadCount() const;
+
+private:
+    struct alignas(64) worker {
+        std::thread thread;
+        std::unique_ptr<bjtcpu> cpu;
+
+        // this worker's range of the current batch, others may take from it too
+        std::atomic<size_t> next{0};
+        size_t end = 0;
+    };
+
+    void workerLoop(worker& self, size_t index);
+
+    bool claim(size_t index, size_t& job);
+
+    void runJob(worker& self, size_t job);
+
+private:
+    std::vector<std::unique_ptr<worker>> workers;
+
+    const std::vector<bjtcpu_farm_job>* jobs = nullptr;
+    std::vector<bjtcpu_farm_result>* results = nullptr;
+    const inspect_fn* inspect = nullptr;
+
+    // only taken at the start and end of a batch
+    std::mutex mutex;
+    std::condition_variable startCond;
+    std::condition_variable doneCond;
+    uint64_t generation = 0;
+    size_t busy = 0;
+    bool quit = false;
+
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data);
+
+bool writeFile(const std::string& path, const void* data, size_t size);
+
+// read-only mapping of a whole file, unmapped when destroyed
+class bjtcpu_mapped_file {
+public:
+    bjtcpu_mapped_file() = default;
+    ~bjtcpu_mapped_file();
+
+    bjtcpu_mapped_file(const bjtcpu_mapped_file&) = delete;
+    bjtcpu_mapped_file& operator=(const bjtcpu_mapped_file&) = delete;
+
+    bool open(const std::string& path);
+
+    const uint8_t* data() const;
+    size_t size() const;
+
+private:
+    void close();
+
+private:
+    const uint8_t* mapped = nullptr;
+    size_t length = 0;
+
+    #ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+    #endif
+
+};
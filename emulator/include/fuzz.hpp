@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+
+#include "decode.hpp"
+
+// edge coverage and invariant checks for fuzzing, compiled in with BJTCPU_FUZZ
+#ifndef BJTCPU_FUZZ
+#define BJTCPU_FUZZ 0
+#endif
+
+#if BJTCPU_FUZZ
+#define BJTCPU_FUZZ_HOOK(...) fuzz.__VA_ARGS__
+#else
+#define BJTCPU_FUZZ_HOOK(...) do {} while (0)
+#endif
+
+enum class bjtcpu_fuzz_violation : uint8_t {
+    NONE,
+    UNWRITABLE_REG,     // instruction writes a register REG_WRITABLE leaves out
+    UNREADABLE_REG,     // instruction reads a register REG_READABLE leaves out
+    STACK_OVERFLOW,     // rsp wrapped past the top of the stack bank
+    STACK_UNDERFLOW,    // rsp wrapped below the bottom of the stack bank
+    STUCK_LOOP,         // machine state repeated with no RAM write, display signal or DMA transfer running between
+    COUNT
+};
+
+const char* fuzzViolationName(bjtcpu_fuzz_violation violation);
+
+// one 8-bit counter per hashed (PC, next PC) edge
+static constexpr size_t BJTCPU_FUZZ_EDGES = 0x10000;
+
+class bjtcpu_fuzz_monitor {
+public:
+    bjtcpu_fuzz_monitor();
+
+    // clears violations and loop detection, not the edge counters - a fuzzer
+    // driving an external map resets that itself between runs
+    void reset();
+
+    // registers that may be written/read, from the CPU's REG_WRITABLE/REG_READABLE
+    void setRegisters(const bool* writable, const bool* readable);
+
+    // count into map (BJTCPU_FUZZ_EDGES bytes, e.g. libFuzzer extra counters)
+    // instead of the monitor's own counters, null to go back to them
+    void setEdgeMap(uint8_t* map);
+    uint8_t* getEdgeMap();
+    void clearEdges();
+
+    // called before an instruction executes
+    inline void registers(const bjtcpu_instr& instr, uint16_t addr) {
+        uint16_t reads = readRegMask(instr) & ~readableMask;
+        uint16_t writes = writeRegMask(instr) & ~writableMask;
+
+        if (reads) {
+            flag(bjtcpu_fuzz_violation::UNREADABLE_REG, addr);
+        }
+        if (writes) {
+            flag(bjtcpu_fuzz_violation::UNWRITABLE_REG, addr);
+        }
+    }
+
+    // rsp after growing the stack by count bytes
+    inline void stackGrow(uint8_t sp, uint8_t count, uint16_t addr) {
+        if (sp < count) {
+            flag(bjtcpu_fuzz_violation::STACK_OVERFLOW, addr);
+        }
+    }
+
+    // rsp after shrinking the stack by count bytes
+    inline void stackShrink(uint8_t sp, uint8_t count, uint16_t addr) {
+        if (sp > 0xFF - count) {
+            flag(bjtcpu_fuzz_violation::STACK_UNDERFLOW, addr);
+        }
+    }
+
+    // RAM write or display signal - anything that can break a loop out of
+    // repeating forever
+    inline void sideEffect() {
+        sideEffects = true;
+    }
+
+    // an instruction finished at from and control moved to to. The state is
+    // compared against one saved at doubling distances (Brent's algorithm), so
+    // a side-effect free loop of any period is caught within twice its length.
+    // pending is set while a DMA transfer is still running - it changes rdma
+    // when it finishes, so a loop polling it is waiting rather than stuck
+    inline void edge(uint16_t from, uint16_t to, const std::array<uint8_t, 0x10>& regFile, uint8_t flagsReg,
+        bool pending) {
+        edges[from ^ (uint16_t)((to << 5) | (to >> 11))]++;
+
+        if (pending) {
+            sideEffects = true;
+        }
+
+        if (to == loopPC && !sideEffects && flagsReg == loopFlags && regFile == loopRegs) {
+            flag(bjtcpu_fuzz_violation::STUCK_LOOP, from);
+        }
+
+        if (++loopSteps == loopPeriod) {
+            loopPC = to;
+            loopFlags = flagsReg;
+            loopRegs = regFile;
+            loopSteps = 0;
+            loopPeriod *= 2;
+            sideEffects = false;
+        }
+    }
+
+    // first violation since the last reset, NONE if there was none
+    bjtcpu_fuzz_violation getViolation() const;
+    uint16_t getViolationAddr() const;
+
+    // bit per bjtcpu_fuzz_violation seen since the last reset
+    uint32_t getViolationMask() const;
+
+private:
+    static uint16_t readRegMask(const bjtcpu_instr& instr);
+    static uint16_t writeRegMask(const bjtcpu_instr& instr);
+
+    inline void flag(bjtcpu_fuzz_violation violation, uint16_t addr) {
+        if (violationMask == 0) {
+            firstViolation = violation;
+            firstViolationAddr = addr;
+        }
+        violationMask |= 1u << (uint32_t)violation;
+    }
+
+private:
+    std::vector<uint8_t> ownEdges;
+    uint8_t* edges;
+
+    uint16_t writableMask;
+    uint16_t readableMask;
+
+    bjtcpu_fuzz_violation firstViolation;
+    uint16_t firstViolationAddr;
+    uint32_t violationMask;
+
+    bool sideEffects;
+    uint32_t loopPC;    // out of PC range until the first state is saved
+    uint8_t loopFlags;
+    std::array<uint8_t, 0x10> loopRegs;
+    uint64_t loopSteps;
+    uint64_t loopPeriod;
+
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+
+#include "decode.hpp"
+#include "symbols.hpp"
+
+// stdlib routines the CPU can run natively (high-level emulation) once their
+// entry address is known from the label map
+enum class bjtcpu_hle_routine : uint8_t {
+    NONE,
+    MULTIPLY,
+    SHL,
+    SHLR,
+    SHR,        // calls std_shlr, so only bound when that is
+    MEMSET,
+    MEMCPY,
+    MEMCMP,
+    COUNT
+};
+
+// the stdlib label, e.g. "std_multiply"
+const char* hleRoutineName(bjtcpu_hle_routine routine);
+
+struct bjtcpu_hle_cost {
+    uint64_t cycles;
+    uint64_t instrs;
+
+    inline bjtcpu_hle_cost operator+(const bjtcpu_hle_cost& other) const {
+        return { cycles + other.cycles, instrs + other.instrs };
+    }
+
+    inline bjtcpu_hle_cost operator*(uint64_t times) const {
+        return { cycles * times, instrs * times };
+    }
+};
+
+// a routine bound at addr - costs are looked up by byte offset into the
+// reference code, so the native versions charge exactly what step() would
+struct bjtcpu_hle_code {
+    static constexpr size_t MAX_LEN = 0x40;
+
+    uint16_t addr;
+
+    // cycles and instructions of the code in [begin, end), both instruction
+    // boundaries and end past begin in address order
+    inline bjtcpu_hle_cost span(uint8_t begin, uint8_t end) const {
+        return { cyclesBefore[end] - cyclesBefore[begin], (uint64_t)(instrsBefore[end] - instrsBefore[begin]) };
+    }
+
+    std::array<uint32_t, MAX_LEN + 1> cyclesBefore;
+    std::array<uint8_t, MAX_LEN + 1> instrsBefore;
+};
+
+// entry addresses of the bound routines, per ROM
+class bjtcpu_hle_table {
+public:
+    // binds every routine whose label is in symbols and whose code there
+    // matches the stdlib instruction for instruction, returns how many
+    size_t bind(const uint8_t* rom, const bjtcpu_instr* decoded, const bjtcpu_symbols& symbols);
+
+    bool bind(const uint8_t* rom, const bjtcpu_instr* decoded, bjtcpu_hle_routine routine, uint16_t addr);
+
+    void clear();
+
+    inline bool empty() const {
+        return index.empty();
+    }
+
+    // routine entered at addr, NONE if there is none
+    inline bjtcpu_hle_routine find(uint16_t addr) const {
+        return index.empty() ? bjtcpu_hle_routine::NONE : index[addr];
+    }
+
+    bool isBound(bjtcpu_hle_routine routine) const;
+    const bjtcpu_hle_code& getCode(bjtcpu_hle_routine routine) const;
+
+private:
+    std::vector<bjtcpu_hle_routine> index;    // per ROM address, empty when nothing is bound
+    std::array<bjtcpu_hle_code, (size_t)bjtcpu_hle_routine::COUNT> codes;
+    std::array<bool, (size_t)bjtcpu_hle_routine::COUNT> bound = {};
+
+};
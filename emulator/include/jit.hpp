@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "block.hpp"
+
+// native code for translated blocks, compiled in with BJTCPU_JIT - on x86-64
+// (System V) the body of each block, every instruction but the last, becomes
+// straight-line machine code working on the register file and RAM in place.
+// Elsewhere blocks stay on the block interpreter
+#ifndef BJTCPU_JIT
+#if defined(__x86_64__) && !defined(_WIN32)
+#define BJTCPU_JIT 1
+#else
+#define BJTCPU_JIT 0
+#endif
+#endif
+
+#if BJTCPU_JIT
+
+class bjtcpu_ram;
+
+// everything compiled code touches, filled in by the caller
+struct bjtcpu_jit_context {
+    enum : uint8_t {
+        NONE,       // the body left FLAGS alone
+        ADD,        // see bjtcpu_lazy_flags
+        COMPARE
+    };
+
+    uint8_t* regs;
+    uint8_t* const* banks;  // written through only while the bank isn't shared
+    const bool* shared;
+    bjtcpu_ram* ram;        // write() for shared banks
+    const uint8_t* rom;
+
+    // inputs of the last flag update, for bjtcpu_lazy_flags::update() - on
+    // entry lastValue 1 and value 0 if carry is set, both 0 otherwise, so an
+    // addc or subc before any update reads it the same way
+    uint8_t lastValue;
+    uint8_t value;
+    uint8_t source;         // NONE on entry
+};
+
+class bjtcpu_jit {
+public:
+    bjtcpu_jit() = default;
+    ~bjtcpu_jit();
+
+    bjtcpu_jit(const bjtcpu_jit&) = delete;
+    bjtcpu_jit& operator=(const bjtcpu_jit&) = delete;
+
+    // the block's body as native code, nullptr if it has none or no executable
+    // memory could be mapped - the block interpreter runs it then
+    bjtcpu_jit_fn compile(const bjtcpu_block& block);
+
+    // forget all compiled code, keeping the memory for the next ROM
+    void clear();
+
+private:
+    struct region {
+        uint8_t* base;
+        size_t used;
+    };
+
+    // regions filled so far, in order - those past current are free
+    std::vector<region> regions;
+    size_t current = 0;
+
+    // code is assembled here, then copied into a region
+    std::vector<uint8_t> buffer;
+
+};
+
+#endif
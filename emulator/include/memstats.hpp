@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// RAM access counters and stack high-water marks, compiled in with BJTCPU_MEMSTATS
+#ifndef BJTCPU_MEMSTATS
+#define BJTCPU_MEMSTATS 0
+#endif
+
+#if BJTCPU_MEMSTATS
+#define BJTCPU_MEMSTATS_HOOK(...) memstats.__VA_ARGS__
+#else
+#define BJTCPU_MEMSTATS_HOOK(...) do {} while (0)
+#endif
+
+struct bjtcpu_memstats_header {
+    char magic[4];      // "BJTM"
+    uint32_t version;
+    uint64_t bankSwitches;
+    uint8_t peakSP;
+    uint8_t reserved[3];
+    uint32_t peakCallDepth;
+    // followed by 0x10000 read counts then 0x10000 write counts, uint64_t each
+};
+
+static constexpr uint32_t BJTCPU_MEMSTATS_VERSION = 1;
+
+class bjtcpu_memstats {
+public:
+    bjtcpu_memstats();
+
+    void reset();
+
+    inline void read(uint8_t bank, uint8_t addr) {
+        reads[bank * 0x100 + addr]++;
+    }
+
+    inline void write(uint8_t bank, uint8_t addr) {
+        writes[bank * 0x100 + addr]++;
+    }
+
+    inline void stackPointer(uint8_t sp) {
+        if (sp > peakSP) {
+            peakSP = sp;
+        }
+    }
+
+    inline void call() {
+        callDepth++;
+        if (callDepth > peakCallDepth) {
+            peakCallDepth = callDepth;
+        }
+    }
+
+    inline void ret() {
+        if (callDepth > 0) {
+            callDepth--;
+        }
+    }
+
+    // counts writes to rbnk that change the selected bank
+    inline void bankWrite(uint8_t bank) {
+        if (bank != lastBank) {
+            bankSwitches++;
+            lastBank = bank;
+        }
+    }
+
+    uint64_t getReads(uint8_t bank, uint8_t addr) const;
+    uint64_t getWrites(uint8_t bank, uint8_t addr) const;
+
+    uint64_t getBankReads(uint8_t bank) const;
+    uint64_t getBankWrites(uint8_t bank) const;
+
+    uint8_t getPeakSP() const;
+    uint32_t getPeakCallDepth() const;
+    uint64_t getBankSwitches() const;
+
+    // bank,reads,writes for every bank
+    bool writeCSV(const std::string& path) const;
+
+    // bjtcpu_memstats_header followed by the raw per-address counters
+    bool writeBinary(const std::string& path) const;
+
+private:
+    std::vector<uint64_t> reads;
+    std::vector<uint64_t> writes;
+
+    uint8_t peakSP;
+    uint32_t callDepth;
+    uint32_t peakCallDepth;
+
+    uint8_t lastBank;
+    uint64_t bankSwitches;
+
+};
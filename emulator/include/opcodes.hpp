@@ -10,8 +10,16 @@
 #define REG_BNK     0xE
 #define REG_ADDR    0xF
 
+#define REG_TIM     0x8
 #define REG_DIS     0x9
 
+#define REG_DMA_SRCB    0x3
+#define REG_DMA_SRCA    0x4
+#define REG_DMA_DSTB    0x5
+#define REG_DMA_DSTA    0x6
+#define REG_DMA_LEN     0x7
+#define REG_DMA         0xC
+
 // Opcodes
 
 #define OP_STOP     0x00
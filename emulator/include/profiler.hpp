@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "decode.hpp"
+#include "symbols.hpp"
+
+// per-PC cycle profiler with a shadow call stack, compiled in with BJTCPU_PROFILE
+#ifndef BJTCPU_PROFILE
+#define BJTCPU_PROFILE 0
+#endif
+
+#if BJTCPU_PROFILE
+#define BJTCPU_PROFILER(...) profiler.__VA_ARGS__
+#else
+#define BJTCPU_PROFILER(...) do {} while (0)
+#endif
+
+class bjtcpu_profiler {
+public:
+    bjtcpu_profiler();
+
+    void reset();
+
+    // cycles per address are derived from the decoded instruction at output
+    // time, so the hot path is a single counter increment
+    void setDecoded(const bjtcpu_instr* decoded);
+
+    inline void retire(uint16_t addr) {
+        executions[addr]++;
+    }
+
+    // call stack is charged from the CPU cycle counter at each call/ret
+    void call(uint16_t site, uint16_t target, uint64_t cycleCount);
+
+    inline void ret(uint64_t cycleCount) {
+        if (overflowDepth > 0) {
+            overflowDepth--;
+        } else if (current != 0) {
+            sync(cycleCount);
+            current = nodes[current].parent;
+        }
+    }
+
+    // charge cycles run since the last call/ret to the current frame
+    inline void sync(uint64_t cycleCount) {
+        nodes[current].cycles += cycleCount - frameStart;
+        frameStart = cycleCount;
+    }
+
+    // addr,function,executions,cycles for every executed address
+    bool writeHistogram(const std::string& path, const bjtcpu_symbols& symbols) const;
+
+    // one "outer;inner cycles" line per call stack, for flamegraph tools
+    bool writeFolded(const std::string& path, const bjtcpu_symbols& symbols) const;
+
+private:
+    struct node {
+        uint16_t func;      // call target, the root is named after the first call site
+        uint32_t parent;
+        uint64_t cycles;    // self cycles
+        std::vector<uint32_t> children;
+    };
+
+    const bjtcpu_instr* decoded;
+
+    std::vector<uint64_t> executions;
+
+    std::vector<node> nodes;
+    uint32_t current;
+    uint64_t frameStart;
+    bool rootNamed;
+    uint32_t overflowDepth;     // calls past MAX_CALL_DEPTH, charged to the deepest frame
+
+};
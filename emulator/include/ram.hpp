@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <memory>
+
+using bjtcpu_ram_bank = std::array<uint8_t, 0x100>;
+
+// banks held by a saved state, never written through
+using bjtcpu_ram_banks = std::array<std::shared_ptr<const bjtcpu_ram_bank>, 0x100>;
+
+// 64 KiB of RAM as 256 independently shareable banks - a bank is shared with
+// saved states until it is next written, so saving costs one reference per bank
+// and only banks dirtied since the last save are ever copied.
+// Banks written since the last clear() or restore() are tracked in a bitmap, so
+// going back to the same baseline only touches those banks
+class bjtcpu_ram {
+public:
+    bjtcpu_ram();
+
+    // back to all zero
+    void clear();
+
+    inline uint8_t read(uint8_t bank, uint8_t addr) const {
+        return data[bank][addr];
+    }
+
+    inline void write(uint8_t bank, uint8_t addr, uint8_t value) {
+        if (shared[bank]) {
+            own(bank);
+        }
+        data[bank][addr] = value;
+    }
+
+    // length bytes (up to 0x100) as if by memmove - addresses wrap within
+    // their bank, and every byte is read before any is written
+    void move(uint8_t destBank, uint8_t destAddr, uint8_t srcBank, uint8_t srcAddr, size_t length);
+
+    // length bytes (up to 0x100) from addr, wrapping within the bank
+    void fill(uint8_t bank, uint8_t addr, uint8_t value, size_t length);
+
+    // banks written since the last clear() or restore()
+    bool isDirty(uint8_t bank) const;
+
+    // current banks for a saved state, later writes copy before modifying
+    bjtcpu_ram_banks share();
+
+    // baseline identifies the banks (see bjtcpu_state::id) - restoring the same
+    // baseline again only touches dirty banks
+    void restore(const bjtcpu_ram_banks& banks, uint64_t baseline);
+
+    static const std::shared_ptr<const bjtcpu_ram_bank>& zeroBank();
+
+    // for native code, which reads and writes through the bank pointers
+    // directly and calls write() when the bank is shared
+    inline uint8_t* const* getBankData() const {
+        return data.data();
+    }
+
+    inline const bool* getShared() const {
+        return shared.data();
+    }
+
+private:
+    // first write to a bank since it was shared, cleared or restored
+    void own(uint8_t bank);
+
+    // bring a bank back to the baseline's contents, in place if nothing else holds it
+    void revert(uint8_t bank, const std::shared_ptr<const bjtcpu_ram_bank>& source);
+
+private:
+    std::array<std::shared_ptr<const bjtcpu_ram_bank>, 0x100> banks;
+
+    // writable pointer into each bank, only written through when not shared
+    std::array<uint8_t*, 0x100> data;
+    std::array<bool, 0x100> shared;
+
+    std::array<uint64_t, 4> dirty;
+
+    // 0 is all zero, anything else is a saved state's id
+    uint64_t baseline;
+
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "state.hpp"
+
+// keyframes and a delta log for stepping backwards, compiled in with BJTCPU_REWIND
+#ifndef BJTCPU_REWIND
+#define BJTCPU_REWIND 0
+#endif
+
+#if BJTCPU_REWIND
+#define BJTCPU_REWIND_HOOK(...) rewind.__VA_ARGS__
+#else
+#define BJTCPU_REWIND_HOOK(...) do {} while (0)
+#endif
+
+enum class bjtcpu_delta_kind : uint8_t {
+    RAM_WRITE,  // target = bank << 8 | addr
+    REG_WRITE,  // target = register
+    DISPLAY     // value = signal
+};
+
+struct bjtcpu_delta {
+    uint64_t cycle;     // cycle count once the write has happened
+    uint16_t target;
+    uint8_t value;
+    bjtcpu_delta_kind kind;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(bjtcpu_delta) == 16);
+
+// full state keyframes every N cycles plus a bounded ring of the writes made in
+// between. The machine is deterministic, so seeking restores the nearest keyframe
+// and replays forward - the deltas answer "when was this last written" without
+// replaying at all
+class bjtcpu_rewind {
+public:
+    static constexpr uint64_t DEFAULT_INTERVAL = 100000;
+    static constexpr size_t DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+    bjtcpu_rewind();
+
+    // an eighth of the budget goes to the delta ring, the rest to keyframes
+    void configure(uint64_t keyframeInterval, size_t memoryBudget);
+
+    void clear();
+
+    inline void ramWrite(uint64_t cycle, uint8_t bank, uint8_t addr, uint8_t value) {
+        record(cycle, (bank << 8) | addr, value, bjtcpu_delta_kind::RAM_WRITE);
+    }
+
+    inline void regWrite(uint64_t cycle, uint8_t reg, uint8_t value) {
+        record(cycle, reg, value, bjtcpu_delta_kind::REG_WRITE);
+    }
+
+    inline void display(uint64_t cycle, uint8_t signal) {
+        record(cycle, 0, signal, bjtcpu_delta_kind::DISPLAY);
+    }
+
+    inline bool keyframeDue(uint64_t cycle) const {
+        return cycle >= nextKeyframe;
+    }
+
+    // oldest keyframes are dropped once over budget
+    void addKeyframe(bjtcpu_state&& state);
+
+    // latest keyframe at or before cycle, null if it has been dropped
+    const bjtcpu_state* findKeyframe(uint64_t cycle) const;
+
+    // forget everything after cycle, history is recorded again as it is replayed
+    void truncate(uint64_t cycle);
+
+    // cycle of the last write to the RAM address before the given cycle, false
+    // if it is no longer in the ring
+    bool findLastWrite(uint8_t bank, uint8_t addr, uint64_t beforeCycle, uint64_t& cycle) const;
+
+    // deltas still in the ring, oldest first
+    std::vector<bjtcpu_delta> getDeltas() const;
+
+    uint64_t getOldestCycle() const;
+    size_t getKeyframeCount() const;
+    size_t getMemoryUsed() const;
+
+private:
+    inline void record(uint64_t cycle, uint16_t target, uint8_t value, bjtcpu_delta_kind kind) {
+        bjtcpu_delta& delta = deltas[head & deltaMask];
+        delta.cycle = cycle;
+        delta.target = target;
+        delta.value = value;
+        delta.kind = kind;
+        delta.reserved = 0;
+        head++;
+    }
+
+    // state size plus every bank not shared with the previous keyframe
+    size_t keyframeCost(const bjtcpu_state& state, const bjtcpu_state* previous) const;
+
+private:
+    struct keyframe {
+        bjtcpu_state state;
+        size_t cost;
+    };
+
+    uint64_t interval;
+    size_t keyframeBudget;
+
+    std::deque<keyframe> keyframes;
+    size_t keyframeBytes;
+    uint64_t nextKeyframe;
+
+    std::vector<bjtcpu_delta> deltas;
+    uint64_t deltaMask;
+    uint64_t head;
+
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "decode.hpp"
+#include "fileio.hpp"
+
+// immutable 64 KiB ROM and its decoded instructions, shared by every CPU that
+// runs it so each instance only carries RAM and registers
+class bjtcpu_rom_image : public std::enable_shared_from_this<bjtcpu_rom_image> {
+public:
+    // copies size bytes (at most 64 KiB) and zero pads the rest, null if too large
+    static std::shared_ptr<bjtcpu_rom_image> create(const uint8_t* bytes, size_t size);
+
+    // maps the file - a full 64 KiB image is used in place, a shorter one is
+    // copied from the mapping and padded. Null if unreadable or too large
+    static std::shared_ptr<const bjtcpu_rom_image> load(const std::string& path);
+
+    // all zero, what a CPU starts with before a ROM is loaded
+    static const std::shared_ptr<const bjtcpu_rom_image>& empty();
+
+    // replace the contents of an image made by create(), re-decoding only the
+    // addresses the old and new contents cover - for harnesses that run a new
+    // ROM every time, setROM() again after. False if mapped, too large, or
+    // anything but the caller's pointer still holds it - images are shared as
+    // immutable, so a CPU has to let go of it (setROM(empty())) first
+    bool assign(const uint8_t* bytes, size_t size);
+
+    const uint8_t* getBytes() const;
+    const bjtcpu_instr* getDecoded() const;
+
+    // bytes in the source, before padding
+    size_t getSize() const;
+
+    uint32_t getChecksum() const;
+
+private:
+    bjtcpu_rom_image() = default;
+
+    void decode();
+
+private:
+    struct alignas(64) rom_storage {
+        uint8_t bytes[0x10000];
+    };
+
+    struct alignas(64) decoded_storage {
+        bjtcpu_instr instrs[0x10000];
+    };
+
+    std::unique_ptr<bjtcpu_mapped_file> file;
+    std::unique_ptr<rom_storage> owned;
+    std::unique_ptr<decoded_storage> decoded;
+
+    // into owned or the mapped file
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+
+    uint32_t checksum = 0;
+
+};
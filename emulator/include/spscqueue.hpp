@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <atomic>
+#include <array>
+
+// bounded lock-free queue with one producer thread and one consumer thread
+template <typename T, size_t N>
+class bjtcpu_spsc_queue {
+public:
+    static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+
+    // returns false if the queue is full
+    bool push(const T& value) {
+        size_t tailIdx = tail.load(std::memory_order_relaxed);
+        if (tailIdx - head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+
+        items[tailIdx & (N - 1)] = value;
+        tail.store(tailIdx + 1, std::memory_order_release);
+        return true;
+    }
+
+    // returns false if the queue is empty
+    bool pop(T& value) {
+        size_t headIdx = head.load(std::memory_order_relaxed);
+        if (headIdx == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = items[headIdx & (N - 1)];
+        head.store(headIdx + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, N> items{};
+
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string>
+
+#include "display.hpp"
+#include "ram.hpp"
+
+// full machine state captured by bjtcpu::saveState() - RAM banks are shared with
+// the machine until it next writes them. Profiler, trace and memory statistics
+// are diagnostics and are not part of the state
+struct bjtcpu_state {
+    // unique per saved or parsed state, lets RAM restore only the banks that
+    // changed since this same state was last restored
+    uint64_t id = 0;
+
+    uint32_t romChecksum = 0;
+
+    uint16_t pcReg = 0;
+    std::array<uint8_t, 3> instrReg{};
+    uint16_t instrAddr = 0;
+    uint8_t instrFetchIdx = 0;
+    uint8_t instrStageIdx = 0;
+
+    std::array<uint8_t, 0x10> regFile{};
+    uint8_t flagsReg = 0;
+    bool stopped = false;
+
+    // cycles left waiting for a timer event, 0 when running
+    uint64_t waitCycles = 0;
+
+    // cycles until the last DMA transfer started finishes, 0 when idle
+    uint64_t dmaCycles = 0;
+
+    uint64_t cycleCount = 0;
+    uint64_t instrCount = 0;
+
+    bjtcpu_display display;
+
+    bjtcpu_ram_banks banks;
+};
+
+// serialized state - fixed offsets so a mapped file can be read in place, with
+// RAM page aligned at BJTCPU_STATE_RAM_OFFSET
+struct bjtcpu_state_header {
+    char magic[4];      // "BJTS"
+    uint32_t version;
+    uint32_t romChecksum;
+    uint16_t pc;
+    uint16_t instrAddr;
+    uint8_t instrReg[3];
+    uint8_t instrFetchIdx;
+    uint8_t instrStageIdx;
+    uint8_t flags;
+    uint8_t stopped;
+    uint8_t cursorX;
+    uint8_t cursorY;
+    uint8_t anchorX;
+    uint8_t anchorY;
+    uint8_t displayMode;    // bit 0 - auto-increment
+    uint32_t reserved;
+    uint8_t regFile[0x10];
+    uint64_t cycleCount;
+    uint64_t instrCount;
+    uint64_t waitCycles;
+    uint64_t dmaCycles;     // transfers queue behind each other, so this can pass 2^32
+    // followed by the packed display pixels at BJTCPU_STATE_DISPLAY_OFFSET and
+    // RAM, bank by bank, at BJTCPU_STATE_RAM_OFFSET
+};
+
+static_assert(sizeof(bjtcpu_state_header) == 80);
+
+static constexpr uint32_t BJTCPU_STATE_VERSION = 3;
+static constexpr size_t BJTCPU_STATE_DISPLAY_OFFSET = sizeof(bjtcpu_state_header);
+static constexpr size_t BJTCPU_STATE_RAM_OFFSET = 0x1000;
+static constexpr size_t BJTCPU_STATE_SIZE = BJTCPU_STATE_RAM_OFFSET + 0x10000;
+
+uint64_t nextStateId();
+
+// FNV-1a over the whole ROM, a saved state only loads against the ROM it came from
+uint32_t checksumROM(const uint8_t* rom);
+
+// same result for a ROM whose bytes from size on are all zero, without reading them
+uint32_t checksumROM(const uint8_t* rom, size_t size);
+
+bool writeState(const std::string& path, const bjtcpu_state& state);
+
+bool readState(const std::string& path, bjtcpu_state& state);
+
+// parse a serialized state in memory (e.g. a mapped file), false if it is not
+// a valid state of this version
+bool parseState(const uint8_t* data, size_t size, bjtcpu_state& state);
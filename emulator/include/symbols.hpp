@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct bjtcpu_symbol {
+    uint16_t addr;
+    bool data;
+    std::string name;   // local labels are "scope.label"
+};
+
+// label address map exported by the assembler alongside the .bin
+class bjtcpu_symbols {
+public:
+    bool load(const std::string& path);
+
+    const std::vector<bjtcpu_symbol>& getSymbols() const;
+
+    bool find(const std::string& name, uint16_t& addr) const;
+
+    // name of the global (non-local) code label containing addr, or a hex address
+    std::string functionName(uint16_t addr) const;
+
+private:
+    std::vector<bjtcpu_symbol> symbols;     // sorted by address
+    std::unordered_map<std::string, uint16_t> addrs;
+
+};
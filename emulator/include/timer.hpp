@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+// cycles between vsyncs and between timer ticks unless the host changes them,
+// a frame is 16 ticks
+static constexpr uint16_t BJTCPU_FRAME_PERIOD = 0x1000;
+static constexpr uint16_t BJTCPU_TICK_PERIOD = 0x100;
+
+// vsync and tick timer - both count off the CPU's cycles, so a wait ends on the
+// same cycle however the CPU is run and the device itself has no state to save
+class bjtcpu_timer {
+public:
+    bjtcpu_timer();
+
+    // cycle a wait signalled at cycle ends on - 0 waits for the next vsync,
+    // n for the nth tick after cycle
+    uint64_t wakeCycle(uint64_t cycle, uint8_t signal) const;
+
+    // periods of 0 are ignored
+    void setFramePeriod(uint16_t cycles);
+    void setTickPeriod(uint16_t cycles);
+
+    uint16_t getFramePeriod() const;
+    uint16_t getTickPeriod() const;
+
+private:
+    uint16_t framePeriod;
+    uint16_t tickPeriod;
+
+};
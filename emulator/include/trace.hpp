@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <string>
+#include <vector>
+
+// trace levels, selected at compile time with BJTCPU_TRACE_LEVEL - events above
+// the selected level compile to nothing
+#define BJTCPU_TRACE_NONE   0
+#define BJTCPU_TRACE_CALL   1   // call/ret, display, timer and DMA signals
+#define BJTCPU_TRACE_MEM    2   // + RAM writes
+#define BJTCPU_TRACE_EXEC   3   // + fetch, execute
+
+#ifndef BJTCPU_TRACE_LEVEL
+#define BJTCPU_TRACE_LEVEL BJTCPU_TRACE_NONE
+#endif
+
+#if BJTCPU_TRACE_LEVEL > BJTCPU_TRACE_NONE
+#define BJTCPU_TRACE(level, ...) do { if constexpr (BJTCPU_TRACE_LEVEL >= (level)) { trace.record(__VA_ARGS__); } } while (0)
+#else
+#define BJTCPU_TRACE(level, ...) do {} while (0)
+#endif
+
+enum class bjtcpu_trace_event : uint8_t {
+    FETCH,      // pc, a = byte, b = fetch index
+    EXEC,       // pc = instruction, a = bjtcpu_op, b = operand bytes
+    RAM_WRITE,  // pc = instruction, a = value, b = bank << 8 | addr
+    DISPLAY,    // pc = instruction, a = signal
+    CALL,       // pc = instruction, b = target
+    RET,        // pc = instruction, b = return address
+    WAIT,       // pc = instruction, a = timer signal, b = cycles until the event (saturating)
+    DMA         // pc = instruction, a = rdma signal, b = bytes
+};
+
+struct bjtcpu_trace_record {
+    uint64_t cycle;
+    uint16_t pc;
+    uint16_t b;
+    bjtcpu_trace_event event;
+    uint8_t a;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(bjtcpu_trace_record) == 16, "trace records are written to disk as-is");
+
+struct bjtcpu_trace_header {
+    char magic[4];      // "BJTT"
+    uint32_t version;
+    uint64_t count;
+};
+
+static constexpr uint32_t BJTCPU_TRACE_VERSION = 1;
+
+// fixed size ring of the most recent trace records. Single producer (the CPU),
+// any thread may take a snapshot without locking
+class bjtcpu_trace_ring {
+public:
+    static constexpr size_t SIZE = 1 << 16;
+
+    bjtcpu_trace_ring();
+
+    inline void record(bjtcpu_trace_event event, uint64_t cycle, uint16_t pc, uint8_t a, uint16_t b) {
+        uint64_t index = head.load(std::memory_order_relaxed);
+
+        bjtcpu_trace_record& rec = records[index & (SIZE - 1)];
+        rec.cycle = cycle;
+        rec.pc = pc;
+        rec.b = b;
+        rec.event = event;
+        rec.a = a;
+        rec.reserved = 0;
+
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    void clear();
+
+    // recorded events still in the ring, oldest first
+    std::vector<bjtcpu_trace_record> snapshot() const;
+
+    bool dump(const std::string& path) const;
+
+private:
+    std::vector<bjtcpu_trace_record> records;
+    std::atomic<uint64_t> head;
+
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <array>
+
+// single producer, single consumer triple buffer - the writer always has a back
+// slot to fill and the reader always has the newest complete slot, neither blocks
+template <typename T>
+class bjtcpu_triple_buffer {
+public:
+    bjtcpu_triple_buffer() : back(0), middle(1), front(2) {}
+
+    // writer side - fill getBack(), then publish() to hand it to the reader
+    T& getBack() {
+        return slots[back];
+    }
+
+    void publish() {
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // reader side - returns true if a newer slot was taken since the last call
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+
+    const T& getFront() const {
+        return slots[front];
+    }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    std::array<T, 3> slots{};
+
+    uint8_t back;
+    std::atomic<uint8_t> middle;
+    uint8_t front;
+
+};
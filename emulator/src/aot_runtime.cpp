@@ -0,0 +1,79 @@
+#include "aot_runtime.hpp"
+#include "dump.hpp"
+
+#include <stdio.h>
+#include <cstdlib>
+#include <string>
+#include <memory>
+#include <chrono>
+
+uint16_t bjtcpu_aot_machine::unknownEntry(uint16_t pc) {
+    printf("ERROR: No translated code at address %04x\n", pc);
+    stopped = true;
+    return pc;
+}
+
+int bjtcpu_aot_main(int argc, char** argv, const uint8_t* rom, bjtcpu_aot_dispatch dispatch) {
+    uint64_t maxCycles = UINT64_MAX;
+    std::string regsPath;
+    std::string ramPath;
+    std::string fbPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--cycles" && hasValue) {
+            maxCycles = std::strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--regs" && hasValue) {
+            regsPath = argv[++i];
+        } else if (arg == "--ram" && hasValue) {
+            ramPath = argv[++i];
+        } else if (arg == "--fb" && hasValue) {
+            fbPath = argv[++i];
+        } else {
+            printf("Unknown argument \"%s\"\n", arg.c_str());
+            printf("Usage: %s [--cycles N] [--regs FILE] [--ram FILE] [--fb FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::unique_ptr<bjtcpu_aot_machine> m = std::make_unique<bjtcpu_aot_machine>();
+    m->rom = rom;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // translated code only checks the budget between entry points
+    while (!m->stopped && m->cycleCount < maxCycles) {
+        m->pcReg = dispatch(*m, m->pcReg);
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000000000.0;
+
+    printf("%s after %llu cycles\n", m->stopped ? "Stopped" : "Budget reached", (unsigned long long)m->cycleCount);
+    printf("Instructions retired  %llu\n", (unsigned long long)m->instrCount);
+    printf("Wall time             %.6f s\n", seconds);
+    printf("Effective speed       %.3f MHz\n", seconds > 0 ? m->cycleCount / seconds / 1000000.0 : 0.0);
+
+    std::array<uint8_t, 3> instrReg{};
+
+    if (!regsPath.empty() && !dumpRegs(regsPath, m->pcReg, instrReg.data(), m->regFile.data(), m->cycleCount, m->instrCount)) {
+        printf("Could not write registers to \"%s\"\n", regsPath.c_str());
+        return 1;
+    }
+
+    if (!ramPath.empty() && !dumpRAM(ramPath, m->ram.data())) {
+        printf("Could not write RAM to \"%s\"\n", ramPath.c_str());
+        return 1;
+    }
+
+    #if BJTCPU_EXT_DISPLAY
+    if (!fbPath.empty() && !dumpFramebuffer(fbPath, m->display.getPixels(), greyscalePalette())) {
+        printf("Could not write framebuffer to \"%s\"\n", fbPath.c_str());
+        return 1;
+    }
+    #endif
+
+    return 0;
+}
@@ -1,207 +1,1244 @@
 #include "bjtcpu.hpp"
 
-bjtcpu::bjtcpu() {
-    rom.fill(0);
+#include <algorithm>
+#include <numeric>
+
+#if defined(_MSC_VER)
+#define BJTCPU_NOINLINE __declspec(noinline)
+#else
+#define BJTCPU_NOINLINE __attribute__((noinline))
+#endif
+
+bjtcpu::bjtcpu() : romImage(bjtcpu_rom_image::empty()) {
+    engine = bjtcpu_engine::INTERPRETER;
+
+    rom = romImage->getBytes();
+    decoded = romImage->getDecoded();
+
+    #if BJTCPU_PROFILE
+    profiler.setDecoded(decoded);
+    #endif
+
+    BJTCPU_FUZZ_HOOK(setRegisters(REG_WRITABLE, REG_READABLE));
+
     reset();
 }
 
-void bjtcpu::reset() {
-    pcReg = 0;
-    instrReg.fill(0);
+void bjtcpu::reset() {
+    pcReg = 0;
+    instrReg.fill(0);
+
+    instrAddr = 0;
+    instrFetchIdx = 0;
+    instrStageIdx = 0;
+
+    regFile.fill(0);
+    flags.load(0);
+
+    ram.clear();
+
+    #if BJTCPU_EXT_DISPLAY
+    display.reset();
+    #endif
+
+    stopped = false;
+
+    wakeCycle = 0;
+    dmaEnd = 0;
+    cycleCount = 0;
+    instrCount = 0;
+
+    fusionCounts.fill(0);
+    hleCounts.fill(0);
+
+    #if BJTCPU_PROFILE
+    profiler.reset();
+    #endif
+
+    #if BJTCPU_MEMSTATS
+    memstats.reset();
+    #endif
+
+    BJTCPU_FUZZ_HOOK(reset());
+
+    BJTCPU_REWIND_HOOK(clear());
+    keyframe();
+}
+
+bool bjtcpu::resetTo(const bjtcpu_state& state) {
+    if (state.romChecksum != romImage->getChecksum()) {
+        return false;
+    }
+
+    restoreState(state);
+
+    fusionCounts.fill(0);
+    hleCounts.fill(0);
+
+    #if BJTCPU_PROFILE
+    profiler.reset();
+    #endif
+
+    #if BJTCPU_MEMSTATS
+    memstats.reset();
+    #endif
+
+    BJTCPU_FUZZ_HOOK(reset());
+
+    BJTCPU_REWIND_HOOK(clear());
+    keyframe();
+
+    return true;
+}
+
+void bjtcpu::loadROM(const uint8_t* bytes, size_t size) {
+    setROM(bjtcpu_rom_image::create(bytes, std::min<size_t>(size, 0x10000)));
+}
+
+void bjtcpu::setROM(std::shared_ptr<const bjtcpu_rom_image> image) {
+    romImage = std::move(image);
+    rom = romImage->getBytes();
+    decoded = romImage->getDecoded();
+
+    #if BJTCPU_PROFILE
+    profiler.setDecoded(decoded);
+    #endif
+
+    clearBlocks();
+
+    hle.clear();
+
+    BJTCPU_REWIND_HOOK(clear());
+    keyframe();
+}
+
+const std::shared_ptr<const bjtcpu_rom_image>& bjtcpu::getROM() {
+    return romImage;
+}
+
+bjtcpu_state bjtcpu::saveState() {
+    bjtcpu_state state;
+    state.id = nextStateId();
+    state.romChecksum = romImage->getChecksum();
+
+    state.pcReg = pcReg;
+    state.instrReg = instrReg;
+    state.instrAddr = instrAddr;
+    state.instrFetchIdx = instrFetchIdx;
+    state.instrStageIdx = instrStageIdx;
+
+    state.regFile = regFile;
+    state.flagsReg = flags.get();
+    state.stopped = stopped;
+    state.waitCycles = getWaitCycles();
+
+    #if BJTCPU_EXT_DMA
+    refreshDMA(cycleCount);
+    state.regFile[REG_DMA] = regFile[REG_DMA];
+    state.dmaCycles = getDMACycles();
+    #endif
+
+    state.cycleCount = cycleCount;
+    state.instrCount = instrCount;
+
+    #if BJTCPU_EXT_DISPLAY
+    state.display = display;
+    #endif
+
+    state.banks = ram.share();
+
+    return state;
+}
+
+bool bjtcpu::loadState(const bjtcpu_state& state) {
+    if (state.romChecksum != romImage->getChecksum()) {
+        return false;
+    }
+
+    restoreState(state);
+
+    BJTCPU_REWIND_HOOK(clear());
+    keyframe();
+
+    return true;
+}
+
+void bjtcpu::restoreState(const bjtcpu_state& state) {
+    pcReg = state.pcReg;
+    instrReg = state.instrReg;
+    instrAddr = state.instrAddr;
+    instrFetchIdx = state.instrFetchIdx;
+    instrStageIdx = state.instrStageIdx;
+
+    regFile = state.regFile;
+    flags.load(state.flagsReg);
+    stopped = state.stopped;
+
+    cycleCount = state.cycleCount;
+    instrCount = state.instrCount;
+    wakeCycle = cycleCount + state.waitCycles;
+    dmaEnd = cycleCount + state.dmaCycles;
+
+    #if BJTCPU_EXT_DISPLAY
+    display.load(state.display.getPixels(), state.display.getCursorX(), state.display.getCursorY(),
+        state.display.getAnchorX(), state.display.getAnchorY(), state.display.isAutoIncrement());
+    #endif
+
+    ram.restore(state.banks, state.id);
+}
+
+void bjtcpu::step() {
+    if (stopped) {
+        return;
+    }
+
+    keyframe();
+
+    cycleCount++;
+
+    if (cycleCount <= wakeCycle) {
+        return;
+    }
+
+    if (instrFetchIdx == 0 || instrFetchIdx < decoded[instrAddr].len) {
+        if (instrFetchIdx == 0) {
+            instrAddr = pcReg;
+        }
+
+        instrReg[instrFetchIdx] = rom[pcReg];
+        BJTCPU_TRACE(BJTCPU_TRACE_EXEC, bjtcpu_trace_event::FETCH, cycleCount, pcReg, rom[pcReg], instrFetchIdx);
+        instrFetchIdx++;
+        pcReg++;
+
+        return;
+    }
+
+    const bjtcpu_instr& instr = decoded[instrAddr];
+
+    if (instrStageIdx == 0) {
+        BJTCPU_TRACE(BJTCPU_TRACE_EXEC, bjtcpu_trace_event::EXEC, cycleCount, instrAddr, (uint8_t)instr.op, (instrReg[1] << 8) | instrReg[2]);
+        BJTCPU_FUZZ_HOOK(registers(instr, instrAddr));
+
+        #if BJTCPU_EXT_DMA
+        // the same busy flag executeExt() sees, at the cycle the instruction retires
+        if (instr.extReg) {
+            refreshDMA(cycleCount + instr.cycles - instr.len - 1);
+        }
+        #endif
+    }
+
+    uint8_t displayReg = regFile[REG_DIS];
+
+    bool cycleFinished = true;
+
+    switch (instr.op) {
+        case bjtcpu_op::STOP:
+            stopped = true;
+            instrCount++;
+            BJTCPU_PROFILER(retire(instrAddr));
+            return;
+        case bjtcpu_op::RET:
+            cycleFinished = retFuncStep();
+            break;
+        case bjtcpu_op::PCALL:
+            cycleFinished = callFuncStep(true);
+            break;
+        case bjtcpu_op::CALL:
+            cycleFinished = callFuncStep(false);
+            break;
+        case bjtcpu_op::PUSH:
+            cycleFinished = pushStep(regFile[instr.srcX]);
+            break;
+        case bjtcpu_op::POP:
+            cycleFinished = popStep(instr.dest);
+            break;
+        default:
+            execute(instr);
+            break;
+    }
+
+    updateDisplay(displayReg);
+
+    instrStageIdx++;
+
+    if (cycleFinished) {
+        endCycle();
+
+        if (instr.extReg) {
+            handleExtWrites(instr);
+        }
+    }
+}
+
+void bjtcpu::runInstruction() {
+    // a wait is skipped instead, nothing retires during it
+    if (cycleCount < wakeCycle) {
+        cycleCount = wakeCycle;
+        return;
+    }
+
+    executeNext();
+}
+
+// inline, so run() and runCycles() get the whole instruction in their loops
+inline void bjtcpu::executeNext() {
+    if (stopped) {
+        return;
+    }
+
+    if (instrFetchIdx != 0) {
+        // finish the instruction the stepper is part way through
+        while (instrFetchIdx != 0 && !stopped) {
+            step();
+        }
+        return;
+    }
+
+    keyframe();
+
+    const bjtcpu_instr& instr = decoded[pcReg];
+    instrAddr = pcReg;
+    pcReg += instr.len;
+    cycleCount += instr.cycles;
+    instrCount++;
+
+    BJTCPU_PROFILER(retire(instrAddr));
+
+    BJTCPU_TRACE(BJTCPU_TRACE_EXEC, bjtcpu_trace_event::EXEC, cycleCount, instrAddr, (uint8_t)instr.op, instr.target);
+
+    BJTCPU_FUZZ_HOOK(registers(instr, instrAddr));
+
+    uint8_t displayReg = regFile[REG_DIS];
+
+    if (instr.extReg) {
+        executeExt(instr);
+    } else {
+        executeWhole(instr);
+    }
+
+    updateDisplay(displayReg);
+
+    BJTCPU_FUZZ_HOOK(edge(instrAddr, pcReg, regFile, flags.get(), cycleCount < dmaEnd));
+}
+
+uint64_t bjtcpu::run(uint64_t instrs) {
+    return run(instrs, UINT64_MAX);
+}
+
+uint64_t bjtcpu::run(uint64_t instrs, uint64_t cycles) {
+    uint64_t startCount = instrCount;
+    uint64_t endCount = cycles > UINT64_MAX - cycleCount ? UINT64_MAX : cycleCount + cycles;
+
+    while (!stopped && instrFetchIdx != 0 && cycleCount < endCount && instrCount - startCount < instrs) {
+        step();
+    }
+
+    // headless, so a wait costs nothing but its cycles. It is skipped when the
+    // next instruction runs, and only single instructions start one - blocks
+    // and fused sequences stop short of rtim
+    if (cycleCount < wakeCycle && instrCount - startCount < instrs) {
+        cycleCount = std::min(wakeCycle, endCount);
+    }
+
+    while (!stopped && instrCount - startCount < instrs && endCount - cycleCount >= decoded[pcReg].cycles) {
+        uint64_t remaining = instrs - (instrCount - startCount);
+        if ((engine != bjtcpu_engine::BLOCK || !runBlocks(endCount - cycleCount, remaining)) &&
+            (hle.empty() || !runHLE(endCount - cycleCount, remaining)) &&
+            (decoded[pcReg].fusion == bjtcpu_fusion::NONE || !runFused(endCount - cycleCount, remaining))) {
+            executeNext();
+
+            if (cycleCount < wakeCycle && instrCount - startCount < instrs) {
+                cycleCount = std::min(wakeCycle, endCount);
+            }
+        }
+    }
+
+    // budget ends part way through an instruction
+    while (!stopped && cycleCount < endCount && instrCount - startCount < instrs) {
+        step();
+    }
+
+    return instrCount - startCount;
+}
+
+uint64_t bjtcpu::runCycles(uint64_t cycles) {
+    uint64_t startCount = cycleCount;
+    run(UINT64_MAX, cycles);
+    return cycleCount - startCount;
+}
+
+void bjtcpu::setEngine(bjtcpu_engine engine) {
+    this->engine = engine;
+}
+
+bjtcpu_engine bjtcpu::getEngine() {
+    return engine;
+}
+
+bool bjtcpu::runBlocks(uint64_t maxCycles, uint64_t maxInstrs) {
+    if (blockIndex.empty()) {
+        blockIndex.assign(0x10000, -1);
+    }
+
+    #if BJTCPU_NATIVE_BLOCKS
+    jitContext.regs = regFile.data();
+    jitContext.banks = ram.getBankData();
+    jitContext.shared = ram.getShared();
+    jitContext.ram = &ram;
+    jitContext.rom = rom;
+    #endif
+
+    bool ranBlock = false;
+
+    while (!stopped) {
+        keyframe();
+
+        // back to run() so the routine runs natively or the loop is skipped
+        if (hle.find(pcReg) != bjtcpu_hle_routine::NONE ||
+            (BJTCPU_FUSION && decoded[pcReg].fusion == bjtcpu_fusion::SPIN_LOOP)) {
+            break;
+        }
+
+        int32_t index = blockIndex[pcReg];
+        if (index < 0) {
+            if (blockCount == blocks.size()) {
+                blocks.emplace_back();
+            }
+
+            index = blockCount++;
+            translateBlock(decoded, pcReg, blocks[index]);
+            blockIndex[pcReg] = index;
+
+            #if BJTCPU_NATIVE_BLOCKS
+            blocks[index].native = jit.compile(blocks[index]);
+            #endif
+        }
+
+        const bjtcpu_block& block = blocks[index];
+        size_t count = block.instrs.size();
+
+        if (count == 0 || block.cycles > maxCycles || count > maxInstrs) {
+            break;
+        }
+
+        size_t i = 0;
+
+        #if BJTCPU_NATIVE_BLOCKS
+        if (block.native) {
+            runNative(block.native);
+            i = count - 1;
+        }
+        #endif
+
+        for (; i < count - 1; i++) {
+            const bjtcpu_instr& instr = block.instrs[i];
+            instrAddr = block.addrs[i];
+            BJTCPU_TRACE(BJTCPU_TRACE_EXEC, bjtcpu_trace_event::EXEC, cycleCount, instrAddr, (uint8_t)instr.op, instr.target);
+            BJTCPU_PROFILER(retire(instrAddr));
+            BJTCPU_FUZZ_HOOK(registers(instr, instrAddr));
+
+            if (instr.op == bjtcpu_op::PUSH) {
+                push(regFile[instr.srcX]);
+            } else if (instr.op == bjtcpu_op::POP) {
+                pop(instr.dest);
+            } else {
+                execute(instr);
+            }
+
+            BJTCPU_FUZZ_HOOK(edge(instrAddr, block.addrs[i + 1], regFile, flags.get(), cycleCount < dmaEnd));
+        }
+
+        // only the final instruction can observe the PC
+        instrAddr = block.lastAddr;
+        pcReg = block.endAddr;
+        cycleCount += block.cycles;
+        instrCount += count;
+
+        BJTCPU_TRACE(BJTCPU_TRACE_EXEC, bjtcpu_trace_event::EXEC, cycleCount, instrAddr, (uint8_t)block.instrs[count - 1].op, block.instrs[count - 1].target);
+        BJTCPU_PROFILER(retire(instrAddr));
+        BJTCPU_FUZZ_HOOK(registers(block.instrs[count - 1], instrAddr));
+        executeWhole(block.instrs[count - 1]);
+        BJTCPU_FUZZ_HOOK(edge(instrAddr, pcReg, regFile, flags.get(), cycleCount < dmaEnd));
+
+        maxCycles -= block.cycles;
+        maxInstrs -= count;
+        ranBlock = true;
+    }
+
+    return ranBlock;
+}
+
+void bjtcpu::clearBlocks() {
+    for (size_t i = 0; i < blockCount; i++) {
+        blockIndex[blocks[i].startAddr] = -1;
+    }
+
+    blockCount = 0;
+
+    #if BJTCPU_NATIVE_BLOCKS
+    jit.clear();
+    #endif
+}
+
+#if BJTCPU_NATIVE_BLOCKS
+void bjtcpu::runNative(bjtcpu_jit_fn native) {
+    jitContext.lastValue = flags.carry() ? 1 : 0;
+    jitContext.value = 0;
+    jitContext.source = bjtcpu_jit_context::NONE;
+
+    native(&jitContext);
+
+    if (jitContext.source != bjtcpu_jit_context::NONE) {
+        flags.update(jitContext.lastValue, jitContext.value, jitContext.source == bjtcpu_jit_context::ADD);
+    }
+}
+#endif
+
+// taken-ness of a conditional jump for the current flags
+static bool jumpTaken(const bjtcpu_lazy_flags& flags, bjtcpu_op op) {
+    switch (op) {
+        case bjtcpu_op::JMPZ:
+            return flags.zero();
+        case bjtcpu_op::JMPN:
+            return flags.negative();
+        case bjtcpu_op::JMPC:
+            return flags.carry();
+        default:
+            return flags.overflow();
+    }
+}
+
+bool bjtcpu::runFused(uint64_t maxCycles, uint64_t maxInstrs) {
+    #if BJTCPU_FUSION
+    const bjtcpu_instr& first = decoded[pcReg];
+    if (stopped || instrFetchIdx != 0) {
+        return false;
+    }
+
+    const bjtcpu_fusion_info& info = fusionInfo(first.fusion);
+    if (info.cycles > maxCycles || info.count > maxInstrs) {
+        return false;
+    }
+
+    uint16_t addr = pcReg;
+
+    // same end state as the instructions one at a time - instrAddr is left on
+    // the last one executed
+    switch (first.fusion) {
+        case bjtcpu_fusion::SCRATCH_CMP: {
+            // the pushed copy stays in the stack bank and is popped straight
+            // back, so only the slot write and the compare are visible - the
+            // compare runs between the two, with rsp one past the slot
+            uint8_t scratch = first.srcX;
+            const bjtcpu_instr& imm = decoded[addr + 2];
+            const bjtcpu_instr& cmp = decoded[addr + 4];
+
+            writeRAM(0xFF, regFile[REG_SP], regFile[scratch]);
+
+            auto operand = [&](uint8_t reg) -> uint8_t {
+                if (reg == scratch) {
+                    return imm.imm;
+                }
+                return reg == REG_SP ? regFile[REG_SP] + 1 : regFile[reg];
+            };
+
+            uint8_t firstValue = operand(cmp.srcX);
+            uint8_t secondValue = operand(cmp.srcY);
+            updateFlags(firstValue, firstValue - secondValue, false);
+
+            instrAddr = addr + 6;
+            pcReg = addr + info.len;
+            cycleCount += info.cycles;
+            instrCount += info.count;
+            break;
+        }
+        case bjtcpu_fusion::AND:
+            regFile[first.dest] = regFile[first.srcX] & regFile[first.srcY];
+
+            instrAddr = addr + 2;
+            pcReg = addr + info.len;
+            cycleCount += info.cycles;
+            instrCount += info.count;
+            break;
+        case bjtcpu_fusion::CMP_BRANCH: {
+            const bjtcpu_instr& branch = decoded[addr + 2];
+
+            uint8_t firstValue = regFile[first.srcX];
+            updateFlags(firstValue, firstValue - regFile[first.srcY], false);
+
+            // a taken branch never reaches the jmp
+            if (jumpTaken(flags, branch.op)) {
+                instrAddr = addr + 2;
+                pcReg = branch.target;
+                cycleCount += first.cycles + branch.cycles;
+                instrCount += 2;
+            } else {
+                instrAddr = addr + 5;
+                pcReg = decoded[addr + 5].target;
+                cycleCount += info.cycles;
+                instrCount += info.count;
+            }
+            break;
+        }
+        case bjtcpu_fusion::SPIN_LOOP:
+            if (!runSpinLoop(maxCycles, maxInstrs)) {
+                return false;
+            }
+            break;
+        default:
+            return false;
+    }
+
+    fusionCounts[(size_t)first.fusion]++;
+
+    return true;
+    #else
+    (void)maxCycles;
+    (void)maxInstrs;
+    return false;
+    #endif
+}
+
+// where an iteration of a spin loop left it, and what it cost to get there
+struct spin_exit {
+    uint16_t from;
+    uint16_t to;
+    uint64_t cycles;
+    uint64_t instrs;
+};
+
+// one iteration of the spin loop at head on copies of the registers and
+// flags - true if it leaves the loop
+static bool runSpinIteration(const bjtcpu_instr* decoded, uint16_t head, std::array<uint8_t, 0x10>& regs,
+    bjtcpu_lazy_flags& flags, spin_exit& exit) {
+    uint16_t addr = head;
+    exit.cycles = 0;
+    exit.instrs = 0;
+
+    while (true) {
+        const bjtcpu_instr& instr = decoded[addr];
+        uint16_t next = addr + instr.len;
+
+        exit.cycles += instr.cycles;
+        exit.instrs++;
+
+        switch (instr.op) {
+            case bjtcpu_op::IMM:
+                regs[instr.dest] = instr.imm;
+                break;
+            case bjtcpu_op::ADD:
+            case bjtcpu_op::IADD:
+            case bjtcpu_op::SUB:
+            case bjtcpu_op::ISUB: {
+                uint8_t lastValue = regs[instr.dest];
+                uint8_t y = instr.op == bjtcpu_op::IADD || instr.op == bjtcpu_op::ISUB ? instr.imm : regs[instr.srcY];
+                bool sub = instr.op == bjtcpu_op::SUB || instr.op == bjtcpu_op::ISUB;
+
+                regs[instr.dest] = sub ? regs[instr.srcX] - y : regs[instr.srcX] + y;
+                flags.update(lastValue, regs[instr.dest], true);
+                break;
+            }
+            case bjtcpu_op::NAND:
+                regs[instr.dest] = ~(regs[instr.srcX] & regs[instr.srcY]);
+                break;
+            case bjtcpu_op::CMP:
+                flags.update(regs[instr.srcX], regs[instr.srcX] - regs[instr.srcY], false);
+                break;
+            case bjtcpu_op::JMP:
+                return false;
+            case bjtcpu_op::JMPZ:
+            case bjtcpu_op::JMPN:
+            case bjtcpu_op::JMPC:
+            case bjtcpu_op::JMPO: {
+                bool taken = jumpTaken(flags, instr.op);
+
+                // the jump back continues the loop when taken, an exit leaves it
+                if (instr.target == head ? !taken : taken) {
+                    exit.from = addr;
+                    exit.to = taken ? instr.target : next;
+                    return true;
+                }
+                if (instr.target == head) {
+                    return false;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        addr = next;
+    }
+}
+
+bool bjtcpu::runSpinLoop(uint64_t maxCycles, uint64_t maxInstrs) {
+    uint16_t head = pcReg;
+
+    bjtcpu_spin_loop loop;
+    if (!spinLoop(decoded, head, loop)) {
+        return false;
+    }
+
+    // iterations are a function of the induction register, which comes back
+    // round after period of them
+    uint64_t period = 0x100 / std::gcd<uint64_t>(loop.step, 0x100);
+    uint64_t fit = std::min(maxCycles / loop.cycles, maxInstrs / loop.count);
+    uint8_t start = loop.induction < 0x10 ? regFile[loop.induction] : 0;
+
+    std::array<uint8_t, 0x10> regs = regFile;
+    bjtcpu_lazy_flags loopFlags = flags;
+    spin_exit exit;
+
+    // only as far as the budget could reach
+    uint64_t exitIteration = UINT64_MAX;
+    for (uint64_t i = 0; i < std::min(period, fit + 1); i++) {
+        if (runSpinIteration(decoded, head, regs, loopFlags, exit)) {
+            exitIteration = i;
+            break;
+        }
+    }
+
+    if (exitIteration != UINT64_MAX) {
+        uint64_t cycles = exitIteration * loop.cycles + exit.cycles;
+        uint64_t instrs = exitIteration * loop.count + exit.instrs;
+
+        if (cycles <= maxCycles && instrs <= maxInstrs) {
+            regFile = regs;
+            flags = loopFlags;
+            instrAddr = exit.from;
+            pcReg = exit.to;
+            cycleCount += cycles;
+            instrCount += instrs;
+            return true;
+        }
+    }
+
+    // otherwise as many whole iterations as fit, back at the head - the last
+    // one is run again from its induction value for the registers it leaves
+    uint64_t iterations = std::min(fit, exitIteration);
+    if (iterations == 0) {
+        return false;
+    }
+
+    regs = regFile;
+    loopFlags = flags;
+    if (loop.induction < 0x10) {
+        regs[loop.induction] = start + (iterations - 1) * loop.step;
+    }
+    runSpinIteration(decoded, head, regs, loopFlags, exit);
+
+    regFile = regs;
+    flags = loopFlags;
+    instrAddr = head + loop.backEdge;
+    cycleCount += iterations * loop.cycles;
+    instrCount += iterations * loop.count;
+
+    return true;
+}
+
+// cost of each stdlib routine for its inputs, from the spans of its code - the
+// offsets are those in the listings in hle.cpp
+
+// iterations of a loop counting down to zero, 256 when it starts there
+static uint64_t loopCount(uint8_t count) {
+    return count ? count : 0x100;
+}
+
+// iterations of std_shlr that take the .addbit path
+static uint64_t rotateCarries(uint8_t value, uint64_t count) {
+    uint64_t carries = 0;
+
+    for (uint64_t i = 0; i < count; i++) {
+        carries += value >> 7;
+        value = (value << 1) | (value >> 7);
+    }
+
+    return carries;
+}
+
+static bjtcpu_hle_cost multiplyCost(const bjtcpu_hle_code& code, uint8_t rb) {
+    uint64_t count = loopCount(rb);
+    return code.span(0x00, 0x04) + code.span(0x04, 0x13) * count + code.span(0x13, 0x16) * (count - 1) +
+        code.span(0x16, 0x1B);
+}
+
+static bjtcpu_hle_cost shlCost(const bjtcpu_hle_code& code, uint8_t rb) {
+    uint64_t count = loopCount(rb);
+    return code.span(0x00, 0x04) + code.span(0x04, 0x0E) * count + code.span(0x0E, 0x11) * (count - 1) +
+        code.span(0x11, 0x13);
+}
 
-    instrFetchIdx = 0;
-    instrStageIdx = 0;
+static bjtcpu_hle_cost shlrCost(const bjtcpu_hle_code& code, uint8_t ra, uint8_t rb) {
+    uint64_t count = loopCount(rb);
+    uint64_t carries = rotateCarries(ra, count);
 
-    regFile.fill(0);
-    flagsReg = 0;
+    bjtcpu_hle_cost carry = code.span(0x04, 0x09) + code.span(0x0C, 0x17);
+    bjtcpu_hle_cost noCarry = code.span(0x04, 0x0C) + code.span(0x0F, 0x17);
+
+    return code.span(0x00, 0x04) + carry * carries + noCarry * (count - carries) +
+        code.span(0x17, 0x1A) * (count - 1) + code.span(0x1A, 0x1C);
+}
 
-    ram.fill(0);
+static bjtcpu_hle_cost memsetCost(const bjtcpu_hle_code& code, uint8_t rb) {
+    uint64_t count = loopCount(rb);
+    return code.span(0x00, 0x06) + code.span(0x06, 0x13) * count + code.span(0x13, 0x16) * (count - 1) +
+        code.span(0x16, 0x19);
+}
 
-    stopped = false;
+static bjtcpu_hle_cost memcpyCost(const bjtcpu_hle_code& code, uint8_t ra) {
+    uint64_t count = loopCount(ra);
+    return code.span(0x00, 0x06) + code.span(0x06, 0x15) * count + code.span(0x15, 0x18) * (count - 1) +
+        code.span(0x18, 0x1B);
 }
 
-void bjtcpu::loadROM(uint8_t* bytes, size_t size) {
-    rom.fill(0);
-    std::memcpy(rom.data(), bytes, size);
+#if BJTCPU_HLE
+// only runHLE() needs these two, the native routines charge their own spans
+
+static bjtcpu_hle_cost shrCost(const bjtcpu_hle_code& code, const bjtcpu_hle_code& shlr, uint8_t ra, uint8_t rb) {
+    return code.span(0x00, 0x0C) + shlrCost(shlr, ra, 0x08 - rb) + code.span(0x0C, 0x0E);
 }
 
-void bjtcpu::step() {
-    if (stopped) {
-        return;
+// the byte count at rbp + 3 is the rbnk pushed alongside it and the counter
+// at rbp + 2 starts at ra, so it takes at most 256 passes to meet
+static bjtcpu_hle_cost memcmpBound(const bjtcpu_hle_code& code) {
+    bjtcpu_hle_cost pass = code.span(0x08, 0x11) + code.span(0x16, 0x2A) + code.span(0x2A, 0x32);
+    return code.span(0x00, 0x08) + pass * 0x100 + code.span(0x11, 0x16) + code.span(0x32, 0x35) +
+        code.span(0x35, 0x39);
+}
+#endif
+
+bool bjtcpu::runHLE(uint64_t maxCycles, uint64_t maxInstrs) {
+    #if BJTCPU_HLE
+    bjtcpu_hle_routine routine = hle.find(pcReg);
+    if (routine == bjtcpu_hle_routine::NONE || stopped || instrFetchIdx != 0) {
+        return false;
     }
 
-    if (instrFetchIdx == 0 || instrFetchIdx < getInstrLen(instrReg[0])) {
-        instrReg[instrFetchIdx] = rom[pcReg];
-        instrFetchIdx++;
-        pcReg++;
+    const bjtcpu_hle_code& code = hle.getCode(routine);
+    bjtcpu_hle_cost cost;
 
-        return;
+    switch (routine) {
+        case bjtcpu_hle_routine::MULTIPLY:
+            cost = multiplyCost(code, regFile[REG_B]);
+            break;
+        case bjtcpu_hle_routine::SHL:
+            cost = shlCost(code, regFile[REG_B]);
+            break;
+        case bjtcpu_hle_routine::SHLR:
+            cost = shlrCost(code, regFile[REG_A], regFile[REG_B]);
+            break;
+        case bjtcpu_hle_routine::SHR:
+            cost = shrCost(code, hle.getCode(bjtcpu_hle_routine::SHLR), regFile[REG_A], regFile[REG_B]);
+            break;
+        case bjtcpu_hle_routine::MEMSET:
+            cost = memsetCost(code, regFile[REG_B]);
+            break;
+        case bjtcpu_hle_routine::MEMCPY:
+            // the byte count is reloaded from the stack every iteration, where
+            // a copy within the stack bank could overwrite it
+            if (regFile[REG_BNK] == 0xFF) {
+                return false;
+            }
+            cost = memcpyCost(code, regFile[REG_A]);
+            break;
+        case bjtcpu_hle_routine::MEMCMP:
+            // only bounded when rbp is the frame the call just made
+            if (regFile[REG_BP] != regFile[REG_SP]) {
+                return false;
+            }
+            cost = memcmpBound(code);
+            break;
+        default:
+            return false;
     }
 
-    uint8_t opcode = instrReg[0];
-    uint8_t destReg = instrReg[0] & 0xF;
+    if (cost.cycles > maxCycles || cost.instrs > maxInstrs) {
+        return false;
+    }
 
-    uint8_t displayReg = regFile[REG_DIS];
+    switch (routine) {
+        case bjtcpu_hle_routine::MULTIPLY:
+            hleMultiply(code);
+            break;
+        case bjtcpu_hle_routine::SHL:
+            hleShl(code);
+            break;
+        case bjtcpu_hle_routine::SHLR:
+            hleShlr(code);
+            break;
+        case bjtcpu_hle_routine::SHR:
+            hleShr(code, hle.getCode(bjtcpu_hle_routine::SHLR));
+            break;
+        case bjtcpu_hle_routine::MEMSET:
+            hleMemset(code);
+            break;
+        case bjtcpu_hle_routine::MEMCPY:
+            hleMemcpy(code);
+            break;
+        default:
+            hleMemcmp(code);
+            break;
+    }
 
-    bool cycleFinished = true;
+    hleCounts[(size_t)routine]++;
+
+    return true;
+    #else
+    (void)maxCycles;
+    (void)maxInstrs;
+    return false;
+    #endif
+}
 
-    switch ((opcode >> 4) & 0xF) {
-        case 0x0: {
-            if (opcode == OP_STOP) {
-                stopped = true;
-                return;
+// the native routines leave every register, flag and RAM byte as the ROM code
+// would. Values only the final loop iteration leaves behind (scratch stack
+// slots, flags) are written once
 
-            } else if (opcode == OP_RET) {
-                retFuncStep();
+void bjtcpu::hleMultiply(const bjtcpu_hle_code& code) {
+    charge(multiplyCost(code, regFile[REG_B]));
 
-            } else if (opcode == OP_PCALL) {
-                callFuncStep(true);
-            }
+    uint8_t product = regFile[REG_A] * loopCount(regFile[REG_B]);
+
+    push(regFile[REG_C]);                               // push rc
+    regFile[REG_B] = 0;                                 // .loop until rb is 0
+    push(product);                                      // push rc, final iteration
+    pop(REG_C);                                         // pop rc
+
+    uint8_t lastValue = regFile[REG_A];                 // cpy ra rc
+    regFile[REG_A] = regFile[REG_C];
+    updateFlags(lastValue, regFile[REG_A], true);
+
+    pop(REG_C);                                         // pop rc
+
+    instrAddr = code.addr + 0x1A;                       // ret
+    retFunc();
+}
+
+void bjtcpu::hleShl(const bjtcpu_hle_code& code) {
+    charge(shlCost(code, regFile[REG_B]));
+
+    uint64_t count = loopCount(regFile[REG_B]);
+
+    push(regFile[REG_C]);                               // push rc
+    regFile[REG_A] = count < 8 ? regFile[REG_A] << count : 0;
+    regFile[REG_B] = 0;
+    updateFlags(0, 0, false);                           // cmp rb rc, final iteration
+    pop(REG_C);                                         // pop rc
+
+    instrAddr = code.addr + 0x12;                       // ret
+    retFunc();
+}
+
+void bjtcpu::hleShlr(const bjtcpu_hle_code& code) {
+    charge(shlrCost(code, regFile[REG_A], regFile[REG_B]));
+
+    uint64_t count = loopCount(regFile[REG_B]) % 8;
+
+    push(regFile[REG_C]);                               // push rc
+    regFile[REG_A] = (regFile[REG_A] << count) | (regFile[REG_A] >> ((8 - count) % 8));
+    regFile[REG_B] = 0;
+    updateFlags(0, 0, false);                           // cmp rb rc, final iteration
+    pop(REG_C);                                         // pop rc
+
+    instrAddr = code.addr + 0x1B;                       // ret
+    retFunc();
+}
+
+void bjtcpu::hleShr(const bjtcpu_hle_code& code, const bjtcpu_hle_code& shlr) {
+    charge(code.span(0x00, 0x0C) + code.span(0x0C, 0x0E));
+
+    push(regFile[REG_C]);                               // push rc
+    regFile[REG_C] = 0x08;                              // imm rc 0x08
+
+    uint8_t lastValue = regFile[REG_C];                 // sub rc rc rb
+    regFile[REG_C] -= regFile[REG_B];
+    updateFlags(lastValue, regFile[REG_C], true);
+
+    lastValue = regFile[REG_B];                         // cpy rb rc
+    regFile[REG_B] = regFile[REG_C];
+    updateFlags(lastValue, regFile[REG_B], true);
+
+    instrAddr = code.addr + 0x09;                       // call std_shlr
+    pcReg = code.addr + 0x0C;
+    callFunc(false);
+    hleShlr(shlr);
+
+    pop(REG_C);                                         // pop rc
+
+    instrAddr = code.addr + 0x0D;                       // ret
+    retFunc();
+}
+
+void bjtcpu::hleMemset(const bjtcpu_hle_code& code) {
+    charge(memsetCost(code, regFile[REG_B]));
+
+    uint64_t count = loopCount(regFile[REG_B]);
+
+    push(regFile[REG_ADDR]);                            // push radr
+    push(regFile[REG_C]);                               // push rc
+
+    // may write over the pushed registers when rbnk is the stack bank, the
+    // pops below read back whatever is there
+    for (uint64_t i = 0; i < count; i++) {
+        writeRAM(regFile[REG_BNK], regFile[REG_ADDR]++, regFile[REG_A]);
+    }
+
+    regFile[REG_B] = 0;
+    updateFlags(0, 0, false);                           // cmp rb rc, final iteration
+
+    pop(REG_C);                                         // pop rc
+    pop(REG_ADDR);                                      // pop radr
+
+    instrAddr = code.addr + 0x18;                       // ret
+    retFunc();
+}
+
+void bjtcpu::hleMemcpy(const bjtcpu_hle_code& code) {
+    charge(memcpyCost(code, regFile[REG_A]));
+
+    uint64_t count = loopCount(regFile[REG_A]);
+    uint8_t bank = regFile[REG_BNK];
+
+    push(regFile[REG_ADDR]);                            // push radr
+    push(regFile[REG_C]);                               // push rc
+
+    // byte at a time in order, so overlapping ranges copy the same way
+    for (uint64_t i = 0; i < count; i++) {
+        uint8_t value = readRAM(bank, regFile[REG_ADDR] + i);
+        writeRAM(bank, regFile[REG_B] + i, value);
+    }
+
+    push(regFile[REG_A]);                               // push ra, final iteration
+    pop(REG_A);                                         // pop ra
+    regFile[REG_C] = regFile[REG_A];                    // counter met the byte count
+    updateFlags(regFile[REG_A], 0, false);              // cmp ra rc, final iteration
+
+    pop(REG_C);                                         // pop rc
+    pop(REG_ADDR);                                      // pop radr
+
+    instrAddr = code.addr + 0x1A;                       // ret
+    retFunc();
+}
+
+// instruction for instruction - later passes compare at rc = 2 and count
+// through the stack slots as the ROM code does
+void bjtcpu::hleMemcmp(const bjtcpu_hle_code& code) {
+    push(regFile[REG_C]);                               // push rc
+    regFile[REG_C] = 0x00;                              // imm rc 0x00
+    push(regFile[REG_C]);                               // push rc
+    push(regFile[REG_A]);                               // push ra
+    charge(code.span(0x00, 0x08));
+
+    while (true) {
+        // .loop
+        regFile[REG_A] = readRAM(regFile[REG_BNK], regFile[REG_ADDR] + regFile[REG_C]);   // ldrl ra radr rc
+        regFile[REG_C] = readRAM(regFile[REG_BNK], regFile[REG_B] + regFile[REG_C]);      // ldrl rc rb rc
+        updateFlags(regFile[REG_A], regFile[REG_A] - regFile[REG_C], false);              // cmp ra rc
+        charge(code.span(0x08, 0x11));
+
+        if (!flags.zero()) {                            // jmpz .equal
+            regFile[REG_A] = 0x00;                      // imm ra 0x00
+            charge(code.span(0x11, 0x16));              // jmp .end
             break;
         }
-        case 0x1: {
-            if (opcode == OP_PUSH) {
-                cycleFinished = pushStep(regFile[(instrReg[1] >> 4) & 0xF]);
 
-            } else if (opcode == OP_STO) {
-                writeRAM(regFile[REG_BNK], regFile[REG_ADDR], regFile[(instrReg[1] >> 4) & 0xF]);
+        // .equal
+        push(regFile[REG_BNK]);                         // push rbnk
+        regFile[REG_BNK] = 0xFF;                        // imm rbnk 0xFF
+        regFile[REG_A] = readRAM(0xFF, regFile[REG_BP] + 2);                // imm ra 2; ldrl ra rbp ra
 
-            } else if (opcode == OP_CMP) {
-                uint8_t firstValue = regFile[(instrReg[1] >> 4) & 0xF];
-                uint8_t secondValue = regFile[instrReg[1] & 0xF];
-                updateFlags(firstValue, firstValue - secondValue, false);
-            }
+        uint8_t lastValue = regFile[REG_A];             // iadd ra ra 0x01
+        regFile[REG_A]++;
+        updateFlags(lastValue, regFile[REG_A], true);
+
+        regFile[REG_C] = readRAM(0xFF, regFile[REG_BP] + 3);                // imm rc 3; ldrl rc rbp rc
+        updateFlags(regFile[REG_C], regFile[REG_C] - regFile[REG_A], false); // cmp rc ra
+        charge(code.span(0x16, 0x2A));
+
+        if (flags.zero()) {                             // jmpz .allequal
+            regFile[REG_A] = 0x01;                      // imm ra 0x01
+            pop(REG_BNK);                               // pop rbnk
+            charge(code.span(0x32, 0x35));
             break;
         }
-        case 0x2: {
-            cycleFinished = popStep(destReg);
+
+        regFile[REG_C] = 0x02;                          // imm rc 2
+        writeRAM(regFile[REG_BNK], regFile[REG_BP] + regFile[REG_C], regFile[REG_A]);    // strla rbp rc
+        pop(REG_BNK);                                   // pop rbnk
+        charge(code.span(0x2A, 0x32));                  // jmp .loop
+    }
+
+    // .end
+    pop(REG_C);                                         // pop rc
+    pop(REG_C);                                         // pop rc
+    pop(REG_C);                                         // pop rc
+    charge(code.span(0x35, 0x39));
+
+    instrAddr = code.addr + 0x38;                       // ret
+    retFunc();
+}
+
+void bjtcpu::charge(const bjtcpu_hle_cost& cost) {
+    cycleCount += cost.cycles;
+    instrCount += cost.instrs;
+}
+
+// inline for the same reason as executeNext()
+inline void bjtcpu::executeWhole(const bjtcpu_instr& instr) {
+    switch (instr.op) {
+        case bjtcpu_op::STOP:
+            stopped = true;
             break;
-        }
-        case 0x3: {
-            regFile[destReg] = rom[regFile[REG_BNK] * 0x100 + regFile[REG_ADDR]];
+        case bjtcpu_op::RET:
+            retFunc();
+            break;
+        case bjtcpu_op::PCALL:
+            callFunc(true);
+            break;
+        case bjtcpu_op::CALL:
+            callFunc(false);
+            break;
+        case bjtcpu_op::PUSH:
+            push(regFile[instr.srcX]);
+            break;
+        case bjtcpu_op::POP:
+            pop(instr.dest);
+            break;
+        default:
+            execute(instr);
+            break;
+    }
+}
+
+// kept out of line like startWait(), for the same reason
+BJTCPU_NOINLINE void bjtcpu::executeExt(const bjtcpu_instr& instr) {
+    #if BJTCPU_EXT_DMA
+    refreshDMA(cycleCount);
+    #endif
+
+    executeWhole(instr);
+    handleExtWrites(instr);
+}
+
+void bjtcpu::handleExtWrites(const bjtcpu_instr& instr) {
+    #if BJTCPU_EXT_TIMER
+    startWait(instr);
+    #endif
+
+    #if BJTCPU_EXT_DMA
+    startDMA(instr);
+    #endif
+}
+
+void bjtcpu::execute(const bjtcpu_instr& instr) {
+    switch (instr.op) {
+        case bjtcpu_op::STO:
+            writeRAM(regFile[REG_BNK], regFile[REG_ADDR], regFile[instr.srcX]);
+            break;
+        case bjtcpu_op::CMP: {
+            uint8_t firstValue = regFile[instr.srcX];
+            uint8_t secondValue = regFile[instr.srcY];
+            updateFlags(firstValue, firstValue - secondValue, false);
             break;
         }
-        case 0x4:
-        case 0x5:
-        case 0xC: {
-            uint8_t lastValue = regFile[destReg];
+        case bjtcpu_op::PLDA:
+            regFile[instr.dest] = rom[regFile[REG_BNK] * 0x100 + regFile[REG_ADDR]];
+            break;
+        case bjtcpu_op::ADD:
+        case bjtcpu_op::ADDC:
+        case bjtcpu_op::IADD: {
+            uint8_t lastValue = regFile[instr.dest];
 
-            if (opcode == OP_IADD) {
-                regFile[destReg] = regFile[(instrReg[1] >> 4) & 0xF] + instrReg[2];
+            if (instr.op == bjtcpu_op::IADD) {
+                regFile[instr.dest] = regFile[instr.srcX] + instr.imm;
             } else {
-                regFile[destReg] = regFile[(instrReg[1] >> 4) & 0xF] + regFile[instrReg[1] & 0xF];
+                regFile[instr.dest] = regFile[instr.srcX] + regFile[instr.srcY];
             }
 
-            if ((opcode & 0xF0) == OP_ADDC && FLAG_CMASK(flagsReg)) {
-                regFile[destReg]++;
+            if (instr.op == bjtcpu_op::ADDC && flags.carry()) {
+                regFile[instr.dest]++;
             }
 
-            updateFlags(lastValue, regFile[destReg], true);
+            updateFlags(lastValue, regFile[instr.dest], true);
 
             break;
         }
-        case 0x6: {
-            uint8_t addr = regFile[(instrReg[1] >> 4) & 0xF] + regFile[instrReg[1] & 0xF];
+        case bjtcpu_op::STRLA: {
+            uint8_t addr = regFile[instr.srcX] + regFile[instr.srcY];
             writeRAM(regFile[REG_BNK], addr, regFile[REG_A]);
             break;
         }
-        case 0x7:
-        case 0x8:
-        case 0xD: {
-            uint8_t lastValue = regFile[destReg];
+        case bjtcpu_op::SUB:
+        case bjtcpu_op::SUBC:
+        case bjtcpu_op::ISUB: {
+            uint8_t lastValue = regFile[instr.dest];
             
-            if (opcode == OP_ISUB) {
-                regFile[destReg] = regFile[(instrReg[1] >> 4) & 0xF] - instrReg[2];
+            if (instr.op == bjtcpu_op::ISUB) {
+                regFile[instr.dest] = regFile[instr.srcX] - instr.imm;
             } else {
-                regFile[destReg] = regFile[(instrReg[1] >> 4) & 0xF] - regFile[instrReg[1] & 0xF];
+                regFile[instr.dest] = regFile[instr.srcX] - regFile[instr.srcY];
             }
             
-            if ((opcode & 0xF0) == OP_SUBC && FLAG_CMASK(flagsReg)) {
-                regFile[destReg]++;
+            if (instr.op == bjtcpu_op::SUBC && flags.carry()) {
+                regFile[instr.dest]++;
             }
             
-            updateFlags(lastValue, regFile[destReg], true);
+            updateFlags(lastValue, regFile[instr.dest], true);
             
             break;
         }
-        case 0x9: {
-            uint8_t addr = regFile[(instrReg[1] >> 4) & 0xF] + regFile[instrReg[1] & 0xF];
-            regFile[destReg] = readRAM(regFile[REG_BNK], addr);
+        case bjtcpu_op::LDRL: {
+            uint8_t addr = regFile[instr.srcX] + regFile[instr.srcY];
+            regFile[instr.dest] = readRAM(regFile[REG_BNK], addr);
             break;
         }
-        case 0xA: {
-            regFile[destReg] = instrReg[1];
+        case bjtcpu_op::IMM:
+            regFile[instr.dest] = instr.imm;
             break;
-        }
-        case 0xB: {
-            regFile[destReg] = ~(regFile[(instrReg[1] >> 4) & 0xF] & regFile[instrReg[1] & 0xF]);
+        case bjtcpu_op::NAND:
+            regFile[instr.dest] = ~(regFile[instr.srcX] & regFile[instr.srcY]);
             break;
-        }
-        case 0xE: {
-            if (opcode == OP_CALL) {
-                cycleFinished = callFuncStep(true);
-                break;
+        case bjtcpu_op::JMP:
+            pcReg = instr.target;
+            break;
+        case bjtcpu_op::JMPZ:
+            if (flags.zero()) {
+                pcReg = instr.target;
             }
-
-            if (opcode == OP_JMP ||
-                opcode == OP_JMPZ && FLAG_ZMASK(flagsReg) ||
-                opcode == OP_JMPN && FLAG_NMASK(flagsReg) ||
-                opcode == OP_JMPC && FLAG_CMASK(flagsReg) ||
-                opcode == OP_JMPO && FLAG_OMASK(flagsReg)) {
-                pcReg = (instrReg[1] << 8) | instrReg[2];
+            break;
+        case bjtcpu_op::JMPN:
+            if (flags.negative()) {
+                pcReg = instr.target;
             }
-            
             break;
-        }
-        case 0xF: {
-            regFile[destReg] = readRAM(regFile[REG_BNK], regFile[REG_ADDR]);
+        case bjtcpu_op::JMPC:
+            if (flags.carry()) {
+                pcReg = instr.target;
+            }
+            break;
+        case bjtcpu_op::JMPO:
+            if (flags.overflow()) {
+                pcReg = instr.target;
+            }
+            break;
+        case bjtcpu_op::LDA:
+            regFile[instr.dest] = readRAM(regFile[REG_BNK], regFile[REG_ADDR]);
+            break;
+        default:
             break;
-        }
     }
 
-    printf("%d     %d\n", displayReg, regFile[REG_DIS]);
-    #if BJTCPU_EXT_DISPLAY
-    if (displayReg != regFile[REG_DIS]) {
-        display.sendSignal(regFile[REG_DIS]);
-        printf("%d\n", regFile[REG_DIS]);
+    #if BJTCPU_MEMSTATS
+    if (writesReg(instr, REG_BNK)) {
+        memstats.bankWrite(regFile[REG_BNK]);
     }
     #endif
 
-    instrStageIdx++;
-
-    if (cycleFinished) {
-        endCycle();
-    }
-}
-
-uint8_t bjtcpu::getInstrLen(uint8_t opcode) {
-    opcode = (opcode & 0xF0) >> 4;
-
-    switch (opcode) {
-        case 0x0:
-        case 0x2:
-        case 0x3:
-        case 0xF:
-            return 1;
-        
-        case 0x1:
-        case 0x4:
-        case 0x5:
-        case 0x6:
-        case 0x7:
-        case 0x8:
-        case 0x9:
-        case 0xA:
-        case 0xB:
-            return 2;
-        
-        case 0xC:
-        case 0xD:
-        case 0xE:
-            return 3;
+    #if BJTCPU_REWIND
+    if (writesReg(instr, instr.dest)) {
+        rewind.regWrite(cycleCount, instr.dest, regFile[instr.dest]);
     }
-
-    return 0;
+    #endif
 }
 
 bool bjtcpu::callFuncStep(bool funcInAddr) {
@@ -223,10 +1260,19 @@ bool bjtcpu::callFuncStep(bool funcInAddr) {
             return false;
         case 5:
             regFile[REG_SP]++;
-            pcReg = (instrReg[1] << 8) | instrReg[2];
+            BJTCPU_MEMSTATS_HOOK(stackPointer(regFile[REG_SP]));
+            BJTCPU_FUZZ_HOOK(stackGrow(regFile[REG_SP], 3, instrAddr));
+            if (funcInAddr) {
+                pcReg = (regFile[REG_BNK] << 8) | regFile[REG_ADDR];
+            } else {
+                pcReg = decoded[instrAddr].target;
+            }
+            BJTCPU_TRACE(BJTCPU_TRACE_CALL, bjtcpu_trace_event::CALL, cycleCount, instrAddr, 0, pcReg);
             return false;
         case 6:
             regFile[REG_BP] = regFile[REG_SP];
+            BJTCPU_PROFILER(call(instrAddr, pcReg, cycleCount));
+            BJTCPU_MEMSTATS_HOOK(call());
             break;
     }
 
@@ -249,9 +1295,13 @@ bool bjtcpu::retFuncStep() {
             return false;
         case 4:
             regFile[REG_SP]--;
+            BJTCPU_FUZZ_HOOK(stackShrink(regFile[REG_SP], 3, instrAddr));
             return false;
         case 5:
             regFile[REG_BP] = readRAM(0xFF, regFile[REG_SP]);
+            BJTCPU_TRACE(BJTCPU_TRACE_CALL, bjtcpu_trace_event::RET, cycleCount, instrAddr, 0, pcReg);
+            BJTCPU_PROFILER(ret(cycleCount));
+            BJTCPU_MEMSTATS_HOOK(ret());
             break;
     }
     
@@ -264,6 +1314,8 @@ bool bjtcpu::pushStep(uint8_t value) {
         return false;
     } else if (instrStageIdx == 1) {
         regFile[REG_SP]++;
+        BJTCPU_MEMSTATS_HOOK(stackPointer(regFile[REG_SP]));
+        BJTCPU_FUZZ_HOOK(stackGrow(regFile[REG_SP], 1, instrAddr));
     }
 
     return true;
@@ -272,46 +1324,178 @@ bool bjtcpu::pushStep(uint8_t value) {
 bool bjtcpu::popStep(uint8_t reg) {
     if (instrStageIdx == 0) {
         regFile[REG_SP]--;
+        BJTCPU_FUZZ_HOOK(stackShrink(regFile[REG_SP], 1, instrAddr));
         return false;
     } else if (instrStageIdx == 1) {
         regFile[reg] = readRAM(0xFF, regFile[REG_SP]);
+        BJTCPU_REWIND_HOOK(regWrite(cycleCount, reg, regFile[reg]));
+
+        if (reg == REG_BNK) {
+            BJTCPU_MEMSTATS_HOOK(bankWrite(regFile[REG_BNK]));
+        }
     }
 
     return true;
 }
 
+// whole-instruction equivalents of the stage functions above, used by runInstruction()
+
+void bjtcpu::callFunc(bool funcInAddr) {
+    writeRAM(0xFF, regFile[REG_SP]++, regFile[REG_BP]);
+    writeRAM(0xFF, regFile[REG_SP]++, pcReg & 0xFF);
+    writeRAM(0xFF, regFile[REG_SP]++, (pcReg >> 8) & 0xFF);
+    BJTCPU_FUZZ_HOOK(stackGrow(regFile[REG_SP], 3, instrAddr));
+
+    if (funcInAddr) {
+        pcReg = (regFile[REG_BNK] << 8) | regFile[REG_ADDR];
+    } else {
+        pcReg = decoded[instrAddr].target;
+    }
+
+    regFile[REG_BP] = regFile[REG_SP];
+
+    BJTCPU_TRACE(BJTCPU_TRACE_CALL, bjtcpu_trace_event::CALL, cycleCount, instrAddr, 0, pcReg);
+    BJTCPU_PROFILER(call(instrAddr, pcReg, cycleCount));
+    BJTCPU_MEMSTATS_HOOK(stackPointer(regFile[REG_SP]));
+    BJTCPU_MEMSTATS_HOOK(call());
+}
+
+void bjtcpu::retFunc() {
+    regFile[REG_SP] = regFile[REG_BP] - 1;
+    pcReg = readRAM(0xFF, regFile[REG_SP]--) << 8;
+    pcReg |= readRAM(0xFF, regFile[REG_SP]--);
+    regFile[REG_BP] = readRAM(0xFF, regFile[REG_SP]);
+    BJTCPU_FUZZ_HOOK(stackShrink(regFile[REG_SP], 3, instrAddr));
+
+    BJTCPU_TRACE(BJTCPU_TRACE_CALL, bjtcpu_trace_event::RET, cycleCount, instrAddr, 0, pcReg);
+    BJTCPU_PROFILER(ret(cycleCount));
+    BJTCPU_MEMSTATS_HOOK(ret());
+}
+
+void bjtcpu::push(uint8_t value) {
+    writeRAM(0xFF, regFile[REG_SP]++, value);
+    BJTCPU_MEMSTATS_HOOK(stackPointer(regFile[REG_SP]));
+    BJTCPU_FUZZ_HOOK(stackGrow(regFile[REG_SP], 1, instrAddr));
+}
+
+void bjtcpu::pop(uint8_t reg) {
+    regFile[REG_SP]--;
+    BJTCPU_FUZZ_HOOK(stackShrink(regFile[REG_SP], 1, instrAddr));
+    regFile[reg] = readRAM(0xFF, regFile[REG_SP]);
+    BJTCPU_REWIND_HOOK(regWrite(cycleCount, reg, regFile[reg]));
+
+    if (reg == REG_BNK) {
+        BJTCPU_MEMSTATS_HOOK(bankWrite(regFile[REG_BNK]));
+    }
+}
+
+void bjtcpu::keyframe() {
+    #if BJTCPU_REWIND
+    if (rewind.keyframeDue(cycleCount)) {
+        rewind.addKeyframe(saveState());
+    }
+    #endif
+}
+
 void bjtcpu::endCycle() {
+    instrCount++;
+    BJTCPU_PROFILER(retire(instrAddr));
+
     instrReg.fill(0);
     instrFetchIdx = 0;
     instrStageIdx = 0;
+
+    BJTCPU_FUZZ_HOOK(edge(instrAddr, pcReg, regFile, flags.get(), cycleCount < dmaEnd));
 }
 
 void bjtcpu::updateFlags(uint8_t lastValue, uint8_t value, bool add) {
-    flagsReg = 0;
+    flags.update(lastValue, value, add);
+}
+
+void bjtcpu::updateDisplay(uint8_t lastValue) {
+    #if BJTCPU_EXT_DISPLAY
+    if (lastValue != regFile[REG_DIS]) {
+        BJTCPU_TRACE(BJTCPU_TRACE_CALL, bjtcpu_trace_event::DISPLAY, cycleCount, instrAddr, regFile[REG_DIS], 0);
+        BJTCPU_REWIND_HOOK(display(cycleCount, regFile[REG_DIS]));
+        BJTCPU_FUZZ_HOOK(sideEffect());
+        display.sendSignal(regFile[REG_DIS]);
+    }
+    #endif
+}
 
-    if (value == 0) {
-        flagsReg |= (1 << FLAG_ZBIT);
+#if BJTCPU_EXT_TIMER
+// kept out of line, inlined it slows down the interpreter loop that checks for it
+BJTCPU_NOINLINE void bjtcpu::startWait(const bjtcpu_instr& instr) {
+    if (!writesReg(instr, REG_TIM)) {
+        return;
     }
 
-    if (value > 0x7F) {
-        flagsReg |= (1 << FLAG_NBIT);
+    wakeCycle = timer.wakeCycle(cycleCount, regFile[REG_TIM]);
+    BJTCPU_TRACE(BJTCPU_TRACE_CALL, bjtcpu_trace_event::WAIT, cycleCount, instrAddr, regFile[REG_TIM],
+        (uint16_t)std::min<uint64_t>(wakeCycle - cycleCount, UINT16_MAX));
+}
+#endif
+
+#if BJTCPU_EXT_DMA
+void bjtcpu::refreshDMA(uint64_t cycle) {
+    regFile[REG_DMA] = cycle < dmaEnd ? 1 : 0;
+}
 
-        if (lastValue <= 0x7F) {
-            flagsReg |= (1 << FLAG_OBIT);
-        }
+void bjtcpu::startDMA(const bjtcpu_instr& instr) {
+    if (!writesReg(instr, REG_DMA)) {
+        return;
     }
 
-    if (add && lastValue > value) {
-        flagsReg |= (1 << FLAG_CBIT);
+    bool fill = regFile[REG_DMA] & 1;
+    uint8_t length = regFile[REG_DMA_LEN];
+    size_t bytes = length == 0 ? 0x100 : length;
+
+    #if !BJTCPU_HOOKS
+    if (fill) {
+        ram.fill(regFile[REG_DMA_DSTB], regFile[REG_DMA_DSTA], regFile[REG_DMA_SRCA], bytes);
+    } else {
+        ram.move(regFile[REG_DMA_DSTB], regFile[REG_DMA_DSTA], regFile[REG_DMA_SRCB], regFile[REG_DMA_SRCA], bytes);
+    }
+    #else
+    // a byte at a time so the stats, rewind and fuzz hooks see every access,
+    // all read before any are written as memmove would
+    std::array<uint8_t, 0x100> buffer;
+    for (size_t i = 0; i < bytes; i++) {
+        buffer[i] = fill ? regFile[REG_DMA_SRCA] : readRAM(regFile[REG_DMA_SRCB], regFile[REG_DMA_SRCA] + i);
     }
+    for (size_t i = 0; i < bytes; i++) {
+        writeRAM(regFile[REG_DMA_DSTB], regFile[REG_DMA_DSTA] + i, buffer[i]);
+    }
+    #endif
+
+    dmaEnd = dma.endCycle(cycleCount, dmaEnd, length);
+    refreshDMA(cycleCount);
+
+    BJTCPU_TRACE(BJTCPU_TRACE_CALL, bjtcpu_trace_event::DMA, cycleCount, instrAddr, fill ? 1 : 0, bytes);
 }
+#endif
 
 void bjtcpu::writeRAM(uint8_t bank, uint8_t addr, uint8_t value) {
-    ram[bank * 0x100 + addr] = value;
+    BJTCPU_MEMSTATS_HOOK(write(bank, addr));
+    BJTCPU_REWIND_HOOK(ramWrite(cycleCount, bank, addr, value));
+    BJTCPU_FUZZ_HOOK(sideEffect());
+    BJTCPU_TRACE(BJTCPU_TRACE_MEM, bjtcpu_trace_event::RAM_WRITE, cycleCount, instrAddr, value, (bank << 8) | addr);
+    ram.write(bank, addr, value);
 }
 
 uint8_t bjtcpu::readRAM(uint8_t bank, uint8_t addr) {
-    return ram[bank * 0x100 + addr];
+    BJTCPU_MEMSTATS_HOOK(read(bank, addr));
+    return ram.read(bank, addr);
+}
+
+void bjtcpu::loadRAM(uint16_t addr, const uint8_t* bytes, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        uint16_t target = addr + i;
+        ram.write(target >> 8, target & 0xFF, bytes[i]);
+    }
+
+    BJTCPU_REWIND_HOOK(clear());
+    keyframe();
 }
 
 uint8_t bjtcpu::readROM(uint8_t bank, uint8_t addr) {
@@ -319,9 +1503,19 @@ uint8_t bjtcpu::readROM(uint8_t bank, uint8_t addr) {
 }
 
 uint8_t bjtcpu::getRegValue(uint8_t reg) {
+    #if BJTCPU_EXT_DMA
+    if (reg == REG_DMA) {
+        return cycleCount < dmaEnd ? 1 : 0;
+    }
+    #endif
+
     return regFile[reg];
 }
 
+uint8_t bjtcpu::getFlagsValue() {
+    return flags.get();
+}
+
 uint16_t bjtcpu::getPCValue() {
     return pcReg;
 }
@@ -330,44 +1524,125 @@ uint8_t bjtcpu::getIRValue(uint8_t idx) {
     return instrReg[idx];
 }
 
+uint64_t bjtcpu::getCycleCount() {
+    return cycleCount;
+}
+
+uint64_t bjtcpu::getInstrCount() {
+    return instrCount;
+}
+
+bool bjtcpu::isStopped() {
+    return stopped;
+}
+
+bool bjtcpu::isWaiting() {
+    return cycleCount < wakeCycle;
+}
+
+uint64_t bjtcpu::getWaitCycles() {
+    return cycleCount < wakeCycle ? wakeCycle - cycleCount : 0;
+}
+
+uint64_t bjtcpu::getFusionCount(bjtcpu_fusion fusion) {
+    return fusionCounts[(size_t)fusion];
+}
+
+size_t bjtcpu::enableHLE(const bjtcpu_symbols& symbols) {
+    hle.clear();
+
+    #if BJTCPU_HLE
+    return hle.bind(rom, decoded, symbols);
+    #else
+    (void)symbols;
+    return 0;
+    #endif
+}
+
+void bjtcpu::disableHLE() {
+    hle.clear();
+}
+
+uint64_t bjtcpu::getHLECount(bjtcpu_hle_routine routine) {
+    return hleCounts[(size_t)routine];
+}
+
 #if BJTCPU_EXT_DISPLAY
 bjtcpu_display& bjtcpu::getDisplay() {
     return display;
 }
 #endif
 
-bjtcpu_display::bjtcpu_display() {
-    clear();
-    cursorX = 0;
-    cursorY = 0;
+#if BJTCPU_EXT_TIMER
+bjtcpu_timer& bjtcpu::getTimer() {
+    return timer;
 }
+#endif
 
-void bjtcpu_display::sendSignal(uint8_t value) {
-    uint8_t opcode = value & 0xC0;
-    
-    if (value == 1) {
-        clear();
-    } else if (opcode == 0x40) {
-        cursorX = value & 0x3F;
-    } else if (opcode == 0x80) {
-        cursorY = value & 0x3F;
-    } else if (opcode == 0xC0) {
-        writePixel(value & 0xF);
+#if BJTCPU_EXT_DMA
+bjtcpu_dma& bjtcpu::getDMA() {
+    return dma;
+}
+
+uint64_t bjtcpu::getDMACycles() {
+    return cycleCount < dmaEnd ? dmaEnd - cycleCount : 0;
+}
+#endif
+
+#if BJTCPU_TRACE_LEVEL > BJTCPU_TRACE_NONE
+bjtcpu_trace_ring& bjtcpu::getTrace() {
+    return trace;
+}
+#endif
+
+#if BJTCPU_MEMSTATS
+bjtcpu_memstats& bjtcpu::getMemStats() {
+    return memstats;
+}
+#endif
+
+#if BJTCPU_FUZZ
+bjtcpu_fuzz_monitor& bjtcpu::getFuzzMonitor() {
+    return fuzz;
+}
+#endif
+
+#if BJTCPU_REWIND
+bjtcpu_rewind& bjtcpu::getRewind() {
+    return rewind;
+}
+
+bool bjtcpu::seek(uint64_t cycle) {
+    if (cycle >= cycleCount) {
+        runCycles(cycle - cycleCount);
+        return true;
+    }
+
+    const bjtcpu_state* state = rewind.findKeyframe(cycle);
+    if (!state) {
+        return false;
     }
+
+    restoreState(*state);
+    rewind.truncate(cycleCount);
+
+    runCycles(cycle - cycleCount);
+    return true;
 }
 
-uint8_t* bjtcpu_display::getFramebuffer() {
-    return framebuffer.data();
+bool bjtcpu::stepBack() {
+    return cycleCount > 0 && seek(cycleCount - 1);
 }
 
-void bjtcpu_display::clear() {
-    framebuffer.fill(0);
+bool bjtcpu::runBackToWrite(uint8_t bank, uint8_t addr) {
+    uint64_t cycle;
+    return rewind.findLastWrite(bank, addr, cycleCount, cycle) && seek(cycle);
 }
+#endif
 
-void bjtcpu_display::writePixel(uint8_t colour) {
-    colour = colour / 16 * 255;
-    framebuffer[cursorX + cursorY * 64 * 3] = colour;
-    framebuffer[cursorX + cursorY * 64 * 3 + 1] = colour;
-    framebuffer[cursorX + cursorY * 64 * 3 + 2] = colour;
-    printf("pixel at %d, %d\n", cursorX, cursorY);
-}
\ No newline at end of file
+#if BJTCPU_PROFILE
+bjtcpu_profiler& bjtcpu::getProfiler() {
+    profiler.sync(cycleCount);
+    return profiler;
+}
+#endif
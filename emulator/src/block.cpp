@@ -0,0 +1,96 @@
+#include "block.hpp"
+
+static constexpr int MAX_BLOCK_INSTRS = 64;
+
+bool isBlockEnd(const bjtcpu_instr& instr) {
+    switch (instr.op) {
+        case bjtcpu_op::STOP:
+        case bjtcpu_op::RET:
+        case bjtcpu_op::PCALL:
+        case bjtcpu_op::CALL:
+        case bjtcpu_op::JMP:
+        case bjtcpu_op::JMPZ:
+        case bjtcpu_op::JMPN:
+        case bjtcpu_op::JMPC:
+        case bjtcpu_op::JMPO:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool writesReg(const bjtcpu_instr& instr, uint8_t reg) {
+    switch (instr.op) {
+        case bjtcpu_op::POP:
+        case bjtcpu_op::PLDA:
+        case bjtcpu_op::ADD:
+        case bjtcpu_op::ADDC:
+        case bjtcpu_op::IADD:
+        case bjtcpu_op::SUB:
+        case bjtcpu_op::SUBC:
+        case bjtcpu_op::ISUB:
+        case bjtcpu_op::LDRL:
+        case bjtcpu_op::IMM:
+        case bjtcpu_op::NAND:
+        case bjtcpu_op::LDA:
+            return instr.dest == reg;
+        default:
+            return false;
+    }
+}
+
+bool readsReg(const bjtcpu_instr& instr, uint8_t reg) {
+    switch (instr.op) {
+        case bjtcpu_op::PUSH:
+        case bjtcpu_op::STO:
+            return instr.srcX == reg;
+        case bjtcpu_op::IADD:
+        case bjtcpu_op::ISUB:
+            return instr.srcX == reg || instr.dest == reg;
+        case bjtcpu_op::CMP:
+        case bjtcpu_op::STRLA:
+        case bjtcpu_op::LDRL:
+        case bjtcpu_op::NAND:
+            return instr.srcX == reg || instr.srcY == reg;
+        case bjtcpu_op::ADD:
+        case bjtcpu_op::ADDC:
+        case bjtcpu_op::SUB:
+        case bjtcpu_op::SUBC:
+            return instr.srcX == reg || instr.srcY == reg || instr.dest == reg;
+        default:
+            return false;
+    }
+}
+
+void translateBlock(const bjtcpu_instr* decoded, uint16_t pc, bjtcpu_block& block) {
+    block.instrs.clear();
+    block.addrs.clear();
+    block.startAddr = pc;
+    block.lastAddr = pc;
+    block.endAddr = pc;
+    block.cycles = 0;
+    block.native = nullptr;
+
+    uint16_t addr = pc;
+
+    for (int i = 0; i < MAX_BLOCK_INSTRS; i++) {
+        const bjtcpu_instr& instr = decoded[addr];
+
+        if (writesReg(instr, REG_DIS) || instr.extReg) {
+            break;
+        }
+
+        block.instrs.push_back(instr);
+        block.addrs.push_back(addr);
+        block.lastAddr = addr;
+        block.cycles += instr.cycles;
+
+        addr += instr.len;
+        block.endAddr = addr;
+
+        // stop at the end of ROM rather than wrapping mid block
+        if (isBlockEnd(instr) || addr < block.lastAddr) {
+            break;
+        }
+    }
+}
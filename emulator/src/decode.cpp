@@ -0,0 +1,357 @@
+#include "decode.hpp"
+#include "block.hpp"
+
+#include <array>
+
+bjtcpu_instr decodeInstr(uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+    bjtcpu_instr instr;
+    instr.op = bjtcpu_op::NOP;
+    instr.dest = byte0 & 0xF;
+    instr.srcX = (byte1 >> 4) & 0xF;
+    instr.srcY = byte1 & 0xF;
+    instr.imm = byte1;
+    instr.fusion = bjtcpu_fusion::NONE;
+    instr.extReg = false;
+    instr.target = (byte1 << 8) | byte2;
+
+    switch ((byte0 >> 4) & 0xF) {
+        case 0x0:
+            instr.len = 1;
+            if (byte0 == OP_STOP) {
+                instr.op = bjtcpu_op::STOP;
+            } else if (byte0 == OP_RET) {
+                instr.op = bjtcpu_op::RET;
+            } else if (byte0 == OP_PCALL) {
+                instr.op = bjtcpu_op::PCALL;
+            }
+            break;
+        case 0x1:
+            instr.len = 2;
+            if (byte0 == OP_PUSH) {
+                instr.op = bjtcpu_op::PUSH;
+            } else if (byte0 == OP_STO) {
+                instr.op = bjtcpu_op::STO;
+            } else if (byte0 == OP_CMP) {
+                instr.op = bjtcpu_op::CMP;
+            }
+            break;
+        case 0x2:
+            instr.len = 1;
+            instr.op = bjtcpu_op::POP;
+            break;
+        case 0x3:
+            instr.len = 1;
+            instr.op = bjtcpu_op::PLDA;
+            break;
+        case 0x4:
+            instr.len = 2;
+            instr.op = bjtcpu_op::ADD;
+            break;
+        case 0x5:
+            instr.len = 2;
+            instr.op = bjtcpu_op::ADDC;
+            break;
+        case 0x6:
+            instr.len = 2;
+            instr.op = bjtcpu_op::STRLA;
+            break;
+        case 0x7:
+            instr.len = 2;
+            instr.op = bjtcpu_op::SUB;
+            break;
+        case 0x8:
+            instr.len = 2;
+            instr.op = bjtcpu_op::SUBC;
+            break;
+        case 0x9:
+            instr.len = 2;
+            instr.op = bjtcpu_op::LDRL;
+            break;
+        case 0xA:
+            instr.len = 2;
+            instr.op = bjtcpu_op::IMM;
+            break;
+        case 0xB:
+            instr.len = 2;
+            instr.op = bjtcpu_op::NAND;
+            break;
+        case 0xC:
+            instr.len = 3;
+            instr.op = bjtcpu_op::IADD;
+            instr.imm = byte2;
+            break;
+        case 0xD:
+            instr.len = 3;
+            instr.op = bjtcpu_op::ISUB;
+            instr.imm = byte2;
+            break;
+        case 0xE:
+            instr.len = 3;
+            if (byte0 == OP_JMP) {
+                instr.op = bjtcpu_op::JMP;
+            } else if (byte0 == OP_JMPZ) {
+                instr.op = bjtcpu_op::JMPZ;
+            } else if (byte0 == OP_JMPN) {
+                instr.op = bjtcpu_op::JMPN;
+            } else if (byte0 == OP_JMPC) {
+                instr.op = bjtcpu_op::JMPC;
+            } else if (byte0 == OP_JMPO) {
+                instr.op = bjtcpu_op::JMPO;
+            } else if (byte0 == OP_CALL) {
+                instr.op = bjtcpu_op::CALL;
+            }
+            break;
+        case 0xF:
+            instr.len = 1;
+            instr.op = bjtcpu_op::LDA;
+            break;
+    }
+
+    // one step per byte fetched, plus one per execute stage
+    instr.cycles = instr.len + 1;
+
+    if (instr.op == bjtcpu_op::PUSH || instr.op == bjtcpu_op::POP) {
+        instr.cycles = instr.len + 2;
+    } else if (instr.op == bjtcpu_op::CALL || instr.op == bjtcpu_op::PCALL) {
+        instr.cycles = instr.len + 7;
+    } else if (instr.op == bjtcpu_op::RET) {
+        instr.cycles = instr.len + 6;
+    }
+
+    instr.extReg = writesReg(instr, REG_TIM) || writesReg(instr, REG_DMA) || readsReg(instr, REG_DMA);
+
+    return instr;
+}
+
+void decodeROM(const uint8_t* rom, bjtcpu_instr* decoded) {
+    for (int addr = 0; addr < 0x10000; addr++) {
+        decoded[addr] = decodeInstr(rom[addr], rom[(addr + 1) & 0xFFFF], rom[(addr + 2) & 0xFFFF]);
+    }
+
+    fuseROM(decoded, 0, 0x10000);
+}
+
+static const bjtcpu_fusion_info FUSION_INFO[] = {
+    { "none",        1, 0, 0 },
+    { "scratch_cmp", 4, 7, 13 },
+    { "and",         2, 4, 6 },
+    { "cmp_branch",  3, 8, 11 },
+    { "spin_loop",   0, 0, 0 },
+};
+
+const bjtcpu_fusion_info& fusionInfo(bjtcpu_fusion fusion) {
+    return FUSION_INFO[(size_t)fusion];
+}
+
+static bool isConditionalJump(bjtcpu_op op) {
+    return op == bjtcpu_op::JMPZ || op == bjtcpu_op::JMPN || op == bjtcpu_op::JMPC || op == bjtcpu_op::JMPO;
+}
+
+bool spinLoop(const bjtcpu_instr* decoded, uint32_t head, bjtcpu_spin_loop& loop) {
+    uint16_t written = 0;       // registers written so far this iteration
+    uint16_t carried = 0;       // read before being written, so from the previous iteration
+    std::array<uint8_t, 0x10> writes = {};
+    std::array<bool, 0x10> stepped = {};    // the only write is iadd/isub r r k
+    std::array<uint8_t, 0x10> steps = {};
+    bool flagsSet = false;
+    bool flagsCarried = false;  // a jump reads flags before the iteration sets them
+    std::array<uint16_t, bjtcpu_spin_loop::MAX_INSTRS> exits;
+    uint8_t exitCount = 0;
+
+    loop.cycles = 0;
+
+    uint32_t addr = head;
+
+    for (uint8_t count = 1; count <= bjtcpu_spin_loop::MAX_INSTRS; count++) {
+        const bjtcpu_instr& instr = decoded[addr];
+        if (addr + instr.len > 0x10000) {
+            return false;
+        }
+
+        uint16_t reads = 0;
+        bool writesDest = false;
+        bool setsFlags = false;
+
+        switch (instr.op) {
+            case bjtcpu_op::NOP:
+                break;
+            case bjtcpu_op::IMM:
+                writesDest = true;
+                break;
+            // the carry flag compares against the dest's previous value, so an
+            // ALU op reads its dest as well
+            case bjtcpu_op::IADD:
+            case bjtcpu_op::ISUB:
+                reads = (1 << instr.srcX) | (1 << instr.dest);
+                writesDest = true;
+                setsFlags = true;
+                stepped[instr.dest] = instr.dest == instr.srcX && writes[instr.dest] == 0;
+                steps[instr.dest] = instr.op == bjtcpu_op::IADD ? instr.imm : -instr.imm;
+                break;
+            case bjtcpu_op::ADD:
+            case bjtcpu_op::SUB:
+                reads = (1 << instr.srcX) | (1 << instr.srcY) | (1 << instr.dest);
+                writesDest = true;
+                setsFlags = true;
+                break;
+            case bjtcpu_op::NAND:
+                reads = (1 << instr.srcX) | (1 << instr.srcY);
+                writesDest = true;
+                break;
+            case bjtcpu_op::CMP:
+                reads = (1 << instr.srcX) | (1 << instr.srcY);
+                setsFlags = true;
+                break;
+            case bjtcpu_op::JMP:
+            case bjtcpu_op::JMPZ:
+            case bjtcpu_op::JMPN:
+            case bjtcpu_op::JMPC:
+            case bjtcpu_op::JMPO:
+                if (instr.op != bjtcpu_op::JMP && !flagsSet) {
+                    flagsCarried = true;
+                }
+
+                if (instr.target == head) {
+                    loop.count = count;
+                    loop.len = addr + instr.len - head;
+                    loop.backEdge = addr - head;
+                    loop.cycles += instr.cycles;
+
+                    for (uint8_t i = 0; i < exitCount; i++) {
+                        if (exits[i] >= head && exits[i] < head + loop.len) {
+                            return false;
+                        }
+                    }
+
+                    // flags from the previous iteration, unless nothing sets them
+                    if (flagsCarried && flagsSet) {
+                        return false;
+                    }
+
+                    // registers the next iteration sees from this one
+                    uint16_t state = carried & written;
+                    loop.induction = 0x10;
+                    loop.step = 0;
+
+                    if (state == 0) {
+                        return true;
+                    }
+
+                    for (uint8_t reg = 0; reg < 0x10; reg++) {
+                        if (state == 1 << reg) {
+                            loop.induction = reg;
+                            loop.step = steps[reg];
+                            return writes[reg] == 1 && stepped[reg];
+                        }
+                    }
+                    return false;
+                }
+
+                if (instr.op == bjtcpu_op::JMP) {
+                    return false;
+                }
+                exits[exitCount++] = instr.target;
+                break;
+            default:
+                return false;
+        }
+
+        carried |= reads & ~written;
+        flagsSet |= setsFlags;
+
+        if (instr.extReg) {
+            return false;
+        }
+
+        if (writesDest) {
+            if (instr.dest == REG_DIS) {
+                return false;
+            }
+            writes[instr.dest]++;
+            written |= 1 << instr.dest;
+        }
+
+        loop.cycles += instr.cycles;
+        addr += instr.len;
+    }
+
+    return false;
+}
+
+static bjtcpu_fusion detectFusion(const bjtcpu_instr* decoded, uint32_t addr) {
+    const bjtcpu_instr& first = decoded[addr];
+
+    bjtcpu_spin_loop loop;
+    if (spinLoop(decoded, addr, loop)) {
+        return bjtcpu_fusion::SPIN_LOOP;
+    }
+
+    switch (first.op) {
+        case bjtcpu_op::PUSH: {
+            if (addr + fusionInfo(bjtcpu_fusion::SCRATCH_CMP).len > 0x10000) {
+                break;
+            }
+
+            uint8_t scratch = first.srcX;
+            const bjtcpu_instr& imm = decoded[addr + 2];
+            const bjtcpu_instr& cmp = decoded[addr + 4];
+            const bjtcpu_instr& pop = decoded[addr + 6];
+
+            if (scratch <= REG_C && imm.op == bjtcpu_op::IMM && imm.dest == scratch && cmp.op == bjtcpu_op::CMP &&
+                pop.op == bjtcpu_op::POP && pop.dest == scratch) {
+                return bjtcpu_fusion::SCRATCH_CMP;
+            }
+            break;
+        }
+        case bjtcpu_op::NAND: {
+            if (addr + fusionInfo(bjtcpu_fusion::AND).len > 0x10000 || first.dest == REG_DIS) {
+                break;
+            }
+
+            const bjtcpu_instr& invert = decoded[addr + 2];
+
+            if (invert.op == bjtcpu_op::NAND && invert.dest == first.dest && invert.srcX == first.dest &&
+                invert.srcY == first.dest) {
+                return bjtcpu_fusion::AND;
+            }
+            break;
+        }
+        case bjtcpu_op::CMP: {
+            if (addr + fusionInfo(bjtcpu_fusion::CMP_BRANCH).len > 0x10000) {
+                break;
+            }
+
+            if (isConditionalJump(decoded[addr + 2].op) && decoded[addr + 5].op == bjtcpu_op::JMP) {
+                return bjtcpu_fusion::CMP_BRANCH;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+
+    return bjtcpu_fusion::NONE;
+}
+
+// any of the count instructions from addr - spinLoop() checks its own
+static bool hasExtReg(const bjtcpu_instr* decoded, uint32_t addr, uint8_t count) {
+    for (uint8_t i = 0; i < count && addr < 0x10000; i++) {
+        if (decoded[addr].extReg) {
+            return true;
+        }
+        addr += decoded[addr].len;
+    }
+    return false;
+}
+
+void fuseROM(bjtcpu_instr* decoded, uint32_t begin, uint32_t end) {
+    for (uint32_t addr = begin; addr < end; addr++) {
+        bjtcpu_fusion fusion = detectFusion(decoded, addr);
+
+        if (hasExtReg(decoded, addr, fusionInfo(fusion).count)) {
+            fusion = bjtcpu_fusion::NONE;
+        }
+
+        decoded[addr].fusion = fusion;
+    }
+}
@@ -0,0 +1,266 @@
+#include "display.hpp"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+bjtcpu_palette greyscalePalette() {
+    bjtcpu_palette palette;
+    for (uint32_t level = 0; level < 16; level++) {
+        uint32_t grey = level * 0x11;
+        palette.colours[level] = 0xFF000000 | (grey << 16) | (grey << 8) | grey;
+    }
+    return palette;
+}
+
+bjtcpu_display::bjtcpu_display() {
+    reset();
+}
+
+void bjtcpu_display::reset() {
+    clear(0);
+    cursorX = 0;
+    cursorY = 0;
+    anchorX = 0;
+    anchorY = 0;
+    autoIncrement = false;
+}
+
+void bjtcpu_display::sendSignal(uint8_t value) {
+    uint8_t opcode = value & 0xC0;
+    
+    if (opcode == 0x40) {
+        cursorX = value & 0x3F;
+    } else if (opcode == 0x80) {
+        cursorY = value & 0x3F;
+    } else if (opcode == 0xC0) {
+        writePixel(value & 0xF);
+    } else {
+        switch (value & 0xF0) {
+            case 0x00:
+                if (value == 0x01) {
+                    clear(0);
+                } else if (value == 0x02 || value == 0x03) {
+                    autoIncrement = value == 0x03;
+                } else if (value == 0x04) {
+                    anchorX = cursorX;
+                    anchorY = cursorY;
+                }
+                break;
+            case 0x10:
+                fillSpan(cursorY, anchorX, cursorX, value & 0xF);
+                break;
+            case 0x20:
+                fillRect(value & 0xF);
+                break;
+            case 0x30:
+                clear(value & 0xF);
+                break;
+        }
+    }
+}
+
+const uint8_t* bjtcpu_display::getPixels() const {
+    return pixels.data();
+}
+
+bool bjtcpu_display::isDirty() const {
+    return dirty;
+}
+
+void bjtcpu_display::clearDirty() {
+    dirty = false;
+}
+
+uint8_t bjtcpu_display::getCursorX() const {
+    return cursorX;
+}
+
+uint8_t bjtcpu_display::getCursorY() const {
+    return cursorY;
+}
+
+uint8_t bjtcpu_display::getAnchorX() const {
+    return anchorX;
+}
+
+uint8_t bjtcpu_display::getAnchorY() const {
+    return anchorY;
+}
+
+bool bjtcpu_display::isAutoIncrement() const {
+    return autoIncrement;
+}
+
+void bjtcpu_display::load(const uint8_t* pixels, uint8_t cursorX, uint8_t cursorY, uint8_t anchorX, uint8_t anchorY,
+    bool autoIncrement) {
+    std::copy(pixels, pixels + this->pixels.size(), this->pixels.begin());
+    // a state file can hold anything, keep the cursor and anchor on the
+    // screen as sendSignal() does
+    this->cursorX = cursorX & 0x3F;
+    this->cursorY = cursorY & 0x3F;
+    this->anchorX = anchorX & 0x3F;
+    this->anchorY = anchorY & 0x3F;
+    this->autoIncrement = autoIncrement;
+    dirty = true;
+}
+
+void bjtcpu_display::clear(uint8_t colour) {
+    pixels.fill(colour * 0x11);
+    dirty = true;
+}
+
+void bjtcpu_display::writePixel(uint8_t colour) {
+    uint8_t& pair = pixels[(cursorY * BJTCPU_DISPLAY_WIDTH + cursorX) / 2];
+
+    if (cursorX & 1) {
+        pair = (pair & 0x0F) | (colour << 4);
+    } else {
+        pair = (pair & 0xF0) | colour;
+    }
+
+    // along the row, then on to the next, wrapping from the bottom to the top
+    if (autoIncrement) {
+        cursorX = (cursorX + 1) & 0x3F;
+        if (cursorX == 0) {
+            cursorY = (cursorY + 1) & 0x3F;
+        }
+    }
+
+    dirty = true;
+}
+
+void bjtcpu_display::fillSpan(uint8_t y, uint8_t x0, uint8_t x1, uint8_t colour) {
+    int first = std::min(x0, x1);
+    int last = std::max(x0, x1);
+
+    uint8_t* row = pixels.data() + y * BJTCPU_DISPLAY_WIDTH / 2;
+
+    // an odd first or even last pixel shares its byte with one outside the span
+    if (first & 1) {
+        row[first / 2] = (row[first / 2] & 0x0F) | (colour << 4);
+        first++;
+    }
+    if (first <= last && !(last & 1)) {
+        row[last / 2] = (row[last / 2] & 0xF0) | colour;
+        last--;
+    }
+    if (first < last) {
+        std::fill(row + first / 2, row + last / 2 + 1, colour * 0x11);
+    }
+
+    dirty = true;
+}
+
+void bjtcpu_display::fillRect(uint8_t colour) {
+    uint8_t y0 = std::min(anchorY, cursorY);
+    uint8_t y1 = std::max(anchorY, cursorY);
+
+    for (uint8_t y = y0; y <= y1; y++) {
+        fillSpan(y, anchorX, cursorX, colour);
+    }
+}
+
+// both colours for every packed byte, rebuilt when the palette changes
+struct pair_table {
+    bjtcpu_palette palette{};
+    std::array<uint64_t, 0x100> pairs{};
+    bool built = false;
+};
+
+static const pair_table& pairTable(const bjtcpu_palette& palette) {
+    thread_local pair_table table;
+
+    if (!table.built || table.palette.colours != palette.colours) {
+        for (int byte = 0; byte < 0x100; byte++) {
+            table.pairs[byte] = ((uint64_t)palette.colours[byte >> 4] << 32) | palette.colours[byte & 0xF];
+        }
+        table.palette = palette;
+        table.built = true;
+    }
+
+    return table;
+}
+
+static void expandScalar(const uint8_t* packed, size_t count, uint32_t* out, const bjtcpu_palette& palette) {
+    const pair_table& table = pairTable(palette);
+
+    for (size_t i = 0; i < count / 2; i++) {
+        uint64_t pair = table.pairs[packed[i]];
+        out[i * 2] = (uint32_t)pair;
+        out[i * 2 + 1] = (uint32_t)(pair >> 32);
+    }
+}
+
+#if defined(__AVX2__)
+
+// 16 packed bytes to 32 palette indices in pixel order
+static inline __m128i unpackIndices(__m128i bytes, __m128i& high) {
+    __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i even = _mm_and_si128(bytes, mask);
+    __m128i odd = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+    high = _mm_unpackhi_epi8(even, odd);
+    return _mm_unpacklo_epi8(even, odd);
+}
+
+// each block of 8 indices selects from the two halves of the palette with vpermd
+static inline void expand8(__m128i indices, __m256i low, __m256i high, uint32_t* out) {
+    __m256i index = _mm256_cvtepu8_epi32(indices);
+    __m256i fromLow = _mm256_permutevar8x32_epi32(low, index);
+    __m256i fromHigh = _mm256_permutevar8x32_epi32(high, index);
+    __m256i useHigh = _mm256_cmpgt_epi32(index, _mm256_set1_epi32(7));
+    _mm256_storeu_si256((__m256i*)out, _mm256_blendv_epi8(fromLow, fromHigh, useHigh));
+}
+
+void expandPixels(const uint8_t* packed, size_t count, uint32_t* out, const bjtcpu_palette& palette) {
+    __m256i low = _mm256_loadu_si256((const __m256i*)palette.colours.data());
+    __m256i high = _mm256_loadu_si256((const __m256i*)(palette.colours.data() + 8));
+
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m128i upper;
+        __m128i lower = unpackIndices(_mm_loadu_si128((const __m128i*)(packed + i / 2)), upper);
+
+        expand8(lower, low, high, out + i);
+        expand8(_mm_srli_si128(lower, 8), low, high, out + i + 8);
+        expand8(upper, low, high, out + i + 16);
+        expand8(_mm_srli_si128(upper, 8), low, high, out + i + 24);
+    }
+
+    expandScalar(packed + i / 2, count - i, out + i, palette);
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+// SSE2 has no byte shuffle to look colours up in registers, and selecting
+// each index with compares costs several times the table, so the pair table
+// still does the lookup - each packed byte already holds both nibbles - and
+// two pairs are joined with punpcklqdq into one 4 pixel store
+void expandPixels(const uint8_t* packed, size_t count, uint32_t* out, const bjtcpu_palette& palette) {
+    const uint64_t* pairs = pairTable(palette).pairs.data();
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const uint8_t* bytes = packed + i / 2;
+        __m128i first = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)&pairs[bytes[0]]),
+            _mm_loadl_epi64((const __m128i*)&pairs[bytes[1]]));
+        __m128i second = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)&pairs[bytes[2]]),
+            _mm_loadl_epi64((const __m128i*)&pairs[bytes[3]]));
+        _mm_storeu_si128((__m128i*)(out + i), first);
+        _mm_storeu_si128((__m128i*)(out + i + 4), second);
+    }
+
+    expandScalar(packed + i / 2, count - i, out + i, palette);
+}
+
+#else
+
+void expandPixels(const uint8_t* packed, size_t count, uint32_t* out, const bjtcpu_palette& palette) {
+    expandScalar(packed, count, out, palette);
+}
+
+#endif
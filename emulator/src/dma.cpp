@@ -0,0 +1,20 @@
+#include "dma.hpp"
+
+#include <algorithm>
+
+bjtcpu_dma::bjtcpu_dma() {
+    byteCycles = BJTCPU_DMA_BYTE_CYCLES;
+}
+
+uint64_t bjtcpu_dma::endCycle(uint64_t cycle, uint64_t busyUntil, uint8_t length) const {
+    uint64_t bytes = length == 0 ? 0x100 : length;
+    return std::max(cycle, busyUntil) + bytes * byteCycles;
+}
+
+void bjtcpu_dma::setByteCycles(uint8_t cycles) {
+    byteCycles = cycles;
+}
+
+uint8_t bjtcpu_dma::getByteCycles() const {
+    return byteCycles;
+}
@@ -0,0 +1,49 @@
+#include "dump.hpp"
+#include "fileio.hpp"
+#include "opcodes.hpp"
+
+#include <stdio.h>
+#include <vector>
+
+bool dumpRegs(const std::string& path, uint16_t pc, const uint8_t* instrReg, const uint8_t* regFile,
+    uint64_t cycles, uint64_t instrs) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "pc %04x\n", pc);
+    fprintf(file, "ir %02x %02x %02x\n", instrReg[0], instrReg[1], instrReg[2]);
+    fprintf(file, "ra %02x\n", regFile[REG_A]);
+    fprintf(file, "rb %02x\n", regFile[REG_B]);
+    fprintf(file, "rc %02x\n", regFile[REG_C]);
+    fprintf(file, "rsp %02x\n", regFile[REG_SP]);
+    fprintf(file, "rbp %02x\n", regFile[REG_BP]);
+    fprintf(file, "rbnk %02x\n", regFile[REG_BNK]);
+    fprintf(file, "radr %02x\n", regFile[REG_ADDR]);
+    fprintf(file, "cycles %llu\n", (unsigned long long)cycles);
+    fprintf(file, "instrs %llu\n", (unsigned long long)instrs);
+
+    fclose(file);
+    return true;
+}
+
+bool dumpRAM(const std::string& path, const uint8_t* ram) {
+    return writeFile(path, ram, 0x10000);
+}
+
+bool dumpFramebuffer(const std::string& path, const uint8_t* pixels, const bjtcpu_palette& palette) {
+    std::vector<uint32_t> colours(BJTCPU_DISPLAY_PIXELS);
+    expandPixels(pixels, colours.size(), colours.data(), palette);
+
+    std::string header = "P6\n64 64\n255\n";
+
+    std::vector<uint8_t> image(header.begin(), header.end());
+    for (uint32_t colour : colours) {
+        image.push_back((colour >> 16) & 0xFF);
+        image.push_back((colour >> 8) & 0xFF);
+        image.push_back(colour & 0xFF);
+    }
+
+    return writeFile(path, image.data(), image.size());
+}
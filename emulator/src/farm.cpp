@@ -0,0 +1,149 @@
+#include "farm.hpp"
+
+#include <algorithm>
+
+bjtcpu_farm::bjtcpu_farm(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        workers.push_back(std::make_unique<worker>());
+    }
+
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i]->thread = std::thread(&bjtcpu_farm::workerLoop, this, std::ref(*workers[i]), i);
+    }
+}
+
+bjtcpu_farm::~bjtcpu_farm() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    startCond.notify_all();
+
+    for (std::unique_ptr<worker>& w : workers) {
+        w->thread.join();
+    }
+}
+
+std::vector<bjtcpu_farm_result> bjtcpu_farm::run(const std::vector<bjtcpu_farm_job>& jobs, const inspect_fn& inspect) {
+    std::vector<bjtcpu_farm_result> results(jobs.size());
+    if (jobs.empty()) {
+        return results;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    this->jobs = &jobs;
+    this->results = &results;
+    this->inspect = inspect ? &inspect : nullptr;
+
+    size_t count = workers.size();
+    for (size_t i = 0; i < count; i++) {
+        workers[i]->next.store(jobs.size() * i / count, std::memory_order_relaxed);
+        workers[i]->end = jobs.size() * (i + 1) / count;
+    }
+
+    busy = count;
+    generation++;
+    startCond.notify_all();
+
+    doneCond.wait(lock, [this]() { return busy == 0; });
+
+    this->jobs = nullptr;
+    this->results = nullptr;
+    this->inspect = nullptr;
+
+    return results;
+}
+
+unsigned bjtcpu_farm::getThreadCount() const {
+    return workers.size();
+}
+
+void bjtcpu_farm::workerLoop(worker& self, size_t index) {
+    uint64_t seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            startCond.wait(lock, [&]() { return quit || generation != seen; });
+            if (quit) {
+                return;
+            }
+            seen = generation;
+        }
+
+        size_t job;
+        while (claim(index, job)) {
+            runJob(self, job);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy--;
+        }
+        doneCond.notify_one();
+    }
+}
+
+// own range first, then steal from the others in turn
+bool bjtcpu_farm::claim(size_t index, size_t& job) {
+    for (size_t i = 0; i < workers.size(); i++) {
+        worker& victim = *workers[(index + i) % workers.size()];
+
+        if (victim.next.load(std::memory_order_relaxed) >= victim.end) {
+            continue;
+        }
+
+        job = victim.next.fetch_add(1, std::memory_order_relaxed);
+        if (job < victim.end) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void bjtcpu_farm::runJob(worker& self, size_t job) {
+    const bjtcpu_farm_job& spec = (*jobs)[job];
+    bjtcpu_farm_result& result = (*results)[job];
+
+    if (!self.cpu) {
+        self.cpu = std::make_unique<bjtcpu>();
+    }
+
+    bjtcpu& cpu = *self.cpu;
+
+    // keeps the translated blocks while consecutive jobs share an image
+    if (spec.rom != cpu.getROM()) {
+        cpu.setROM(spec.rom);
+    }
+
+    cpu.setEngine(spec.engine);
+
+    if (spec.initialState) {
+        result.ok = cpu.resetTo(*spec.initialState);
+    } else {
+        cpu.reset();
+        result.ok = true;
+    }
+
+    if (result.ok) {
+        cpu.runCycles(spec.cycles);
+    }
+
+    result.stopped = cpu.isStopped();
+    result.pc = cpu.getPCValue();
+    for (int i = 0; i < 0x10; i++) {
+        result.regFile[i] = cpu.getRegValue(i);
+    }
+    result.cycles = cpu.getCycleCount();
+    result.instrs = cpu.getInstrCount();
+
+    if (inspect) {
+        (*inspect)(job, cpu);
+    }
+}
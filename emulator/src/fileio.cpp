@@ -0,0 +1,141 @@
+#include "fileio.hpp"
+
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+bool readFile(const std::string& path, std::vector<uint8_t>& data) {
+    std::fstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file.seekg(0, std::ios::end);
+    size_t fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    data.assign(fileSize, 0);
+    file.read((char*)data.data(), fileSize);
+
+    return !file.fail();
+}
+
+bool writeFile(const std::string& path, const void* data, size_t size) {
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    file.write((const char*)data, size);
+
+    return !file.fail();
+}
+
+bjtcpu_mapped_file::~bjtcpu_mapped_file() {
+    close();
+}
+
+bool bjtcpu_mapped_file::open(const std::string& path) {
+    close();
+
+    #ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle = file;
+    length = fileSize.QuadPart;
+
+    // empty files can't be mapped, they are just zero bytes long
+    if (length == 0) {
+        return true;
+    }
+
+    mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mappingHandle) {
+        close();
+        return false;
+    }
+
+    mapped = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped) {
+        close();
+        return false;
+    }
+    #else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    length = info.st_size;
+
+    // empty files can't be mapped, they are just zero bytes long
+    if (length > 0) {
+        void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view == MAP_FAILED) {
+            ::close(fd);
+            length = 0;
+            return false;
+        }
+        mapped = (const uint8_t*)view;
+    }
+
+    // the mapping keeps the file alive
+    ::close(fd);
+    #endif
+
+    return true;
+}
+
+const uint8_t* bjtcpu_mapped_file::data() const {
+    return mapped;
+}
+
+size_t bjtcpu_mapped_file::size() const {
+    return length;
+}
+
+void bjtcpu_mapped_file::close() {
+    #ifdef _WIN32
+    if (mapped) {
+        UnmapViewOfFile(mapped);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    #else
+    if (mapped) {
+        munmap((void*)mapped, length);
+    }
+    #endif
+
+    mapped = nullptr;
+    length = 0;
+}
@@ -0,0 +1,105 @@
+#include "fuzz.hpp"
+#include "block.hpp"
+
+#include <cstring>
+
+const char* fuzzViolationName(bjtcpu_fuzz_violation violation) {
+    switch (violation) {
+        case bjtcpu_fuzz_violation::NONE:
+            return "none";
+        case bjtcpu_fuzz_violation::UNWRITABLE_REG:
+            return "unwritable_reg";
+        case bjtcpu_fuzz_violation::UNREADABLE_REG:
+            return "unreadable_reg";
+        case bjtcpu_fuzz_violation::STACK_OVERFLOW:
+            return "stack_overflow";
+        case bjtcpu_fuzz_violation::STACK_UNDERFLOW:
+            return "stack_underflow";
+        case bjtcpu_fuzz_violation::STUCK_LOOP:
+            return "stuck_loop";
+        default:
+            return "unknown";
+    }
+}
+
+bjtcpu_fuzz_monitor::bjtcpu_fuzz_monitor() {
+    ownEdges.assign(BJTCPU_FUZZ_EDGES, 0);
+    edges = ownEdges.data();
+
+    writableMask = 0xFFFF;
+    readableMask = 0xFFFF;
+
+    reset();
+}
+
+void bjtcpu_fuzz_monitor::reset() {
+    firstViolation = bjtcpu_fuzz_violation::NONE;
+    firstViolationAddr = 0;
+    violationMask = 0;
+
+    sideEffects = false;
+    loopPC = 0x10000;
+    loopFlags = 0;
+    loopRegs.fill(0);
+    loopSteps = 0;
+    loopPeriod = 1;
+}
+
+void bjtcpu_fuzz_monitor::setRegisters(const bool* writable, const bool* readable) {
+    writableMask = 0;
+    readableMask = 0;
+
+    for (int reg = 0; reg < 0x10; reg++) {
+        writableMask |= writable[reg] << reg;
+        readableMask |= readable[reg] << reg;
+    }
+}
+
+void bjtcpu_fuzz_monitor::setEdgeMap(uint8_t* map) {
+    edges = map ? map : ownEdges.data();
+}
+
+uint8_t* bjtcpu_fuzz_monitor::getEdgeMap() {
+    return edges;
+}
+
+void bjtcpu_fuzz_monitor::clearEdges() {
+    std::memset(edges, 0, BJTCPU_FUZZ_EDGES);
+}
+
+bjtcpu_fuzz_violation bjtcpu_fuzz_monitor::getViolation() const {
+    return firstViolation;
+}
+
+uint16_t bjtcpu_fuzz_monitor::getViolationAddr() const {
+    return firstViolationAddr;
+}
+
+uint32_t bjtcpu_fuzz_monitor::getViolationMask() const {
+    return violationMask;
+}
+
+uint16_t bjtcpu_fuzz_monitor::readRegMask(const bjtcpu_instr& instr) {
+    switch (instr.op) {
+        case bjtcpu_op::PUSH:
+        case bjtcpu_op::STO:
+        case bjtcpu_op::IADD:
+        case bjtcpu_op::ISUB:
+            return 1 << instr.srcX;
+        case bjtcpu_op::CMP:
+        case bjtcpu_op::ADD:
+        case bjtcpu_op::ADDC:
+        case bjtcpu_op::SUB:
+        case bjtcpu_op::SUBC:
+        case bjtcpu_op::STRLA:
+        case bjtcpu_op::LDRL:
+        case bjtcpu_op::NAND:
+            return (1 << instr.srcX) | (1 << instr.srcY);
+        default:
+            return 0;
+    }
+}
+
+uint16_t bjtcpu_fuzz_monitor::writeRegMask(const bjtcpu_instr& instr) {
+    return writesReg(instr, instr.dest) ? 1 << instr.dest : 0;
+}
@@ -0,0 +1,246 @@
+#include "hle.hpp"
+
+// the routines as programs/stdlib/stdlib.asm assembles them, jump targets
+// relative to the routine's entry. A call target is another bound routine
+
+static const uint8_t MULTIPLY_CODE[] = {
+    0x10, 0x20,           // 00  push rc
+    0xA2, 0x00,           // 02  imm rc 0x00
+    0x42, 0x20,           // 04  add rc rc ra
+    0xD1, 0x10, 0x01,     // 06  isub rb rb 0x01
+    0x10, 0x20,           // 09  push rc
+    0xA2, 0x00,           // 0b  imm rc 0x00
+    0x12, 0x12,           // 0d  cmp rb rc
+    0x22,                 // 0f  pop rc
+    0xE1, 0x00, 0x16,     // 10  jmpz .end
+    0xE0, 0x00, 0x04,     // 13  jmp .loop
+    0xC0, 0x20, 0x00,     // 16  cpy ra rc
+    0x22,                 // 19  pop rc
+    0x01,                 // 1a  ret
+};
+
+static const uint8_t SHL_CODE[] = {
+    0x10, 0x20,           // 00  push rc
+    0xA2, 0x00,           // 02  imm rc 0x00
+    0x40, 0x00,           // 04  add ra ra ra
+    0xD1, 0x10, 0x01,     // 06  isub rb rb 0x01
+    0x12, 0x12,           // 09  cmp rb rc
+    0xE1, 0x00, 0x11,     // 0b  jmpz .end
+    0xE0, 0x00, 0x04,     // 0e  jmp .loop
+    0x22,                 // 11  pop rc
+    0x01,                 // 12  ret
+};
+
+static const uint8_t SHLR_CODE[] = {
+    0x10, 0x20,           // 00  push rc
+    0xA2, 0x00,           // 02  imm rc 0x00
+    0x40, 0x00,           // 04  add ra ra ra
+    0xE4, 0x00, 0x0C,     // 06  jmpc .addbit
+    0xE0, 0x00, 0x0F,     // 09  jmp .subcounter
+    0xC0, 0x00, 0x01,     // 0c  iadd ra ra 0x01
+    0xD1, 0x10, 0x01,     // 0f  isub rb rb 0x01
+    0x12, 0x12,           // 12  cmp rb rc
+    0xE1, 0x00, 0x1A,     // 14  jmpz .end
+    0xE0, 0x00, 0x04,     // 17  jmp .loop
+    0x22,                 // 1a  pop rc
+    0x01,                 // 1b  ret
+};
+
+static const uint8_t SHR_CODE[] = {
+    0x10, 0x20,           // 00  push rc
+    0xA2, 0x08,           // 02  imm rc 0x08
+    0x72, 0x21,           // 04  sub rc rc rb
+    0xC1, 0x20, 0x00,     // 06  cpy rb rc
+    0xEA, 0x00, 0x00,     // 09  call std_shlr
+    0x22,                 // 0c  pop rc
+    0x01,                 // 0d  ret
+};
+
+static const uint8_t MEMSET_CODE[] = {
+    0x10, 0xF0,           // 00  push radr
+    0x10, 0x20,           // 02  push rc
+    0xA2, 0x00,           // 04  imm rc 0x00
+    0x11, 0x00,           // 06  sto ra
+    0xCF, 0xF0, 0x01,     // 08  iadd radr radr 0x01
+    0xD1, 0x10, 0x01,     // 0b  isub rb rb 0x01
+    0x12, 0x12,           // 0e  cmp rb rc
+    0xE1, 0x00, 0x16,     // 10  jmpz .end
+    0xE0, 0x00, 0x06,     // 13  jmp .loop
+    0x22,                 // 16  pop rc
+    0x2F,                 // 17  pop radr
+    0x01,                 // 18  ret
+};
+
+static const uint8_t MEMCPY_CODE[] = {
+    0x10, 0xF0,           // 00  push radr
+    0x10, 0x20,           // 02  push rc
+    0xA2, 0x00,           // 04  imm rc 0x00
+    0x10, 0x00,           // 06  push ra
+    0x90, 0xF2,           // 08  ldrl ra radr rc
+    0x60, 0x12,           // 0a  strla rb rc
+    0x20,                 // 0c  pop ra
+    0xC2, 0x20, 0x01,     // 0d  iadd rc rc 0x01
+    0x12, 0x02,           // 10  cmp ra rc
+    0xE1, 0x00, 0x18,     // 12  jmpz .end
+    0xE0, 0x00, 0x06,     // 15  jmp .loop
+    0x22,                 // 18  pop rc
+    0x2F,                 // 19  pop radr
+    0x01,                 // 1a  ret
+};
+
+static const uint8_t MEMCMP_CODE[] = {
+    0x10, 0x20,           // 00  push rc
+    0xA2, 0x00,           // 02  imm rc 0x00
+    0x10, 0x20,           // 04  push rc
+    0x10, 0x00,           // 06  push ra
+    0x90, 0xF2,           // 08  ldrl ra radr rc
+    0x92, 0x12,           // 0a  ldrl rc rb rc
+    0x12, 0x02,           // 0c  cmp ra rc
+    0xE1, 0x00, 0x16,     // 0e  jmpz .equal
+    0xA0, 0x00,           // 11  imm ra 0x00
+    0xE0, 0x00, 0x35,     // 13  jmp .end
+    0x10, 0xE0,           // 16  push rbnk
+    0xAE, 0xFF,           // 18  imm rbnk 0xFF
+    0xA0, 0x02,           // 1a  imm ra 2
+    0x90, 0xB0,           // 1c  ldrl ra rbp ra
+    0xC0, 0x00, 0x01,     // 1e  iadd ra ra 0x01
+    0xA2, 0x03,           // 21  imm rc 3
+    0x92, 0xB2,           // 23  ldrl rc rbp rc
+    0x12, 0x20,           // 25  cmp rc ra
+    0xE1, 0x00, 0x32,     // 27  jmpz .allequal
+    0xA2, 0x02,           // 2a  imm rc 2
+    0x60, 0xB2,           // 2c  strla rbp rc
+    0x2E,                 // 2e  pop rbnk
+    0xE0, 0x00, 0x08,     // 2f  jmp .loop
+    0xA0, 0x01,           // 32  imm ra 0x01
+    0x2E,                 // 34  pop rbnk
+    0x22,                 // 35  pop rc
+    0x22,                 // 36  pop rc
+    0x22,                 // 37  pop rc
+    0x01,                 // 38  ret
+};
+
+struct hle_reference {
+    const char* name;
+    const uint8_t* code;
+    size_t len;
+    bjtcpu_hle_routine callee;
+};
+
+static const hle_reference REFERENCES[] = {
+    { "none",         nullptr,      0,                   bjtcpu_hle_routine::NONE },
+    { "std_multiply", MULTIPLY_CODE, sizeof(MULTIPLY_CODE), bjtcpu_hle_routine::NONE },
+    { "std_shl",      SHL_CODE,     sizeof(SHL_CODE),    bjtcpu_hle_routine::NONE },
+    { "std_shlr",     SHLR_CODE,    sizeof(SHLR_CODE),   bjtcpu_hle_routine::NONE },
+    { "std_shr",      SHR_CODE,     sizeof(SHR_CODE),    bjtcpu_hle_routine::SHLR },
+    { "std_memset",   MEMSET_CODE,  sizeof(MEMSET_CODE), bjtcpu_hle_routine::NONE },
+    { "std_memcpy",   MEMCPY_CODE,  sizeof(MEMCPY_CODE), bjtcpu_hle_routine::NONE },
+    { "std_memcmp",   MEMCMP_CODE,  sizeof(MEMCMP_CODE), bjtcpu_hle_routine::NONE },
+};
+
+static_assert(sizeof(REFERENCES) / sizeof(REFERENCES[0]) == (size_t)bjtcpu_hle_routine::COUNT);
+
+const char* hleRoutineName(bjtcpu_hle_routine routine) {
+    return routine < bjtcpu_hle_routine::COUNT ? REFERENCES[(size_t)routine].name : "unknown";
+}
+
+size_t bjtcpu_hle_table::bind(const uint8_t* rom, const bjtcpu_instr* decoded, const bjtcpu_symbols& symbols) {
+    size_t count = 0;
+
+    // in enum order, so a callee is bound before its callers
+    for (size_t i = 1; i < (size_t)bjtcpu_hle_routine::COUNT; i++) {
+        bjtcpu_hle_routine routine = (bjtcpu_hle_routine)i;
+        uint16_t addr;
+
+        if (symbols.find(REFERENCES[i].name, addr) && bind(rom, decoded, routine, addr)) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+bool bjtcpu_hle_table::bind(const uint8_t* rom, const bjtcpu_instr* decoded, bjtcpu_hle_routine routine, uint16_t addr) {
+    if (routine == bjtcpu_hle_routine::NONE || routine >= bjtcpu_hle_routine::COUNT) {
+        return false;
+    }
+
+    const hle_reference& reference = REFERENCES[(size_t)routine];
+    if (addr + reference.len > 0x10000) {
+        return false;
+    }
+
+    bjtcpu_hle_code code;
+    code.addr = addr;
+    code.cyclesBefore.fill(0);
+    code.instrsBefore.fill(0);
+
+    uint32_t cycles = 0;
+    uint8_t instrs = 0;
+
+    for (size_t offset = 0; offset < reference.len;) {
+        const bjtcpu_instr& instr = decoded[addr + offset];
+        bjtcpu_instr expected = decodeInstr(reference.code[offset],
+            offset + 1 < reference.len ? reference.code[offset + 1] : 0,
+            offset + 2 < reference.len ? reference.code[offset + 2] : 0);
+
+        if (instr.op != expected.op || instr.len != expected.len || offset + instr.len > reference.len) {
+            return false;
+        }
+
+        if (instr.op == bjtcpu_op::CALL) {
+            if (!isBound(reference.callee) || instr.target != codes[(size_t)reference.callee].addr) {
+                return false;
+            }
+        } else if (instr.op >= bjtcpu_op::JMP && instr.op <= bjtcpu_op::JMPO) {
+            if (rom[addr + offset] != reference.code[offset] || instr.target != (uint16_t)(addr + expected.target)) {
+                return false;
+            }
+        } else {
+            for (size_t i = 0; i < instr.len; i++) {
+                if (rom[addr + offset + i] != reference.code[offset + i]) {
+                    return false;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < instr.len; i++) {
+            code.cyclesBefore[offset + i] = cycles;
+            code.instrsBefore[offset + i] = instrs;
+        }
+
+        cycles += instr.cycles;
+        instrs++;
+        offset += instr.len;
+    }
+
+    code.cyclesBefore[reference.len] = cycles;
+    code.instrsBefore[reference.len] = instrs;
+
+    if (index.empty()) {
+        index.assign(0x10000, bjtcpu_hle_routine::NONE);
+    }
+
+    if (bound[(size_t)routine]) {
+        index[codes[(size_t)routine].addr] = bjtcpu_hle_routine::NONE;
+    }
+
+    codes[(size_t)routine] = code;
+    bound[(size_t)routine] = true;
+    index[addr] = routine;
+
+    return true;
+}
+
+void bjtcpu_hle_table::clear() {
+    index.clear();
+    bound.fill(false);
+}
+
+bool bjtcpu_hle_table::isBound(bjtcpu_hle_routine routine) const {
+    return routine < bjtcpu_hle_routine::COUNT && bound[(size_t)routine];
+}
+
+const bjtcpu_hle_code& bjtcpu_hle_table::getCode(bjtcpu_hle_routine routine) const {
+    return codes[(size_t)routine];
+}
@@ -0,0 +1,317 @@
+#include "jit.hpp"
+
+#if BJTCPU_JIT
+
+#include <cstring>
+#include <initializer_list>
+#include <sys/mman.h>
+
+#include "ram.hpp"
+
+// executable memory is mapped in regions this big, one block body at most a
+// few KiB
+static constexpr size_t REGION_BYTES = 0x40000;
+
+// x86-64 registers - guest registers are addressed off rbx, the context off
+// r12, and the bank pointers, shared flags and ROM are kept in r13 to r15, all
+// callee-saved so they survive a call to write(). Everything else is scratch
+// within an instruction
+enum jit_reg : uint8_t {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+static constexpr uint8_t REGS_BASE = RBX;
+static constexpr uint8_t CONTEXT_BASE = R12;
+
+static constexpr uint8_t CONTEXT_LAST_VALUE = offsetof(bjtcpu_jit_context, lastValue);
+static constexpr uint8_t CONTEXT_VALUE = offsetof(bjtcpu_jit_context, value);
+static constexpr uint8_t CONTEXT_SOURCE = offsetof(bjtcpu_jit_context, source);
+
+// slow path of a store to a bank shared with a saved state
+static void writeShared(bjtcpu_ram* ram, uint8_t bank, uint8_t addr, uint8_t value) {
+    ram->write(bank, addr, value);
+}
+
+// just the encodings the compiler below needs, byte operands in al, cl and dl
+class jit_assembler {
+public:
+    explicit jit_assembler(std::vector<uint8_t>& code) : code(code) {}
+
+    void emit(std::initializer_list<uint8_t> bytes) {
+        code.insert(code.end(), bytes);
+    }
+
+    // opcode with reg (or an opcode extension) and [base + disp8]
+    void mem(std::initializer_list<uint8_t> opcode, uint8_t reg, uint8_t base, uint8_t disp, bool wide = false) {
+        uint8_t rex = (wide ? 0x08 : 0) | (reg & 8 ? 0x04 : 0) | (base & 8 ? 0x01 : 0);
+        if (rex) {
+            code.push_back(0x40 | rex);
+        }
+
+        code.insert(code.end(), opcode);
+        code.push_back(0x40 | (reg & 7) << 3 | (base & 7));
+
+        // rsp and r12 as a base need a SIB byte
+        if ((base & 7) == RSP) {
+            code.push_back(0x24);
+        }
+
+        code.push_back(disp);
+    }
+
+    // movzx reg, byte [rbx + guest]
+    void loadReg(uint8_t reg, uint8_t guest) {
+        mem({ 0x0F, 0xB6 }, reg, REGS_BASE, guest);
+    }
+
+    // mov byte [rbx + guest], reg
+    void storeReg(uint8_t guest, uint8_t reg) {
+        mem({ 0x88 }, reg, REGS_BASE, guest);
+    }
+
+    // mov byte [r12 + offset], reg
+    void storeContext(uint8_t offset, uint8_t reg) {
+        mem({ 0x88 }, reg, CONTEXT_BASE, offset);
+    }
+
+    // address 0xFF:sp in ecx:edx
+    void stackAddr() {
+        emit({ 0xB9, 0xFF, 0x00, 0x00, 0x00 });    // mov ecx, 0xFF
+        loadReg(RDX, REG_SP);
+    }
+
+    // movzx eax, byte [banks[rcx] + rdx]
+    void readRAM() {
+        emit({ 0x4D, 0x8B, 0x44, 0xCD, 0x00 });     // mov r8, [r13 + rcx * 8]
+        emit({ 0x41, 0x0F, 0xB6, 0x04, 0x10 });     // movzx eax, byte [r8 + rdx]
+    }
+
+    // al to bank ecx, address edx - through the pointer unless the bank is
+    // shared, when write() copies it first
+    void writeRAM() {
+        emit({ 0x41, 0x80, 0x3C, 0x0E, 0x00 });     // cmp byte [r14 + rcx], 0
+        size_t toShared = jump(0x75);               // jne
+
+        emit({ 0x4D, 0x8B, 0x44, 0xCD, 0x00 });     // mov r8, [r13 + rcx * 8]
+        emit({ 0x41, 0x88, 0x04, 0x10 });           // mov [r8 + rdx], al
+        size_t toDone = jump(0xEB);                 // jmp
+
+        land(toShared);
+        mem({ 0x8B }, RDI, CONTEXT_BASE, offsetof(bjtcpu_jit_context, ram), true);
+        emit({ 0x89, 0xCE });                       // mov esi, ecx
+        emit({ 0x89, 0xC1 });                       // mov ecx, eax
+        call((const void*)&writeShared);
+
+        land(toDone);
+    }
+
+    // short jump forward, landed later
+    size_t jump(uint8_t opcode) {
+        emit({ opcode, 0x00 });
+        return code.size();
+    }
+
+    void land(size_t from) {
+        code[from - 1] = (uint8_t)(code.size() - from);
+    }
+
+    void call(const void* function) {
+        uint64_t address = (uint64_t)function;
+        code.insert(code.end(), { 0x48, 0xB8 });    // mov rax, imm64
+        for (int i = 0; i < 8; i++) {
+            code.push_back(address >> (i * 8));
+        }
+        emit({ 0xFF, 0xD0 });                       // call rax
+    }
+
+private:
+    std::vector<uint8_t>& code;
+};
+
+// carry from the last flag update into the next adc - set when value is below
+// lastValue, the same test bjtcpu_lazy_flags::carry() makes
+static void loadCarry(jit_assembler& as) {
+    as.mem({ 0x8A }, RDX, CONTEXT_BASE, CONTEXT_VALUE);         // mov dl, value
+    as.mem({ 0x3A }, RDX, CONTEXT_BASE, CONTEXT_LAST_VALUE);    // cmp dl, lastValue
+}
+
+static void compileInstr(jit_assembler& as, const bjtcpu_instr& instr, uint8_t& source) {
+    switch (instr.op) {
+        case bjtcpu_op::PUSH:
+            as.loadReg(RAX, instr.srcX);
+            as.stackAddr();
+            as.writeRAM();
+            as.mem({ 0xFE }, 0, REGS_BASE, REG_SP);            // inc byte [sp]
+            break;
+        case bjtcpu_op::POP:
+            as.mem({ 0xFE }, 1, REGS_BASE, REG_SP);            // dec byte [sp]
+            as.stackAddr();
+            as.readRAM();
+            as.storeReg(instr.dest, RAX);
+            break;
+        case bjtcpu_op::STO:
+            as.loadReg(RAX, instr.srcX);
+            as.loadReg(RCX, REG_BNK);
+            as.loadReg(RDX, REG_ADDR);
+            as.writeRAM();
+            break;
+        case bjtcpu_op::STRLA:
+            as.loadReg(RAX, REG_A);
+            as.loadReg(RCX, REG_BNK);
+            as.loadReg(RDX, instr.srcX);
+            as.mem({ 0x02 }, RDX, REGS_BASE, instr.srcY);      // add dl, y
+            as.writeRAM();
+            break;
+        case bjtcpu_op::LDA:
+            as.loadReg(RCX, REG_BNK);
+            as.loadReg(RDX, REG_ADDR);
+            as.readRAM();
+            as.storeReg(instr.dest, RAX);
+            break;
+        case bjtcpu_op::LDRL:
+            as.loadReg(RCX, REG_BNK);
+            as.loadReg(RDX, instr.srcX);
+            as.mem({ 0x02 }, RDX, REGS_BASE, instr.srcY);      // add dl, y
+            as.readRAM();
+            as.storeReg(instr.dest, RAX);
+            break;
+        case bjtcpu_op::PLDA:
+            as.loadReg(RCX, REG_BNK);
+            as.loadReg(RDX, REG_ADDR);
+            as.emit({ 0xC1, 0xE1, 0x08 });                      // shl ecx, 8
+            as.emit({ 0x09, 0xD1 });                            // or ecx, edx
+            as.emit({ 0x41, 0x0F, 0xB6, 0x04, 0x0F });          // movzx eax, byte [r15 + rcx]
+            as.storeReg(instr.dest, RAX);
+            break;
+        case bjtcpu_op::IMM:
+            as.mem({ 0xC6 }, 0, REGS_BASE, instr.dest);        // mov byte [dest], imm
+            as.emit({ instr.imm });
+            break;
+        case bjtcpu_op::NAND:
+            as.loadReg(RAX, instr.srcX);
+            as.mem({ 0x22 }, RAX, REGS_BASE, instr.srcY);      // and al, y
+            as.emit({ 0xF6, 0xD0 });                            // not al
+            as.storeReg(instr.dest, RAX);
+            break;
+        case bjtcpu_op::CMP:
+            as.loadReg(RAX, instr.srcX);
+            as.storeContext(CONTEXT_LAST_VALUE, RAX);
+            as.mem({ 0x2A }, RAX, REGS_BASE, instr.srcY);      // sub al, y
+            as.storeContext(CONTEXT_VALUE, RAX);
+
+            if (source != bjtcpu_jit_context::COMPARE) {
+                as.mem({ 0xC6 }, 0, CONTEXT_BASE, CONTEXT_SOURCE);
+                as.emit({ bjtcpu_jit_context::COMPARE });
+                source = bjtcpu_jit_context::COMPARE;
+            }
+            break;
+        case bjtcpu_op::ADD:
+        case bjtcpu_op::ADDC:
+        case bjtcpu_op::IADD:
+        case bjtcpu_op::SUB:
+        case bjtcpu_op::SUBC:
+        case bjtcpu_op::ISUB: {
+            bool sub = instr.op == bjtcpu_op::SUB || instr.op == bjtcpu_op::SUBC || instr.op == bjtcpu_op::ISUB;
+            bool immediate = instr.op == bjtcpu_op::IADD || instr.op == bjtcpu_op::ISUB;
+            bool carryIn = instr.op == bjtcpu_op::ADDC || instr.op == bjtcpu_op::SUBC;
+
+            // the dest's previous value, before x or y can overwrite it
+            as.loadReg(RCX, instr.dest);
+            as.loadReg(RAX, instr.srcX);
+
+            if (immediate) {
+                as.emit({ (uint8_t)(sub ? 0x2C : 0x04), instr.imm });  // sub/add al, imm
+            } else {
+                as.mem({ (uint8_t)(sub ? 0x2A : 0x02) }, RAX, REGS_BASE, instr.srcY);
+            }
+
+            // a compare never leaves carry set
+            if (carryIn && source != bjtcpu_jit_context::COMPARE) {
+                loadCarry(as);
+                as.emit({ 0x14, 0x00 });                        // adc al, 0
+            }
+
+            as.storeReg(instr.dest, RAX);
+            as.storeContext(CONTEXT_LAST_VALUE, RCX);
+            as.storeContext(CONTEXT_VALUE, RAX);
+
+            if (source != bjtcpu_jit_context::ADD) {
+                as.mem({ 0xC6 }, 0, CONTEXT_BASE, CONTEXT_SOURCE);
+                as.emit({ bjtcpu_jit_context::ADD });
+                source = bjtcpu_jit_context::ADD;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bjtcpu_jit::~bjtcpu_jit() {
+    for (const region& r : regions) {
+        munmap(r.base, REGION_BYTES);
+    }
+}
+
+bjtcpu_jit_fn bjtcpu_jit::compile(const bjtcpu_block& block) {
+    if (block.instrs.size() < 2) {
+        return nullptr;
+    }
+
+    buffer.clear();
+    jit_assembler as(buffer);
+
+    as.emit({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57 });    // push rbx, r12 to r15
+    as.emit({ 0x49, 0x89, 0xFC });                                          // mov r12, rdi
+    as.mem({ 0x8B }, RBX, CONTEXT_BASE, offsetof(bjtcpu_jit_context, regs), true);
+    as.mem({ 0x8B }, R13, CONTEXT_BASE, offsetof(bjtcpu_jit_context, banks), true);
+    as.mem({ 0x8B }, R14, CONTEXT_BASE, offsetof(bjtcpu_jit_context, shared), true);
+    as.mem({ 0x8B }, R15, CONTEXT_BASE, offsetof(bjtcpu_jit_context, rom), true);
+
+    uint8_t source = bjtcpu_jit_context::NONE;
+    for (size_t i = 0; i + 1 < block.instrs.size(); i++) {
+        compileInstr(as, block.instrs[i], source);
+    }
+
+    as.emit({ 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B });    // pop r15 to r12, rbx
+    as.emit({ 0xC3 });                                                      // ret
+
+    if (current < regions.size() && regions[current].used + buffer.size() > REGION_BYTES) {
+        current++;
+    }
+
+    if (current == regions.size()) {
+        void* base = mmap(nullptr, REGION_BYTES, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return nullptr;
+        }
+        regions.push_back({ (uint8_t*)base, 0 });
+    }
+
+    // writable only while the code is copied in
+    region& r = regions[current];
+    if (mprotect(r.base, REGION_BYTES, PROT_READ | PROT_WRITE) != 0) {
+        return nullptr;
+    }
+
+    uint8_t* code = r.base + r.used;
+    std::memcpy(code, buffer.data(), buffer.size());
+    r.used += buffer.size();
+
+    if (mprotect(r.base, REGION_BYTES, PROT_READ | PROT_EXEC) != 0) {
+        return nullptr;
+    }
+
+    return (bjtcpu_jit_fn)code;
+}
+
+void bjtcpu_jit::clear() {
+    for (region& r : regions) {
+        r.used = 0;
+    }
+
+    current = 0;
+}
+
+#endif
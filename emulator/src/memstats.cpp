@@ -0,0 +1,91 @@
+#include "memstats.hpp"
+#include "fileio.hpp"
+
+#include <stdio.h>
+#include <cstring>
+
+bjtcpu_memstats::bjtcpu_memstats() {
+    reset();
+}
+
+void bjtcpu_memstats::reset() {
+    reads.assign(0x10000, 0);
+    writes.assign(0x10000, 0);
+
+    peakSP = 0;
+    callDepth = 0;
+    peakCallDepth = 0;
+
+    lastBank = 0;
+    bankSwitches = 0;
+}
+
+uint64_t bjtcpu_memstats::getReads(uint8_t bank, uint8_t addr) const {
+    return reads[bank * 0x100 + addr];
+}
+
+uint64_t bjtcpu_memstats::getWrites(uint8_t bank, uint8_t addr) const {
+    return writes[bank * 0x100 + addr];
+}
+
+uint64_t bjtcpu_memstats::getBankReads(uint8_t bank) const {
+    uint64_t total = 0;
+    for (int addr = 0; addr < 0x100; addr++) {
+        total += reads[bank * 0x100 + addr];
+    }
+    return total;
+}
+
+uint64_t bjtcpu_memstats::getBankWrites(uint8_t bank) const {
+    uint64_t total = 0;
+    for (int addr = 0; addr < 0x100; addr++) {
+        total += writes[bank * 0x100 + addr];
+    }
+    return total;
+}
+
+uint8_t bjtcpu_memstats::getPeakSP() const {
+    return peakSP;
+}
+
+uint32_t bjtcpu_memstats::getPeakCallDepth() const {
+    return peakCallDepth;
+}
+
+uint64_t bjtcpu_memstats::getBankSwitches() const {
+    return bankSwitches;
+}
+
+bool bjtcpu_memstats::writeCSV(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "bank,reads,writes\n");
+
+    for (int bank = 0; bank < 0x100; bank++) {
+        fprintf(file, "%02x,%llu,%llu\n", bank, (unsigned long long)getBankReads(bank), (unsigned long long)getBankWrites(bank));
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool bjtcpu_memstats::writeBinary(const std::string& path) const {
+    bjtcpu_memstats_header header{};
+    std::memcpy(header.magic, "BJTM", 4);
+    header.version = BJTCPU_MEMSTATS_VERSION;
+    header.bankSwitches = bankSwitches;
+    header.peakSP = peakSP;
+    header.peakCallDepth = peakCallDepth;
+
+    size_t countsSize = 0x10000 * sizeof(uint64_t);
+
+    std::vector<uint8_t> data(sizeof(header) + countsSize * 2);
+    std::memcpy(data.data(), &header, sizeof(header));
+    std::memcpy(data.data() + sizeof(header), reads.data(), countsSize);
+    std::memcpy(data.data() + sizeof(header) + countsSize, writes.data(), countsSize);
+
+    return writeFile(path, data.data(), data.size());
+}
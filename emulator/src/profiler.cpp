@@ -0,0 +1,119 @@
+#include "profiler.hpp"
+
+#include <stdio.h>
+
+static constexpr size_t MAX_CALL_DEPTH = 256;
+
+bjtcpu_profiler::bjtcpu_profiler() {
+    decoded = nullptr;
+    reset();
+}
+
+void bjtcpu_profiler::reset() {
+    executions.assign(0x10000, 0);
+
+    nodes.clear();
+    nodes.push_back(node{0, 0, 0, {}});
+    current = 0;
+    frameStart = 0;
+    rootNamed = false;
+    overflowDepth = 0;
+}
+
+void bjtcpu_profiler::setDecoded(const bjtcpu_instr* decoded) {
+    this->decoded = decoded;
+}
+
+void bjtcpu_profiler::call(uint16_t site, uint16_t target, uint64_t cycleCount) {
+    if (overflowDepth > 0) {
+        overflowDepth++;
+        return;
+    }
+
+    if (!rootNamed) {
+        nodes[0].func = site;
+        rootNamed = true;
+    }
+
+    sync(cycleCount);
+
+    for (uint32_t child : nodes[current].children) {
+        if (nodes[child].func == target) {
+            current = child;
+            return;
+        }
+    }
+
+    // runaway recursion - keep charging the deepest frame rather than growing forever
+    size_t depth = 0;
+    for (uint32_t index = current; index != 0; index = nodes[index].parent) {
+        depth++;
+    }
+    if (depth >= MAX_CALL_DEPTH) {
+        overflowDepth++;
+        return;
+    }
+
+    uint32_t child = nodes.size();
+    nodes.push_back(node{target, current, 0, {}});
+    nodes[current].children.push_back(child);
+    current = child;
+}
+
+bool bjtcpu_profiler::writeHistogram(const std::string& path, const bjtcpu_symbols& symbols) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "addr,function,executions,cycles\n");
+
+    for (int addr = 0; addr < 0x10000; addr++) {
+        if (executions[addr] == 0) {
+            continue;
+        }
+
+        uint64_t cycles = decoded ? executions[addr] * decoded[addr].cycles : 0;
+
+        fprintf(file, "%04x,%s,%llu,%llu\n", addr, symbols.functionName(addr).c_str(),
+            (unsigned long long)executions[addr], (unsigned long long)cycles);
+    }
+
+    fclose(file);
+    return true;
+}
+
+bool bjtcpu_profiler::writeFolded(const std::string& path, const bjtcpu_symbols& symbols) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+
+    // no calls made - name the root after its most executed address
+    uint16_t rootFunc = nodes[0].func;
+    if (!rootNamed) {
+        for (int addr = 0; addr < 0x10000; addr++) {
+            if (executions[addr] > executions[rootFunc]) {
+                rootFunc = addr;
+            }
+        }
+    }
+
+    std::vector<std::string> names(nodes.size());
+
+    // children are always created after their parent
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (i == 0) {
+            names[i] = symbols.functionName(rootFunc);
+        } else {
+            names[i] = names[nodes[i].parent] + ";" + symbols.functionName(nodes[i].func);
+        }
+
+        if (nodes[i].cycles > 0) {
+            fprintf(file, "%s %llu\n", names[i].c_str(), (unsigned long long)nodes[i].cycles);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
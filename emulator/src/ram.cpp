@@ -0,0 +1,109 @@
+#include "ram.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+bjtcpu_ram::bjtcpu_ram() {
+    for (int bank = 0; bank < 0x100; bank++) {
+        banks[bank] = zeroBank();
+        data[bank] = const_cast<uint8_t*>(banks[bank]->data());
+    }
+
+    shared.fill(true);
+    dirty.fill(0);
+    baseline = 0;
+}
+
+void bjtcpu_ram::clear() {
+    for (int bank = 0; bank < 0x100; bank++) {
+        if (baseline != 0 || isDirty(bank)) {
+            revert(bank, zeroBank());
+        }
+    }
+
+    dirty.fill(0);
+    baseline = 0;
+}
+
+void bjtcpu_ram::move(uint8_t destBank, uint8_t destAddr, uint8_t srcBank, uint8_t srcAddr, size_t length) {
+    if (shared[destBank]) {
+        own(destBank);
+    }
+
+    if (srcAddr + length <= 0x100 && destAddr + length <= 0x100) {
+        std::memmove(data[destBank] + destAddr, data[srcBank] + srcAddr, length);
+        return;
+    }
+
+    // one of the ranges wraps, so stage it rather than split both around the wrap
+    bjtcpu_ram_bank staged;
+    for (size_t i = 0; i < length; i++) {
+        staged[i] = data[srcBank][(uint8_t)(srcAddr + i)];
+    }
+    for (size_t i = 0; i < length; i++) {
+        data[destBank][(uint8_t)(destAddr + i)] = staged[i];
+    }
+}
+
+void bjtcpu_ram::fill(uint8_t bank, uint8_t addr, uint8_t value, size_t length) {
+    if (shared[bank]) {
+        own(bank);
+    }
+
+    size_t first = std::min<size_t>(length, 0x100 - addr);
+    std::memset(data[bank] + addr, value, first);
+    std::memset(data[bank], value, length - first);
+}
+
+bool bjtcpu_ram::isDirty(uint8_t bank) const {
+    return dirty[bank >> 6] & (1ull << (bank & 63));
+}
+
+bjtcpu_ram_banks bjtcpu_ram::share() {
+    shared.fill(true);
+    return banks;
+}
+
+void bjtcpu_ram::restore(const bjtcpu_ram_banks& banks, uint64_t baseline) {
+    for (int bank = 0; bank < 0x100; bank++) {
+        if (baseline == 0 || baseline != this->baseline || isDirty(bank)) {
+            revert(bank, banks[bank]);
+        }
+    }
+
+    dirty.fill(0);
+    this->baseline = baseline;
+}
+
+const std::shared_ptr<const bjtcpu_ram_bank>& bjtcpu_ram::zeroBank() {
+    static const std::shared_ptr<const bjtcpu_ram_bank> bank = std::make_shared<const bjtcpu_ram_bank>();
+    return bank;
+}
+
+void bjtcpu_ram::own(uint8_t bank) {
+    dirty[bank >> 6] |= 1ull << (bank & 63);
+    shared[bank] = false;
+
+    // no saved state holds it any more, so it can be written in place (the
+    // zero bank always has the static reference as well)
+    if (banks[bank].use_count() == 1) {
+        return;
+    }
+
+    std::shared_ptr<bjtcpu_ram_bank> copy = std::make_shared<bjtcpu_ram_bank>(*banks[bank]);
+    data[bank] = copy->data();
+    banks[bank] = std::move(copy);
+}
+
+void bjtcpu_ram::revert(uint8_t bank, const std::shared_ptr<const bjtcpu_ram_bank>& source) {
+    // a bank only this RAM holds is overwritten rather than freed, so a fuzzer
+    // resetting between short runs doesn't reallocate the banks it keeps writing
+    if (banks[bank] != source && banks[bank].use_count() == 1) {
+        std::memcpy(data[bank], source->data(), 0x100);
+    } else {
+        banks[bank] = source;
+        data[bank] = const_cast<uint8_t*>(source->data());
+    }
+
+    shared[bank] = true;
+}
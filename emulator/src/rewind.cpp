@@ -0,0 +1,130 @@
+#include "rewind.hpp"
+
+#include <algorithm>
+
+bjtcpu_rewind::bjtcpu_rewind() {
+    configure(DEFAULT_INTERVAL, DEFAULT_BUDGET);
+}
+
+void bjtcpu_rewind::configure(uint64_t keyframeInterval, size_t memoryBudget) {
+    interval = std::max<uint64_t>(keyframeInterval, 1);
+
+    // largest power of two ring that fits in an eighth of the budget
+    size_t ringSize = 1;
+    while (ringSize * 2 * sizeof(bjtcpu_delta) <= memoryBudget / 8) {
+        ringSize *= 2;
+    }
+
+    deltas.assign(ringSize, bjtcpu_delta{});
+    deltaMask = ringSize - 1;
+    keyframeBudget = memoryBudget - std::min(memoryBudget, ringSize * sizeof(bjtcpu_delta));
+
+    clear();
+}
+
+void bjtcpu_rewind::clear() {
+    keyframes.clear();
+    keyframeBytes = 0;
+    nextKeyframe = 0;
+    head = 0;
+}
+
+void bjtcpu_rewind::addKeyframe(bjtcpu_state&& state) {
+    nextKeyframe = state.cycleCount + interval;
+
+    size_t cost = keyframeCost(state, keyframes.empty() ? nullptr : &keyframes.back().state);
+    keyframes.push_back(keyframe{std::move(state), cost});
+    keyframeBytes += cost;
+
+    // always keep the newest keyframe, even if it alone is over budget
+    while (keyframeBytes > keyframeBudget && keyframes.size() > 1) {
+        keyframeBytes -= keyframes.front().cost;
+        keyframes.pop_front();
+
+        // banks it shared with the dropped keyframe are now its own
+        keyframe& front = keyframes.front();
+        keyframeBytes -= front.cost;
+        front.cost = keyframeCost(front.state, nullptr);
+        keyframeBytes += front.cost;
+    }
+}
+
+const bjtcpu_state* bjtcpu_rewind::findKeyframe(uint64_t cycle) const {
+    for (auto it = keyframes.rbegin(); it != keyframes.rend(); it++) {
+        if (it->state.cycleCount <= cycle) {
+            return &it->state;
+        }
+    }
+
+    return nullptr;
+}
+
+void bjtcpu_rewind::truncate(uint64_t cycle) {
+    while (!keyframes.empty() && keyframes.back().state.cycleCount > cycle) {
+        keyframeBytes -= keyframes.back().cost;
+        keyframes.pop_back();
+    }
+
+    nextKeyframe = keyframes.empty() ? 0 : keyframes.back().state.cycleCount + interval;
+
+    uint64_t tail = head > deltas.size() ? head - deltas.size() : 0;
+    while (head > tail && deltas[(head - 1) & deltaMask].cycle > cycle) {
+        head--;
+    }
+}
+
+bool bjtcpu_rewind::findLastWrite(uint8_t bank, uint8_t addr, uint64_t beforeCycle, uint64_t& cycle) const {
+    uint16_t target = (bank << 8) | addr;
+    uint64_t tail = head > deltas.size() ? head - deltas.size() : 0;
+
+    for (uint64_t i = head; i > tail; i--) {
+        const bjtcpu_delta& delta = deltas[(i - 1) & deltaMask];
+        if (delta.kind == bjtcpu_delta_kind::RAM_WRITE && delta.target == target && delta.cycle < beforeCycle) {
+            cycle = delta.cycle;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::vector<bjtcpu_delta> bjtcpu_rewind::getDeltas() const {
+    uint64_t tail = head > deltas.size() ? head - deltas.size() : 0;
+
+    std::vector<bjtcpu_delta> result;
+    result.reserve(head - tail);
+
+    for (uint64_t i = tail; i < head; i++) {
+        result.push_back(deltas[i & deltaMask]);
+    }
+
+    return result;
+}
+
+uint64_t bjtcpu_rewind::getOldestCycle() const {
+    return keyframes.empty() ? 0 : keyframes.front().state.cycleCount;
+}
+
+size_t bjtcpu_rewind::getKeyframeCount() const {
+    return keyframes.size();
+}
+
+size_t bjtcpu_rewind::getMemoryUsed() const {
+    return keyframeBytes + deltas.size() * sizeof(bjtcpu_delta);
+}
+
+size_t bjtcpu_rewind::keyframeCost(const bjtcpu_state& state, const bjtcpu_state* previous) const {
+    size_t cost = sizeof(keyframe);
+
+    for (int bank = 0; bank < 0x100; bank++) {
+        const std::shared_ptr<const bjtcpu_ram_bank>& ref = state.banks[bank];
+
+        if (ref == bjtcpu_ram::zeroBank() || (previous && ref == previous->banks[bank])) {
+            continue;
+        }
+
+        cost += sizeof(bjtcpu_ram_bank);
+    }
+
+    return cost;
+}
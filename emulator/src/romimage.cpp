@@ -0,0 +1,103 @@
+#include "romimage.hpp"
+#include "state.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+std::shared_ptr<bjtcpu_rom_image> bjtcpu_rom_image::create(const uint8_t* bytes, size_t size) {
+    if (size > 0x10000) {
+        return nullptr;
+    }
+
+    std::shared_ptr<bjtcpu_rom_image> image(new bjtcpu_rom_image());
+    image->owned = std::make_unique<rom_storage>();
+    std::memset(image->owned->bytes, 0, sizeof(image->owned->bytes));
+    if (size > 0) {
+        std::memcpy(image->owned->bytes, bytes, size);
+    }
+
+    image->bytes = image->owned->bytes;
+    image->size = size;
+    image->decode();
+
+    return image;
+}
+
+std::shared_ptr<const bjtcpu_rom_image> bjtcpu_rom_image::load(const std::string& path) {
+    std::unique_ptr<bjtcpu_mapped_file> file = std::make_unique<bjtcpu_mapped_file>();
+    if (!file->open(path) || file->size() > 0x10000) {
+        return nullptr;
+    }
+
+    if (file->size() < 0x10000) {
+        return create(file->data(), file->size());
+    }
+
+    std::shared_ptr<bjtcpu_rom_image> image(new bjtcpu_rom_image());
+    image->bytes = file->data();
+    image->size = file->size();
+    image->file = std::move(file);
+    image->decode();
+
+    return image;
+}
+
+const std::shared_ptr<const bjtcpu_rom_image>& bjtcpu_rom_image::empty() {
+    static const std::shared_ptr<const bjtcpu_rom_image> image = create(nullptr, 0);
+    return image;
+}
+
+bool bjtcpu_rom_image::assign(const uint8_t* bytes, size_t size) {
+    if (!owned || size > 0x10000 || weak_from_this().use_count() > 1) {
+        return false;
+    }
+
+    size_t extent = std::max(size, this->size);
+
+    std::memset(owned->bytes, 0, extent);
+    if (size > 0) {
+        std::memcpy(owned->bytes, bytes, size);
+    }
+
+    // the last two addresses also decode bytes wrapped round from the start
+    const uint8_t* rom = owned->bytes;
+    auto decodeAt = [&](size_t addr) {
+        decoded->instrs[addr] = decodeInstr(rom[addr], rom[(addr + 1) & 0xFFFF], rom[(addr + 2) & 0xFFFF]);
+    };
+
+    for (size_t addr = 0; addr < extent; addr++) {
+        decodeAt(addr);
+    }
+    for (size_t addr = std::max<size_t>(extent, 0xFFFE); addr < 0x10000; addr++) {
+        decodeAt(addr);
+    }
+
+    fuseROM(decoded->instrs, 0, extent);
+
+    this->size = size;
+    checksum = checksumROM(owned->bytes, size);
+
+    return true;
+}
+
+const uint8_t* bjtcpu_rom_image::getBytes() const {
+    return bytes;
+}
+
+const bjtcpu_instr* bjtcpu_rom_image::getDecoded() const {
+    return decoded->instrs;
+}
+
+size_t bjtcpu_rom_image::getSize() const {
+    return size;
+}
+
+uint32_t bjtcpu_rom_image::getChecksum() const {
+    return checksum;
+}
+
+void bjtcpu_rom_image::decode() {
+    decoded = std::make_unique<decoded_storage>();
+    decodeROM(bytes, decoded->instrs);
+    checksum = checksumROM(bytes);
+}
@@ -0,0 +1,127 @@
+#include "state.hpp"
+#include "fileio.hpp"
+
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+
+uint64_t nextStateId() {
+    static std::atomic<uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t checksumROM(const uint8_t* rom) {
+    uint32_t hash = 2166136261u;
+    for (int addr = 0; addr < 0x10000; addr++) {
+        hash = (hash ^ rom[addr]) * 16777619u;
+    }
+    return hash;
+}
+
+uint32_t checksumROM(const uint8_t* rom, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t addr = 0; addr < size; addr++) {
+        hash = (hash ^ rom[addr]) * 16777619u;
+    }
+
+    // each zero byte only multiplies by the prime, so the padding is one power
+    uint32_t factor = 16777619u;
+    for (size_t zeros = 0x10000 - size; zeros > 0; zeros >>= 1) {
+        if (zeros & 1) {
+            hash *= factor;
+        }
+        factor *= factor;
+    }
+
+    return hash;
+}
+
+bool writeState(const std::string& path, const bjtcpu_state& state) {
+    bjtcpu_state_header header{};
+    std::memcpy(header.magic, "BJTS", 4);
+    header.version = BJTCPU_STATE_VERSION;
+    header.romChecksum = state.romChecksum;
+    header.pc = state.pcReg;
+    header.instrAddr = state.instrAddr;
+    std::memcpy(header.instrReg, state.instrReg.data(), 3);
+    header.instrFetchIdx = state.instrFetchIdx;
+    header.instrStageIdx = state.instrStageIdx;
+    header.flags = state.flagsReg;
+    header.stopped = state.stopped;
+    header.cursorX = state.display.getCursorX();
+    header.cursorY = state.display.getCursorY();
+    header.anchorX = state.display.getAnchorX();
+    header.anchorY = state.display.getAnchorY();
+    header.displayMode = state.display.isAutoIncrement() ? 1 : 0;
+    header.waitCycles = state.waitCycles;
+    std::memcpy(header.regFile, state.regFile.data(), 0x10);
+    header.cycleCount = state.cycleCount;
+    header.instrCount = state.instrCount;
+    header.dmaCycles = state.dmaCycles;
+
+    std::vector<uint8_t> data(BJTCPU_STATE_SIZE, 0);
+    std::memcpy(data.data(), &header, sizeof(header));
+    std::memcpy(data.data() + BJTCPU_STATE_DISPLAY_OFFSET, state.display.getPixels(), BJTCPU_DISPLAY_PIXELS / 2);
+
+    for (int bank = 0; bank < 0x100; bank++) {
+        std::memcpy(data.data() + BJTCPU_STATE_RAM_OFFSET + bank * 0x100, state.banks[bank]->data(), 0x100);
+    }
+
+    return writeFile(path, data.data(), data.size());
+}
+
+bool readState(const std::string& path, bjtcpu_state& state) {
+    std::vector<uint8_t> data;
+    if (!readFile(path, data)) {
+        return false;
+    }
+
+    return parseState(data.data(), data.size(), state);
+}
+
+bool parseState(const uint8_t* data, size_t size, bjtcpu_state& state) {
+    if (size < BJTCPU_STATE_SIZE) {
+        return false;
+    }
+
+    bjtcpu_state_header header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.magic, "BJTS", 4) != 0 || header.version != BJTCPU_STATE_VERSION) {
+        return false;
+    }
+
+    state.id = nextStateId();
+    state.romChecksum = header.romChecksum;
+    state.pcReg = header.pc;
+    state.instrAddr = header.instrAddr;
+    std::memcpy(state.instrReg.data(), header.instrReg, 3);
+    state.instrFetchIdx = header.instrFetchIdx;
+    state.instrStageIdx = header.instrStageIdx;
+    state.flagsReg = header.flags;
+    state.stopped = header.stopped != 0;
+    state.waitCycles = header.waitCycles;
+    std::memcpy(state.regFile.data(), header.regFile, 0x10);
+    state.cycleCount = header.cycleCount;
+    state.instrCount = header.instrCount;
+    state.dmaCycles = header.dmaCycles;
+
+    state.display.load(data + BJTCPU_STATE_DISPLAY_OFFSET, header.cursorX, header.cursorY, header.anchorX,
+        header.anchorY, header.displayMode & 1);
+
+    // untouched banks stay on the shared zero bank
+    for (int bank = 0; bank < 0x100; bank++) {
+        const uint8_t* bytes = data + BJTCPU_STATE_RAM_OFFSET + bank * 0x100;
+
+        if (std::all_of(bytes, bytes + 0x100, [](uint8_t byte) { return byte == 0; })) {
+            state.banks[bank] = bjtcpu_ram::zeroBank();
+        } else {
+            std::shared_ptr<bjtcpu_ram_bank> copy = std::make_shared<bjtcpu_ram_bank>();
+            std::memcpy(copy->data(), bytes, 0x100);
+            state.banks[bank] = std::move(copy);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,76 @@
+#include "symbols.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <stdio.h>
+
+bool bjtcpu_symbols::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    symbols.clear();
+    addrs.clear();
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream stream(line);
+        std::string addr, kind, name;
+
+        if (!(stream >> addr >> kind >> name)) {
+            continue;
+        }
+
+        bjtcpu_symbol symbol;
+        symbol.addr = std::stoul(addr, nullptr, 16);
+        symbol.data = kind == "data";
+        symbol.name = name;
+
+        addrs[name] = symbol.addr;
+        symbols.push_back(symbol);
+    }
+
+    std::stable_sort(symbols.begin(), symbols.end(), [](const bjtcpu_symbol& a, const bjtcpu_symbol& b) {
+        return a.addr < b.addr;
+    });
+
+    return true;
+}
+
+const std::vector<bjtcpu_symbol>& bjtcpu_symbols::getSymbols() const {
+    return symbols;
+}
+
+bool bjtcpu_symbols::find(const std::string& name, uint16_t& addr) const {
+    auto iter = addrs.find(name);
+    if (iter == addrs.end()) {
+        return false;
+    }
+
+    addr = iter->second;
+    return true;
+}
+
+std::string bjtcpu_symbols::functionName(uint16_t addr) const {
+    const bjtcpu_symbol* function = nullptr;
+
+    for (const bjtcpu_symbol& symbol : symbols) {
+        if (symbol.addr > addr) {
+            break;
+        }
+
+        if (!symbol.data && symbol.name.find('.') == std::string::npos) {
+            function = &symbol;
+        }
+    }
+
+    if (function) {
+        return function->name;
+    }
+
+    char name[8];
+    snprintf(name, sizeof(name), "0x%04x", addr);
+    return name;
+}
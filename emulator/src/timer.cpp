@@ -0,0 +1,34 @@
+#include "timer.hpp"
+
+bjtcpu_timer::bjtcpu_timer() {
+    framePeriod = BJTCPU_FRAME_PERIOD;
+    tickPeriod = BJTCPU_TICK_PERIOD;
+}
+
+uint64_t bjtcpu_timer::wakeCycle(uint64_t cycle, uint8_t signal) const {
+    if (signal == 0) {
+        return (cycle / framePeriod + 1) * framePeriod;
+    }
+
+    return (cycle / tickPeriod + signal) * tickPeriod;
+}
+
+void bjtcpu_timer::setFramePeriod(uint16_t cycles) {
+    if (cycles != 0) {
+        framePeriod = cycles;
+    }
+}
+
+void bjtcpu_timer::setTickPeriod(uint16_t cycles) {
+    if (cycles != 0) {
+        tickPeriod = cycles;
+    }
+}
+
+uint16_t bjtcpu_timer::getFramePeriod() const {
+    return framePeriod;
+}
+
+uint16_t bjtcpu_timer::getTickPeriod() const {
+    return tickPeriod;
+}
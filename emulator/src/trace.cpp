@@ -0,0 +1,48 @@
+#include "trace.hpp"
+#include "fileio.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+bjtcpu_trace_ring::bjtcpu_trace_ring() : records(SIZE), head(0) {
+}
+
+void bjtcpu_trace_ring::clear() {
+    head.store(0, std::memory_order_release);
+}
+
+std::vector<bjtcpu_trace_record> bjtcpu_trace_ring::snapshot() const {
+    uint64_t end = head.load(std::memory_order_acquire);
+    uint64_t start = end > SIZE ? end - SIZE : 0;
+
+    std::vector<bjtcpu_trace_record> result;
+    result.reserve(end - start);
+
+    for (uint64_t i = start; i < end; i++) {
+        result.push_back(records[i & (SIZE - 1)]);
+    }
+
+    // drop anything the producer overwrote while copying
+    uint64_t overwritten = head.load(std::memory_order_acquire);
+    if (overwritten > SIZE && overwritten - SIZE > start) {
+        size_t drop = std::min<uint64_t>(overwritten - SIZE - start, result.size());
+        result.erase(result.begin(), result.begin() + drop);
+    }
+
+    return result;
+}
+
+bool bjtcpu_trace_ring::dump(const std::string& path) const {
+    std::vector<bjtcpu_trace_record> recs = snapshot();
+
+    bjtcpu_trace_header header;
+    std::memcpy(header.magic, "BJTT", 4);
+    header.version = BJTCPU_TRACE_VERSION;
+    header.count = recs.size();
+
+    std::vector<uint8_t> data(sizeof(header) + recs.size() * sizeof(bjtcpu_trace_record));
+    std::memcpy(data.data(), &header, sizeof(header));
+    std::memcpy(data.data() + sizeof(header), recs.data(), recs.size() * sizeof(bjtcpu_trace_record));
+
+    return writeFile(path, data.data(), data.size());
+}
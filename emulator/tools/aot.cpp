@@ -0,0 +1,301 @@
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+#include "decode.hpp"
+#include "symbols.hpp"
+#include "fileio.hpp"
+
+// ahead of time translator - turns an assembled ROM and its label map into C++
+// source, one function per entry point (label or return site), with a switch
+// dispatching computed targets (ret, pcall). Build the output against the
+// bjtcpu library (see bjtcpu_add_aot_executable in CMakeLists.txt)
+
+static const char* opName(bjtcpu_op op) {
+    switch (op) {
+        case bjtcpu_op::NOP:    return "nop";
+        case bjtcpu_op::STOP:   return "stop";
+        case bjtcpu_op::RET:    return "ret";
+        case bjtcpu_op::PCALL:  return "pcall";
+        case bjtcpu_op::PUSH:   return "push";
+        case bjtcpu_op::STO:    return "sto";
+        case bjtcpu_op::CMP:    return "cmp";
+        case bjtcpu_op::POP:    return "pop";
+        case bjtcpu_op::PLDA:   return "plda";
+        case bjtcpu_op::ADD:    return "add";
+        case bjtcpu_op::ADDC:   return "addc";
+        case bjtcpu_op::IADD:   return "iadd";
+        case bjtcpu_op::STRLA:  return "strla";
+        case bjtcpu_op::SUB:    return "sub";
+        case bjtcpu_op::SUBC:   return "subc";
+        case bjtcpu_op::ISUB:   return "isub";
+        case bjtcpu_op::LDRL:   return "ldrl";
+        case bjtcpu_op::IMM:    return "imm";
+        case bjtcpu_op::NAND:   return "nand";
+        case bjtcpu_op::JMP:    return "jmp";
+        case bjtcpu_op::JMPZ:   return "jmpz";
+        case bjtcpu_op::JMPN:   return "jmpn";
+        case bjtcpu_op::JMPC:   return "jmpc";
+        case bjtcpu_op::JMPO:   return "jmpo";
+        case bjtcpu_op::CALL:   return "call";
+        case bjtcpu_op::LDA:    return "lda";
+    }
+
+    return "?";
+}
+
+static std::string reg(uint8_t index) {
+    char str[32];
+    snprintf(str, sizeof(str), "m.regFile[0x%x]", index);
+    return str;
+}
+
+static std::string hex(unsigned value, int digits) {
+    char str[16];
+    snprintf(str, sizeof(str), "0x%0*x", digits, value);
+    return str;
+}
+
+static bool endsEntry(const bjtcpu_instr& instr) {
+    switch (instr.op) {
+        case bjtcpu_op::STOP:
+        case bjtcpu_op::RET:
+        case bjtcpu_op::PCALL:
+        case bjtcpu_op::CALL:
+        case bjtcpu_op::JMP:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// body of a single instruction - returns true if it always leaves the entry
+static bool emitInstr(FILE* out, const bjtcpu_instr& instr, uint16_t addr) {
+    uint16_t next = addr + instr.len;
+    const char* flagMask = nullptr;
+
+    fprintf(out, "    m.retire(%d);\n", instr.cycles);
+
+    if (instr.extReg) {
+        fprintf(out, "    m.refreshDMA();\n");
+    }
+
+    switch (instr.op) {
+        case bjtcpu_op::NOP:
+            break;
+        case bjtcpu_op::STOP:
+            fprintf(out, "    return m.stop(%s);\n", hex(next, 4).c_str());
+            return true;
+        case bjtcpu_op::RET:
+            fprintf(out, "    return m.ret();\n");
+            return true;
+        case bjtcpu_op::PCALL:
+            fprintf(out, "    return m.call(%s, (%s << 8) | %s);\n", hex(next, 4).c_str(), reg(REG_BNK).c_str(), reg(REG_ADDR).c_str());
+            return true;
+        case bjtcpu_op::CALL:
+            fprintf(out, "    return m.call(%s, %s);\n", hex(next, 4).c_str(), hex(instr.target, 4).c_str());
+            return true;
+        case bjtcpu_op::PUSH:
+            fprintf(out, "    m.push(%s);\n", reg(instr.srcX).c_str());
+            break;
+        case bjtcpu_op::POP:
+            fprintf(out, "    m.pop(0x%x);\n", instr.dest);
+            break;
+        case bjtcpu_op::STO:
+            fprintf(out, "    m.writeRAM(%s, %s, %s);\n", reg(REG_BNK).c_str(), reg(REG_ADDR).c_str(), reg(instr.srcX).c_str());
+            break;
+        case bjtcpu_op::CMP:
+            fprintf(out, "    m.compare(%s, %s);\n", reg(instr.srcX).c_str(), reg(instr.srcY).c_str());
+            break;
+        case bjtcpu_op::PLDA:
+            fprintf(out, "    m.setReg(0x%x, m.readROM(%s, %s));\n", instr.dest, reg(REG_BNK).c_str(), reg(REG_ADDR).c_str());
+            break;
+        case bjtcpu_op::ADD:
+            fprintf(out, "    m.alu(0x%x, %s + %s);\n", instr.dest, reg(instr.srcX).c_str(), reg(instr.srcY).c_str());
+            break;
+        case bjtcpu_op::ADDC:
+            fprintf(out, "    m.alu(0x%x, %s + %s + m.carry());\n", instr.dest, reg(instr.srcX).c_str(), reg(instr.srcY).c_str());
+            break;
+        case bjtcpu_op::IADD:
+            fprintf(out, "    m.alu(0x%x, %s + %s);\n", instr.dest, reg(instr.srcX).c_str(), hex(instr.imm, 2).c_str());
+            break;
+        case bjtcpu_op::SUB:
+            fprintf(out, "    m.alu(0x%x, %s - %s);\n", instr.dest, reg(instr.srcX).c_str(), reg(instr.srcY).c_str());
+            break;
+        case bjtcpu_op::SUBC:
+            fprintf(out, "    m.alu(0x%x, %s - %s + m.carry());\n", instr.dest, reg(instr.srcX).c_str(), reg(instr.srcY).c_str());
+            break;
+        case bjtcpu_op::ISUB:
+            fprintf(out, "    m.alu(0x%x, %s - %s);\n", instr.dest, reg(instr.srcX).c_str(), hex(instr.imm, 2).c_str());
+            break;
+        case bjtcpu_op::STRLA:
+            fprintf(out, "    m.writeRAM(%s, %s + %s, %s);\n", reg(REG_BNK).c_str(), reg(instr.srcX).c_str(), reg(instr.srcY).c_str(), reg(REG_A).c_str());
+            break;
+        case bjtcpu_op::LDRL:
+            fprintf(out, "    m.setReg(0x%x, m.readRAM(%s, %s + %s));\n", instr.dest, reg(REG_BNK).c_str(), reg(instr.srcX).c_str(), reg(instr.srcY).c_str());
+            break;
+        case bjtcpu_op::IMM:
+            fprintf(out, "    m.setReg(0x%x, %s);\n", instr.dest, hex(instr.imm, 2).c_str());
+            break;
+        case bjtcpu_op::NAND:
+            fprintf(out, "    m.setReg(0x%x, ~(%s & %s));\n", instr.dest, reg(instr.srcX).c_str(), reg(instr.srcY).c_str());
+            break;
+        case bjtcpu_op::JMP:
+            fprintf(out, "    return %s;\n", hex(instr.target, 4).c_str());
+            return true;
+        case bjtcpu_op::JMPZ:
+            flagMask = "FLAG_ZMASK";
+            break;
+        case bjtcpu_op::JMPN:
+            flagMask = "FLAG_NMASK";
+            break;
+        case bjtcpu_op::JMPC:
+            flagMask = "FLAG_CMASK";
+            break;
+        case bjtcpu_op::JMPO:
+            flagMask = "FLAG_OMASK";
+            break;
+        case bjtcpu_op::LDA:
+            fprintf(out, "    m.setReg(0x%x, m.readRAM(%s, %s));\n", instr.dest, reg(REG_BNK).c_str(), reg(REG_ADDR).c_str());
+            break;
+    }
+
+    if (flagMask) {
+        fprintf(out, "    if (%s(m.flagsReg)) return %s;\n", flagMask, hex(instr.target, 4).c_str());
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        printf("Usage: bjtcpu-aot <rom.bin> <rom.labels> <out.cpp>\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> romBin;
+    if (!readFile(argv[1], romBin) || romBin.size() > 0x10000) {
+        printf("Could not open ROM file \"%s\"\n", argv[1]);
+        return 1;
+    }
+
+    bjtcpu_symbols symbols;
+    if (!symbols.load(argv[2])) {
+        printf("Could not open label file \"%s\"\n", argv[2]);
+        return 1;
+    }
+
+    std::vector<uint8_t> rom(0x10000, 0);
+    std::copy(romBin.begin(), romBin.end(), rom.begin());
+
+    std::vector<bjtcpu_instr> decoded(0x10000);
+    decodeROM(rom.data(), decoded.data());
+
+    // entry points - reset vector, code labels and the return site of every reachable call
+    std::map<uint16_t, std::vector<std::string>> entries;
+    entries[0];
+
+    for (const bjtcpu_symbol& symbol : symbols.getSymbols()) {
+        if (!symbol.data) {
+            entries[symbol.addr].push_back(symbol.name);
+        }
+    }
+
+    std::set<uint16_t> visited;
+    std::vector<uint16_t> worklist;
+    for (auto& [addr, names] : entries) {
+        worklist.push_back(addr);
+    }
+
+    while (!worklist.empty()) {
+        uint16_t addr = worklist.back();
+        worklist.pop_back();
+
+        while (visited.insert(addr).second) {
+            const bjtcpu_instr& instr = decoded[addr];
+            uint16_t next = addr + instr.len;
+
+            if (instr.op == bjtcpu_op::CALL || instr.op == bjtcpu_op::PCALL) {
+                entries[next];
+                worklist.push_back(next);
+            }
+
+            if (instr.op == bjtcpu_op::CALL || instr.op == bjtcpu_op::JMP || instr.op == bjtcpu_op::JMPZ ||
+                instr.op == bjtcpu_op::JMPN || instr.op == bjtcpu_op::JMPC || instr.op == bjtcpu_op::JMPO) {
+                entries[instr.target];
+                worklist.push_back(instr.target);
+            }
+
+            if (endsEntry(instr) || next < addr) {
+                break;
+            }
+
+            addr = next;
+        }
+    }
+
+    FILE* out = fopen(argv[3], "w");
+    if (!out) {
+        printf("Could not write \"%s\"\n", argv[3]);
+        return 1;
+    }
+
+    fprintf(out, "// generated by bjtcpu-aot from %s - do not edit\n\n", argv[1]);
+    fprintf(out, "#include \"aot_runtime.hpp\"\n\n");
+
+    fprintf(out, "static const uint8_t ROM[0x10000] = {");
+    for (size_t i = 0; i < romBin.size(); i++) {
+        fprintf(out, "%s0x%02x,", i % 16 == 0 ? "\n    " : " ", romBin[i]);
+    }
+    fprintf(out, "\n};\n");
+
+    for (auto entry = entries.begin(); entry != entries.end(); entry++) {
+        uint16_t addr = entry->first;
+        auto nextEntry = std::next(entry);
+
+        fprintf(out, "\n");
+        for (const std::string& name : entry->second) {
+            fprintf(out, "// %s\n", name.c_str());
+        }
+        fprintf(out, "static uint16_t entry_%04x(bjtcpu_aot_machine& m) {\n", addr);
+
+        bool left = false;
+        while (!left) {
+            const bjtcpu_instr& instr = decoded[addr];
+            uint16_t next = addr + instr.len;
+
+            fprintf(out, "    // %04x: %s\n", addr, opName(instr.op));
+            left = emitInstr(out, instr, addr);
+
+            if (!left && (next < addr || (nextEntry != entries.end() && next >= nextEntry->first))) {
+                fprintf(out, "    return %s;\n", hex(next, 4).c_str());
+                left = true;
+            }
+
+            addr = next;
+        }
+
+        fprintf(out, "}\n");
+    }
+
+    fprintf(out, "\nstatic uint16_t dispatch(bjtcpu_aot_machine& m, uint16_t pc) {\n");
+    fprintf(out, "    switch (pc) {\n");
+    for (auto& [addr, names] : entries) {
+        fprintf(out, "        case 0x%04x: return entry_%04x(m);\n", addr, addr);
+    }
+    fprintf(out, "        default: return m.unknownEntry(pc);\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "int main(int argc, char** argv) {\n");
+    fprintf(out, "    return bjtcpu_aot_main(argc, argv, ROM, dispatch);\n");
+    fprintf(out, "}\n");
+
+    fclose(out);
+
+    printf("Translated %zu entry points to \"%s\"\n", entries.size(), argv[3]);
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <random>
+#include <initializer_list>
+
+#include "bjtcpu.hpp"
+
+// shared by the differential tests - a reference CPU is stepped a cycle at a
+// time while another runs the same budget through run() or runCycles(), and
+// the two must agree on everything a saved state holds
+
+// loops back to here, after the jmp at 0 that buildLoopProgram() starts with
+static constexpr uint16_t DIFFTEST_START_ADDR = 0x0003;
+
+// ra to rc
+inline uint8_t randomReg(std::mt19937& random) {
+    return random() % 3;
+}
+
+inline void emit(std::vector<uint8_t>& rom, uint16_t& addr, std::initializer_list<uint8_t> bytes) {
+    for (uint8_t byte : bytes) {
+        rom[addr++] = byte;
+    }
+}
+
+inline void emitJump(std::vector<uint8_t>& rom, uint16_t& addr, uint8_t op, uint16_t target) {
+    emit(rom, addr, { op, (uint8_t)(target >> 8), (uint8_t)(target & 0xFF) });
+}
+
+// straight-line code that loops back to the start - emitItem(rom, addr)
+// appends one randomly chosen item each time it is called
+template <typename EmitItem>
+std::vector<uint8_t> buildLoopProgram(std::mt19937& random, EmitItem emitItem) {
+    std::vector<uint8_t> rom(0x10000, OP_STOP);
+    uint16_t addr = 0;
+    emitJump(rom, addr, OP_JMP, DIFFTEST_START_ADDR);
+
+    for (int i = 0, count = 4 + random() % 24; i < count; i++) {
+        emitItem(rom, addr);
+    }
+
+    emitJump(rom, addr, OP_JMP, DIFFTEST_START_ADDR);
+    return rom;
+}
+
+inline bool sameRAM(const bjtcpu_state& a, const bjtcpu_state& b) {
+    for (size_t i = 0; i < 0x100; i++) {
+        if (a.banks[i] != b.banks[i] && *a.banks[i] != *b.banks[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool sameState(bjtcpu& a, bjtcpu& b) {
+    bjtcpu_state stateA = a.saveState();
+    bjtcpu_state stateB = b.saveState();
+
+    // step() leaves a stop half fetched where run() retires it whole
+    bool sameFetch = stateA.stopped ||
+        (stateA.instrFetchIdx == stateB.instrFetchIdx && stateA.instrStageIdx == stateB.instrStageIdx);
+
+    return stateA.pcReg == stateB.pcReg && stateA.regFile == stateB.regFile && stateA.flagsReg == stateB.flagsReg &&
+        sameFetch && stateA.cycleCount == stateB.cycleCount && stateA.instrCount == stateB.instrCount &&
+        stateA.stopped == stateB.stopped && stateA.waitCycles == stateB.waitCycles &&
+        stateA.dmaCycles == stateB.dmaCycles && sameRAM(stateA, stateB);
+}
+
+inline const char* engineName(bjtcpu_engine engine) {
+    return engine == bjtcpu_engine::BLOCK ? "block" : "interp";
+}
+
+// budget instructions or cycles on both CPUs - the reference through
+// stepReference(), which steps it once, and fast through run() or runCycles()
+template <typename StepReference>
+void runBudget(bjtcpu& reference, bjtcpu& fast, bool byInstrs, uint64_t budget, StepReference stepReference) {
+    if (byInstrs) {
+        uint64_t end = reference.getInstrCount() + budget;
+        while (!reference.isStopped() && reference.getInstrCount() < end) {
+            stepReference();
+        }
+        fast.run(budget);
+    } else {
+        for (uint64_t i = 0; i < budget && !reference.isStopped(); i++) {
+            stepReference();
+        }
+        fast.runCycles(budget);
+    }
+}
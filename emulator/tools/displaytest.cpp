@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <cstring>
+
+#include "display.hpp"
+#include "state.hpp"
+
+// checks the display protocol against a pixel at a time model - random signal
+// sequences, weighted towards the fills and auto-increment writes, must leave
+// the same pixels, cursor and anchor after every signal. expandPixels() is
+// checked against a pixel at a time palette lookup for random palettes and
+// lengths, so the vector kernels' tails go through the table as well. A saved
+// state with a cursor or anchor past the screen must load onto it
+
+static constexpr int CASES = 2000;
+static constexpr int SIGNALS = 200;
+static constexpr int EXPAND_CASES = 2000;
+static constexpr int CORRUPT_CASES = 200;
+
+struct reference_display {
+    std::array<uint8_t, BJTCPU_DISPLAY_PIXELS> pixels{};
+    int cursorX = 0;
+    int cursorY = 0;
+    int anchorX = 0;
+    int anchorY = 0;
+    bool autoIncrement = false;
+
+    void fill(int x0, int y0, int x1, int y1, uint8_t colour) {
+        for (int y = std::min(y0, y1); y <= std::max(y0, y1); y++) {
+            for (int x = std::min(x0, x1); x <= std::max(x0, x1); x++) {
+                pixels[y * BJTCPU_DISPLAY_WIDTH + x] = colour;
+            }
+        }
+    }
+
+    void signal(uint8_t value) {
+        if ((value & 0xC0) == 0x40) {
+            cursorX = value & 0x3F;
+        } else if ((value & 0xC0) == 0x80) {
+            cursorY = value & 0x3F;
+        } else if ((value & 0xC0) == 0xC0) {
+            pixels[cursorY * BJTCPU_DISPLAY_WIDTH + cursorX] = value & 0xF;
+            if (autoIncrement) {
+                int index = (cursorY * BJTCPU_DISPLAY_WIDTH + cursorX + 1) % BJTCPU_DISPLAY_PIXELS;
+                cursorX = index % BJTCPU_DISPLAY_WIDTH;
+                cursorY = index / BJTCPU_DISPLAY_WIDTH;
+            }
+        } else if (value == 0x01) {
+            pixels.fill(0);
+        } else if (value == 0x02 || value == 0x03) {
+            autoIncrement = value == 0x03;
+        } else if (value == 0x04) {
+            anchorX = cursorX;
+            anchorY = cursorY;
+        } else if ((value & 0xF0) == 0x10) {
+            fill(anchorX, cursorY, cursorX, cursorY, value & 0xF);
+        } else if ((value & 0xF0) == 0x20) {
+            fill(anchorX, anchorY, cursorX, cursorY, value & 0xF);
+        } else if ((value & 0xF0) == 0x30) {
+            pixels.fill(value & 0xF);
+        }
+    }
+};
+
+static uint8_t randomSignal(std::mt19937& random) {
+    switch (random() % 8) {
+        case 0:
+            return 0x40 | (random() % 64);
+        case 1:
+            return 0x80 | (random() % 64);
+        case 2:
+            return 0xC0 | (random() % 64);
+        case 3:
+            return 0x02 + random() % 3;
+        case 4:
+            return 0x10 | (random() % 16);
+        case 5:
+            return 0x20 | (random() % 16);
+        case 6:
+            // clears are rare, or nothing would survive long enough to compare
+            return random() % 8 == 0 ? (random() % 2 ? 0x01 : 0x30 | (random() % 16)) : 0x00;
+        default:
+            return random();
+    }
+}
+
+static bool samePixels(const bjtcpu_display& display, const reference_display& reference) {
+    const uint8_t* packed = display.getPixels();
+
+    for (int i = 0; i < BJTCPU_DISPLAY_PIXELS; i++) {
+        uint8_t pixel = i & 1 ? packed[i / 2] >> 4 : packed[i / 2] & 0xF;
+        if (pixel != reference.pixels[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t checkExpand(std::mt19937& random) {
+    std::array<uint8_t, BJTCPU_DISPLAY_PIXELS / 2> packed;
+    std::array<uint32_t, BJTCPU_DISPLAY_PIXELS> out;
+    uint64_t failures = 0;
+
+    for (int c = 0; c < EXPAND_CASES; c++) {
+        // the odd greyscale palette shows a rebuilt table is not stale
+        bjtcpu_palette palette = greyscalePalette();
+        if (c % 7 != 0) {
+            for (uint32_t& colour : palette.colours) {
+                colour = random();
+            }
+        }
+
+        for (uint8_t& byte : packed) {
+            byte = random();
+        }
+
+        size_t offset = random() % 64;
+        size_t count = (random() % (BJTCPU_DISPLAY_PIXELS - offset * 2)) & ~(size_t)1;
+        out.fill(0);
+        expandPixels(packed.data() + offset, count, out.data(), palette);
+
+        for (size_t i = 0; i < out.size(); i++) {
+            uint8_t byte = packed[offset + i / 2];
+            uint32_t expected = i >= count ? 0 : palette.colours[i & 1 ? byte >> 4 : byte & 0xF];
+            if (out[i] != expected) {
+                if (failures < 10) {
+                    printf("expand case %d: %zu pixels from byte %zu, pixel %zu is %08x not %08x\n", c, count,
+                        offset, i, out[i], expected);
+                }
+                failures++;
+                break;
+            }
+        }
+    }
+
+    return failures;
+}
+
+// a state whose header holds random cursor and anchor bytes, then random
+// signals - both come back masked as sendSignal() would have set them
+static uint64_t checkCorruptState(std::mt19937& random) {
+    std::vector<uint8_t> data(BJTCPU_STATE_SIZE, 0);
+    uint64_t failures = 0;
+
+    for (int c = 0; c < CORRUPT_CASES; c++) {
+        bjtcpu_state_header header{};
+        std::memcpy(header.magic, "BJTS", 4);
+        header.version = BJTCPU_STATE_VERSION;
+        header.cursorX = c == 0 ? 0xFF : random();
+        header.cursorY = c == 0 ? 0xFF : random();
+        header.anchorX = c == 0 ? 0xFF : random();
+        header.anchorY = c == 0 ? 0xFF : random();
+        std::memcpy(data.data(), &header, sizeof(header));
+
+        bjtcpu_state state;
+        if (!parseState(data.data(), data.size(), state)) {
+            printf("corrupt state %d: not parsed\n", c);
+            failures++;
+            continue;
+        }
+
+        reference_display reference;
+        reference.cursorX = header.cursorX & 0x3F;
+        reference.cursorY = header.cursorY & 0x3F;
+        reference.anchorX = header.anchorX & 0x3F;
+        reference.anchorY = header.anchorY & 0x3F;
+
+        bjtcpu_display& display = state.display;
+        for (int i = 0; i <= SIGNALS; i++) {
+            if (display.getCursorX() != reference.cursorX || display.getCursorY() != reference.cursorY ||
+                display.getAnchorX() != reference.anchorX || display.getAnchorY() != reference.anchorY ||
+                !samePixels(display, reference)) {
+                if (failures < 10) {
+                    printf("corrupt state %d (cursor %02x,%02x anchor %02x,%02x) signal %d: cursor %u,%u/%d,%d "
+                        "anchor %u,%u/%d,%d\n", c, header.cursorX, header.cursorY, header.anchorX, header.anchorY, i,
+                        display.getCursorX(), display.getCursorY(), reference.cursorX, reference.cursorY,
+                        display.getAnchorX(), display.getAnchorY(), reference.anchorX, reference.anchorY);
+                }
+                failures++;
+                break;
+            }
+
+            uint8_t value = randomSignal(random);
+            display.sendSignal(value);
+            reference.signal(value);
+        }
+    }
+
+    return failures;
+}
+
+int main() {
+    bjtcpu_display display;
+    std::mt19937 random(1);
+    uint64_t failures = checkExpand(random) + checkCorruptState(random);
+
+    for (int c = 0; c < CASES; c++) {
+        display.reset();
+        reference_display reference;
+
+        for (int i = 0; i < SIGNALS; i++) {
+            uint8_t value = randomSignal(random);
+            display.sendSignal(value);
+            reference.signal(value);
+
+            if (display.getCursorX() != reference.cursorX || display.getCursorY() != reference.cursorY ||
+                display.getAnchorX() != reference.anchorX || display.getAnchorY() != reference.anchorY ||
+                display.isAutoIncrement() != reference.autoIncrement || !samePixels(display, reference)) {
+                if (failures < 10) {
+                    printf("case %d signal %d (%02x): cursor %u,%u/%d,%d anchor %u,%u/%d,%d\n", c, i, value,
+                        display.getCursorX(), display.getCursorY(), reference.cursorX, reference.cursorY,
+                        display.getAnchorX(), display.getAnchorY(), reference.anchorX, reference.anchorY);
+                }
+                failures++;
+                break;
+            }
+        }
+    }
+
+    printf("%d cases, %llu failed\n", CASES, (unsigned long long)failures);
+
+    return failures == 0 ? 0 : 1;
+}
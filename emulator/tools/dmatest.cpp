@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <random>
+#include <string>
+#include <filesystem>
+
+#include "bjtcpu.hpp"
+#include "difftest.hpp"
+
+// differential check of the DMA device - random programs that set up and start
+// copies and fills, read rdma and poll it until the transfer finishes run under
+// random per-byte costs, by step() alone and by run()/runCycles() on both
+// engines with random budgets, hopping to a CPU restored from a saved state part
+// way through. Registers, PC, counts, cycles left busy and all of RAM must
+// agree. bjtcpu_ram::move() and fill() are also checked against a byte by byte
+// model, around the bank wrap and with overlapping ranges, and a backlog of
+// queued transfers past 2^32 cycles must survive saving and reloading
+
+static constexpr int CASES = 600;
+static constexpr int RAM_CASES = 20000;
+static constexpr uint64_t MAX_CYCLES = 30000;
+
+// mostly small, with the 0 (256 bytes) and bank wrap cases
+static uint8_t randomLength(std::mt19937& random) {
+    switch (random() % 4) {
+        case 0:
+            return 0;
+        case 1:
+            return 0xF0 + random() % 0x10;
+        default:
+            return 1 + random() % 0x20;
+    }
+}
+
+// a transfer started every few instructions, and some of them polled to the end
+static std::vector<uint8_t> buildProgram(std::mt19937& random) {
+    return buildLoopProgram(random, [&](std::vector<uint8_t>& rom, uint16_t& addr) {
+        uint8_t dest = randomReg(random);
+        uint8_t src = randomReg(random);
+
+        switch (random() % 12) {
+            case 0:
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_DMA_SRCB), (uint8_t)(random() % 4) });
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_DMA_SRCA), (uint8_t)random() });
+                break;
+            case 1:
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_DMA_DSTB), (uint8_t)(random() % 4) });
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_DMA_DSTA), (uint8_t)random() });
+                break;
+            case 2:
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_DMA_LEN), randomLength(random) });
+                break;
+            case 3:
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_DMA), (uint8_t)(random() % 2) });
+                break;
+            case 4:
+                emit(rom, addr, { (uint8_t)(OP_IMM | src), (uint8_t)random() });
+                emit(rom, addr, { OP_PUSH, (uint8_t)(src << 4) });
+                emit(rom, addr, { (uint8_t)(OP_POP | REG_DMA) });
+                break;
+            case 5:
+                // starts a copy or fill depending on whether one is running
+                emit(rom, addr, { (uint8_t)(OP_IADD | REG_DMA), (uint8_t)(REG_DMA << 4), 0 });
+                break;
+            case 6:
+                emit(rom, addr, { (uint8_t)(OP_ADD | dest), (uint8_t)(src << 4 | REG_DMA) });
+                break;
+            case 7:
+                emit(rom, addr, { OP_PUSH, (uint8_t)(REG_DMA << 4) });
+                emit(rom, addr, { (uint8_t)(OP_POP | dest) });
+                break;
+            case 8: {
+                // poll until idle, directly or through the stack - push reads
+                // rdma a cycle before it retires
+                bool pushed = random() % 2;
+                uint16_t head = addr + 2;
+                uint16_t done = head + (pushed ? 11 : 8);
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_C), 0 });
+                if (pushed) {
+                    emit(rom, addr, { OP_PUSH, (uint8_t)(REG_DMA << 4) });
+                    emit(rom, addr, { (uint8_t)(OP_POP | REG_A) });
+                    emit(rom, addr, { OP_CMP, (uint8_t)(REG_A << 4 | REG_C) });
+                } else {
+                    emit(rom, addr, { OP_CMP, (uint8_t)(REG_DMA << 4 | REG_C) });
+                }
+                emitJump(rom, addr, OP_JMPZ, done);
+                emitJump(rom, addr, OP_JMP, head);
+                break;
+            }
+            case 9:
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_BNK), (uint8_t)(random() % 4) });
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_ADDR), (uint8_t)random() });
+                emit(rom, addr, { OP_STO, (uint8_t)(src << 4) });
+                break;
+            case 10:
+                emit(rom, addr, { (uint8_t)(OP_LDRL | dest), (uint8_t)(REG_ADDR << 4 | src) });
+                break;
+            default:
+                emit(rom, addr, { (uint8_t)(OP_NAND | dest), (uint8_t)(src << 4 | randomReg(random)) });
+                break;
+        }
+    });
+}
+
+// move() and fill() against the obvious loops, on banks that are shared with
+// a saved copy half the time
+static uint64_t checkRAM(std::mt19937& random) {
+    bjtcpu_ram ram;
+    std::vector<uint8_t> model(0x10000);
+    uint64_t failures = 0;
+
+    for (int i = 0; i < 0x10000; i++) {
+        model[i] = random();
+        ram.write(i >> 8, i & 0xFF, model[i]);
+    }
+
+    for (int c = 0; c < RAM_CASES; c++) {
+        bjtcpu_ram_banks saved;
+        if (random() % 2) {
+            saved = ram.share();
+        }
+
+        uint8_t destBank = random() % 4;
+        uint8_t destAddr = random();
+        uint8_t srcBank = random() % 2 ? destBank : random() % 4;
+        uint8_t srcAddr = random() % 2 ? destAddr + random() % 9 - 4 : random();
+        uint8_t length = randomLength(random);
+        size_t bytes = length == 0 ? 0x100 : length;
+
+        if (random() % 4 == 0) {
+            uint8_t value = random();
+            ram.fill(destBank, destAddr, value, bytes);
+
+            for (size_t i = 0; i < bytes; i++) {
+                model[destBank << 8 | (uint8_t)(destAddr + i)] = value;
+            }
+        } else {
+            ram.move(destBank, destAddr, srcBank, srcAddr, bytes);
+
+            std::vector<uint8_t> staged(bytes);
+            for (size_t i = 0; i < bytes; i++) {
+                staged[i] = model[srcBank << 8 | (uint8_t)(srcAddr + i)];
+            }
+            for (size_t i = 0; i < bytes; i++) {
+                model[destBank << 8 | (uint8_t)(destAddr + i)] = staged[i];
+            }
+        }
+
+        for (int i = 0; i < 0x400; i++) {
+            if (ram.read(i >> 8, i & 0xFF) != model[i]) {
+                if (failures < 10) {
+                    printf("ram case %d: %02x:%02x <- %02x:%02x length %u differs at %04x\n", c, destBank, destAddr,
+                        srcBank, srcAddr, length, i);
+                }
+                failures++;
+                break;
+            }
+        }
+    }
+
+    return failures;
+}
+
+// queued transfers (and a wait) longer than 32 bits can count, through a
+// saved state and a state file
+static uint64_t checkLongBacklog() {
+    bjtcpu cpu;
+    std::vector<uint8_t> rom(0x10000, OP_STOP);
+    cpu.loadROM(rom.data(), rom.size());
+
+    bjtcpu_state state = cpu.saveState();
+    state.dmaCycles = (1ull << 32) + 0x1234;
+    state.waitCycles = (1ull << 33) + 0x5678;
+    cpu.loadState(state);
+
+    std::string path = (std::filesystem::temp_directory_path() / "bjtcpu-dmatest.state").string();
+    bjtcpu_state read;
+    bool readBack = writeState(path, cpu.saveState()) && readState(path, read);
+    std::filesystem::remove(path);
+
+    if (cpu.getDMACycles() != state.dmaCycles || cpu.getWaitCycles() != state.waitCycles || !readBack ||
+        read.dmaCycles != state.dmaCycles || read.waitCycles != state.waitCycles) {
+        printf("backlog: busy %llu wait %llu after loading, %llu/%llu from file\n",
+            (unsigned long long)cpu.getDMACycles(), (unsigned long long)cpu.getWaitCycles(),
+            (unsigned long long)read.dmaCycles, (unsigned long long)read.waitCycles);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main() {
+    std::unique_ptr<bjtcpu> reference = std::make_unique<bjtcpu>();
+    std::unique_ptr<bjtcpu> fast = std::make_unique<bjtcpu>();
+    std::unique_ptr<bjtcpu> restored = std::make_unique<bjtcpu>();
+
+    std::mt19937 random(1);
+    uint64_t transfers = 0;
+    uint64_t failures = checkRAM(random) + checkLongBacklog();
+
+    for (int c = 0; c < CASES; c++) {
+        std::vector<uint8_t> rom = buildProgram(random);
+        uint8_t byteCycles = random() % 4 == 0 ? 0 : 1 + random() % 8;
+
+        std::shared_ptr<const bjtcpu_rom_image> image = bjtcpu_rom_image::create(rom.data(), rom.size());
+        for (bjtcpu* cpu : { reference.get(), fast.get(), restored.get() }) {
+            cpu->setROM(image);
+            cpu->reset();
+            cpu->getDMA().setByteCycles(byteCycles);
+        }
+
+        bjtcpu_engine engine = c % 2 ? bjtcpu_engine::BLOCK : bjtcpu_engine::INTERPRETER;
+        bool byInstrs = c % 4 >= 2;
+        fast->setEngine(engine);
+        restored->setEngine(engine);
+
+        bool failed = false;
+        uint64_t lastCycles = 0;
+
+        while (reference->getCycleCount() < MAX_CYCLES && !failed) {
+            uint64_t budget = random() % 3 == 0 ? 1 + random() % 8 : 1 + random() % 600;
+
+            auto stepReference = [&]() {
+                reference->step();
+
+                // a start adds the new transfer's cycles to any left
+                uint64_t cycles = reference->getDMACycles();
+                if (cycles > lastCycles) {
+                    transfers++;
+                }
+                lastCycles = cycles;
+            };
+
+            runBudget(*reference, *fast, byInstrs, budget, stepReference);
+
+            failed = !sameState(*reference, *fast);
+
+            // carry on from a copy, which must pick up any transfer in progress
+            if (random() % 4 == 0) {
+                restored->loadState(fast->saveState());
+                std::swap(fast, restored);
+            }
+        }
+
+        if (failed) {
+            if (failures < 10) {
+                printf("case %d %s %s byte cycles %u: pc %04x/%04x cycles %llu/%llu busy %llu/%llu\n", c,
+                    engineName(engine), byInstrs ? "run" : "runCycles", byteCycles,
+                    reference->getPCValue(), fast->getPCValue(), (unsigned long long)reference->getCycleCount(),
+                    (unsigned long long)fast->getCycleCount(), (unsigned long long)reference->getDMACycles(),
+                    (unsigned long long)fast->getDMACycles());
+            }
+            failures++;
+        }
+    }
+
+    printf("%d cases, %llu transfers, %llu failed\n", CASES, (unsigned long long)transfers,
+        (unsigned long long)failures);
+
+    if (transfers == 0) {
+        failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
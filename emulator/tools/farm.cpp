@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#include "farm.hpp"
+
+// bulk runner - runs every ROM many times across a thread pool, checks that
+// repeated runs agree and reports aggregate throughput
+
+static void printUsage() {
+    printf("Usage: bjtcpu-farm <rom.bin>... [options]\n");
+    printf("  --cycles N    cycles per run (default 1000000)\n");
+    printf("  --repeat N    runs per ROM (default 64)\n");
+    printf("  --threads N   worker threads (default one per hardware thread)\n");
+    printf("  --engine E    execution engine: interp (default) or block\n");
+    printf("  --load-state FILE  start every run from a saved machine state\n");
+    printf("  --scaling     repeat the batch with 1, 2, 4... threads\n");
+}
+
+static bool sameResult(const bjtcpu_farm_result& a, const bjtcpu_farm_result& b) {
+    return a.ok == b.ok && a.stopped == b.stopped && a.pc == b.pc && a.regFile == b.regFile &&
+        a.cycles == b.cycles && a.instrs == b.instrs;
+}
+
+// runs the batch once, returns false if any repeat disagreed with the first run of its ROM
+static bool runBatch(bjtcpu_farm& farm, const std::vector<bjtcpu_farm_job>& jobs, size_t repeat, bool verbose) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<bjtcpu_farm_result> results = farm.run(jobs);
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000000000.0;
+
+    bool ok = true;
+    uint64_t totalCycles = 0;
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const bjtcpu_farm_result& first = results[i - i % repeat];
+        if (!results[i].ok || !sameResult(results[i], first)) {
+            ok = false;
+        }
+        totalCycles += results[i].cycles;
+    }
+
+    if (verbose) {
+        for (size_t i = 0; i < results.size(); i += repeat) {
+            const bjtcpu_farm_result& result = results[i];
+            printf("%s  pc %04x  cycles %llu  instrs %llu%s\n", result.ok ? "ok  " : "FAIL", result.pc,
+                (unsigned long long)result.cycles, (unsigned long long)result.instrs, result.stopped ? "  stopped" : "");
+        }
+    }
+
+    printf("%2u threads  %zu runs  %.3f s  %.1f MHz aggregate\n", farm.getThreadCount(), results.size(), seconds,
+        seconds > 0 ? totalCycles / seconds / 1000000.0 : 0.0);
+
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> romPaths;
+    uint64_t cycles = 1000000;
+    size_t repeat = 64;
+    unsigned threads = 0;
+    bjtcpu_engine engine = bjtcpu_engine::INTERPRETER;
+    std::string loadStatePath;
+    bool scaling = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--cycles" && hasValue) {
+            cycles = std::strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--repeat" && hasValue) {
+            repeat = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 0));
+        } else if (arg == "--threads" && hasValue) {
+            threads = std::strtoul(argv[++i], nullptr, 0);
+        } else if (arg == "--engine" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "interp") {
+                engine = bjtcpu_engine::INTERPRETER;
+            } else if (name == "block") {
+                engine = bjtcpu_engine::BLOCK;
+            } else {
+                printf("Unknown engine \"%s\"\n", name.c_str());
+                return 1;
+            }
+        } else if (arg == "--load-state" && hasValue) {
+            loadStatePath = argv[++i];
+        } else if (arg == "--scaling") {
+            scaling = true;
+        } else if (arg[0] != '-') {
+            romPaths.push_back(arg);
+        } else {
+            printf("Unknown argument \"%s\"\n", arg.c_str());
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (romPaths.empty()) {
+        printUsage();
+        return 1;
+    }
+
+    std::shared_ptr<bjtcpu_state> initialState;
+    if (!loadStatePath.empty()) {
+        initialState = std::make_shared<bjtcpu_state>();
+        if (!readState(loadStatePath, *initialState)) {
+            printf("Could not read state file \"%s\"\n", loadStatePath.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<bjtcpu_farm_job> jobs;
+
+    for (const std::string& path : romPaths) {
+        // every run of this ROM shares one image
+        std::shared_ptr<const bjtcpu_rom_image> rom = bjtcpu_rom_image::load(path);
+        if (!rom) {
+            printf("Could not open ROM file \"%s\"\n", path.c_str());
+            return 1;
+        }
+
+        for (size_t i = 0; i < repeat; i++) {
+            bjtcpu_farm_job job;
+            job.rom = rom;
+            job.initialState = initialState;
+            job.cycles = cycles;
+            job.engine = engine;
+            jobs.push_back(job);
+        }
+    }
+
+    bool ok = true;
+
+    if (scaling) {
+        unsigned maxThreads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned count = 1; count <= maxThreads; count *= 2) {
+            bjtcpu_farm farm(count);
+            ok &= runBatch(farm, jobs, repeat, false);
+        }
+    } else {
+        bjtcpu_farm farm(threads);
+        ok = runBatch(farm, jobs, repeat, true);
+    }
+
+    if (!ok) {
+        printf("Runs disagreed or failed to load their initial state\n");
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "bjtcpu.hpp"
+
+// differential check of the lazily evaluated FLAGS against aluFlags() - every
+// ALU op runs on all 2^16 operand pairs through the stepper, the interpreter
+// and the block engine, followed by a conditional jump that rotates with the
+// pair. Each flag test is also checked on its own for every possible input
+
+struct flag_op {
+    const char* name;
+    uint8_t opcode;     // high nibble, dest ra
+    bool immediate;     // y in the instruction rather than rb
+    bool carryIn;       // adds the C flag
+    bool sub;
+    bool compare;
+};
+
+static const flag_op OPS[] = {
+    { "add",  0x40, false, false, false, false },
+    { "addc", 0x50, false, true,  false, false },
+    { "sub",  0x70, false, false, true,  false },
+    { "subc", 0x80, false, true,  true,  false },
+    { "iadd", 0xC0, true,  false, false, false },
+    { "isub", 0xD0, true,  false, true,  false },
+    { "cmp",  OP_CMP, false, false, true, true },
+};
+
+static constexpr size_t OP_COUNT = sizeof(OPS) / sizeof(OPS[0]);
+
+static const uint8_t JUMPS[4] = { OP_JMPZ, OP_JMPN, OP_JMPC, OP_JMPO };
+static const uint8_t JUMP_BITS[4] = { FLAG_ZBIT, FLAG_NBIT, FLAG_CBIT, FLAG_OBIT };
+
+static constexpr uint16_t TAKEN = 0xF000;
+static constexpr uint16_t LOADED_CASES = 0xE000;
+
+enum class flag_path { STEP, INTERPRETER, BLOCK };
+
+static const char* pathName(flag_path path) {
+    switch (path) {
+        case flag_path::STEP:
+            return "step";
+        case flag_path::INTERPRETER:
+            return "interp";
+        default:
+            return "block";
+    }
+}
+
+// op then jump, 8 bytes per case, for every op, jump and immediate
+static uint16_t caseAddr(size_t op, size_t jump, uint8_t y) {
+    return ((op * 4 + jump) * 0x100 + y) * 8;
+}
+
+static std::vector<uint8_t> buildROM() {
+    std::vector<uint8_t> rom(0x10000, OP_STOP);
+
+    for (size_t op = 0; op < OP_COUNT; op++) {
+        for (size_t jump = 0; jump < 4; jump++) {
+            for (int y = 0; y < 0x100; y++) {
+                uint8_t* code = &rom[caseAddr(op, jump, y)];
+
+                // ra = ra op rb, or ra = ra op y
+                if (OPS[op].immediate) {
+                    *code++ = OPS[op].opcode;
+                    *code++ = 0x00;
+                    *code++ = y;
+                } else {
+                    *code++ = OPS[op].opcode;
+                    *code++ = 0x01;
+                }
+
+                *code++ = JUMPS[jump];
+                *code++ = TAKEN >> 8;
+                *code++ = TAKEN & 0xFF;
+            }
+        }
+    }
+
+    // jumps alone, for flags restored from a snapshot
+    for (size_t jump = 0; jump < 4; jump++) {
+        uint8_t* code = &rom[LOADED_CASES + jump * 8];
+        *code++ = JUMPS[jump];
+        *code++ = TAKEN >> 8;
+        *code++ = TAKEN & 0xFF;
+    }
+
+    return rom;
+}
+
+static void runCase(bjtcpu& cpu, flag_path path, uint64_t instrs) {
+    if (path == flag_path::STEP) {
+        while (cpu.getInstrCount() < instrs && !cpu.isStopped()) {
+            cpu.step();
+        }
+    } else {
+        cpu.run(instrs);
+    }
+}
+
+int main() {
+    std::vector<uint8_t> rom = buildROM();
+
+    std::unique_ptr<bjtcpu> cpu = std::make_unique<bjtcpu>();
+    cpu->loadROM(rom.data(), rom.size());
+
+    bjtcpu_state state = cpu->saveState();
+    uint64_t cases = 0;
+    uint64_t failures = 0;
+
+    for (flag_path path : { flag_path::STEP, flag_path::INTERPRETER, flag_path::BLOCK }) {
+        cpu->setEngine(path == flag_path::BLOCK ? bjtcpu_engine::BLOCK : bjtcpu_engine::INTERPRETER);
+
+        for (size_t op = 0; op < OP_COUNT; op++) {
+            const flag_op& spec = OPS[op];
+
+            for (int carry = 0; carry <= (spec.carryIn ? 1 : 0); carry++) {
+                for (int pair = 0; pair < 0x10000; pair++) {
+                    uint8_t x = pair >> 8;
+                    uint8_t y = pair & 0xFF;
+                    size_t jump = x & 3;
+
+                    uint8_t result = spec.sub ? x - y : x + y;
+                    if (spec.carryIn && carry) {
+                        result++;
+                    }
+
+                    uint8_t expectedFlags = aluFlags(x, result, !spec.compare);
+                    uint8_t expectedA = spec.compare ? x : result;
+
+                    uint16_t addr = caseAddr(op, jump, y);
+                    uint16_t fallThrough = addr + (spec.immediate ? 3 : 2) + 3;
+                    uint16_t expectedPC = expectedFlags & (1 << JUMP_BITS[jump]) ? TAKEN : fallThrough;
+
+                    // stale flags going in must not leak into the result
+                    state.pcReg = addr;
+                    state.regFile[REG_A] = x;
+                    state.regFile[REG_B] = y;
+                    state.flagsReg = (pair * 7 & 0xD) | (carry << FLAG_CBIT);
+
+                    cpu->loadState(state);
+                    runCase(*cpu, path, 2);
+                    cases++;
+
+                    if (cpu->getFlagsValue() != expectedFlags || cpu->getRegValue(REG_A) != expectedA ||
+                        cpu->getPCValue() != expectedPC) {
+                        if (failures < 10) {
+                            printf("%s %s carry %d jump %02x  x %02x y %02x: flags %x ra %02x pc %04x, expected flags %x ra %02x pc %04x\n",
+                                pathName(path), spec.name, carry, JUMPS[jump], x, y, cpu->getFlagsValue(),
+                                cpu->getRegValue(REG_A), cpu->getPCValue(), expectedFlags, expectedA, expectedPC);
+                        }
+                        failures++;
+                    }
+                }
+            }
+        }
+
+        // any flags value, including ones no ALU op produces, survives a snapshot
+        for (size_t jump = 0; jump < 4; jump++) {
+            for (uint8_t flags = 0; flags < 0x10; flags++) {
+                uint16_t addr = LOADED_CASES + jump * 8;
+                uint16_t expectedPC = flags & (1 << JUMP_BITS[jump]) ? TAKEN : addr + 3;
+
+                state.pcReg = addr;
+                state.flagsReg = flags;
+
+                cpu->loadState(state);
+                runCase(*cpu, path, 1);
+                cases++;
+
+                if (cpu->getFlagsValue() != flags || cpu->getPCValue() != expectedPC ||
+                    cpu->saveState().flagsReg != flags) {
+                    if (failures < 10) {
+                        printf("%s loaded flags %x jump %02x: flags %x pc %04x\n", pathName(path), flags, JUMPS[jump],
+                            cpu->getFlagsValue(), cpu->getPCValue());
+                    }
+                    failures++;
+                }
+            }
+        }
+    }
+
+    // the individual flag tests, for every result an ALU op can leave behind
+    for (int add = 0; add <= 1; add++) {
+        for (int pair = 0; pair < 0x10000; pair++) {
+            uint8_t lastValue = pair >> 8;
+            uint8_t value = pair & 0xFF;
+            uint8_t expected = aluFlags(lastValue, value, add);
+
+            bjtcpu_lazy_flags flags;
+            flags.update(lastValue, value, add);
+            cases++;
+
+            if (flags.get() != expected || flags.zero() != (bool)FLAG_ZMASK(expected) ||
+                flags.negative() != (bool)FLAG_NMASK(expected) || flags.carry() != (bool)FLAG_CMASK(expected) ||
+                flags.overflow() != (bool)FLAG_OMASK(expected)) {
+                if (failures < 10) {
+                    printf("lazy flags last %02x value %02x add %d: %x, expected %x\n", lastValue, value, add, flags.get(), expected);
+                }
+                failures++;
+            }
+        }
+    }
+
+    printf("%llu cases, %llu failed\n", (unsigned long long)cases, (unsigned long long)failures);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+#include <chrono>
+
+#include "bjtcpu.hpp"
+#include "fileio.hpp"
+
+// fuzz target - the input bytes are a ROM, or with BJTCPU_FUZZ_ROM set, RAM
+// contents from address 0 under that fixed ROM. Each input runs under a cycle
+// budget and reports (PC, next PC) edges and invariant violations through the
+// core's fuzz monitor. Built with BJTCPU_LIBFUZZER this is a libFuzzer target,
+// otherwise main() replays inputs or generates random ones to measure exec/s.
+//
+// Environment, read once at startup:
+//   BJTCPU_FUZZ_ROM=FILE      fixed ROM, inputs seed RAM instead
+//   BJTCPU_FUZZ_CYCLES=N      cycle budget per input (default 100000)
+//   BJTCPU_FUZZ_ENGINE=E      interp (default) or block
+//   BJTCPU_FUZZ_ABORT=LIST    all, or comma separated violation names to abort
+//                             on, so the fuzzer keeps the input as a crash
+
+#if !BJTCPU_FUZZ
+#error "bjtcpu-fuzz needs the core built with BJTCPU_FUZZ"
+#endif
+
+#ifndef BJTCPU_LIBFUZZER
+#define BJTCPU_LIBFUZZER 0
+#endif
+
+// violations are checked between chunks, so a stuck loop ends the run early
+static constexpr uint64_t FUZZ_CHUNK_CYCLES = 4096;
+
+#if BJTCPU_LIBFUZZER && defined(__linux__)
+// picked up by libFuzzer as extra coverage counters
+__attribute__((used, section("__libfuzzer_extra_counters")))
+static uint8_t extraCounters[BJTCPU_FUZZ_EDGES];
+#endif
+
+// everything an input needs is allocated once, so a run is a reset, a copy
+// of the input and the emulation itself
+struct fuzz_context {
+    std::unique_ptr<bjtcpu> cpu;
+    std::shared_ptr<bjtcpu_rom_image> romImage;   // rewritten per input unless ramMode
+    bool ramMode = false;
+    uint64_t cycles = 100000;
+    uint32_t abortMask = 0;
+};
+
+static fuzz_context context;
+
+static uint32_t parseViolations(const std::string& list) {
+    if (list == "all") {
+        return ~0u;
+    }
+
+    uint32_t mask = 0;
+    size_t start = 0;
+
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+            end = list.size();
+        }
+
+        std::string name = list.substr(start, end - start);
+        for (uint32_t i = 1; i < (uint32_t)bjtcpu_fuzz_violation::COUNT; i++) {
+            if (name == fuzzViolationName((bjtcpu_fuzz_violation)i)) {
+                mask |= 1u << i;
+            }
+        }
+
+        start = end + 1;
+    }
+
+    return mask;
+}
+
+static bool initialise() {
+    context.cpu = std::make_unique<bjtcpu>();
+
+    if (const char* cycles = std::getenv("BJTCPU_FUZZ_CYCLES")) {
+        context.cycles = std::strtoull(cycles, nullptr, 0);
+    }
+
+    if (const char* engine = std::getenv("BJTCPU_FUZZ_ENGINE")) {
+        if (std::string(engine) == "block") {
+            context.cpu->setEngine(bjtcpu_engine::BLOCK);
+        } else if (std::string(engine) != "interp") {
+            fprintf(stderr, "Unknown engine \"%s\"\n", engine);
+            return false;
+        }
+    }
+
+    if (const char* abortList = std::getenv("BJTCPU_FUZZ_ABORT")) {
+        context.abortMask = parseViolations(abortList);
+    }
+
+    if (const char* romPath = std::getenv("BJTCPU_FUZZ_ROM")) {
+        std::shared_ptr<const bjtcpu_rom_image> rom = bjtcpu_rom_image::load(romPath);
+        if (!rom) {
+            fprintf(stderr, "Could not open ROM file \"%s\"\n", romPath);
+            return false;
+        }
+
+        context.cpu->setROM(rom);
+        context.ramMode = true;
+    } else {
+        context.romImage = bjtcpu_rom_image::create(nullptr, 0);
+    }
+
+    #if BJTCPU_LIBFUZZER && defined(__linux__)
+    context.cpu->getFuzzMonitor().setEdgeMap(extraCounters);
+    #endif
+
+    return true;
+}
+
+static bjtcpu_fuzz_violation runInput(const uint8_t* data, size_t size) {
+    bjtcpu& cpu = *context.cpu;
+    size = std::min<size_t>(size, 0x10000);
+
+    if (context.ramMode) {
+        cpu.reset();
+        cpu.loadRAM(0, data, size);
+    } else {
+        // the image is only rewritten once the CPU has let go of it
+        cpu.setROM(bjtcpu_rom_image::empty());
+        context.romImage->assign(data, size);
+        cpu.setROM(context.romImage);
+        cpu.reset();
+    }
+
+    const bjtcpu_fuzz_monitor& monitor = cpu.getFuzzMonitor();
+    uint64_t remaining = context.cycles;
+
+    while (remaining > 0 && !cpu.isStopped() && monitor.getViolation() == bjtcpu_fuzz_violation::NONE) {
+        remaining -= cpu.runCycles(std::min(remaining, FUZZ_CHUNK_CYCLES));
+    }
+
+    if (monitor.getViolationMask() & context.abortMask) {
+        fprintf(stderr, "bjtcpu-fuzz: %s at %04x after %llu cycles\n", fuzzViolationName(monitor.getViolation()),
+            monitor.getViolationAddr(), (unsigned long long)cpu.getCycleCount());
+        std::abort();
+    }
+
+    return monitor.getViolation();
+}
+
+#if BJTCPU_LIBFUZZER
+
+extern "C" int LLVMFuzzerInitialize(int*, char***) {
+    if (!initialise()) {
+        std::exit(1);
+    }
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    runInput(data, size);
+    return 0;
+}
+
+#else
+
+static void printUsage() {
+    printf("Usage: bjtcpu-fuzz [input]... [options]\n");
+    printf("  --random N    run N random inputs and report exec/s and coverage\n");
+    printf("  --max-len N   longest random input in bytes (default 4096)\n");
+    printf("  --seed N      random input seed (default 1)\n");
+    printf("See the top of tools/fuzz.cpp for the BJTCPU_FUZZ_* environment variables\n");
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> inputPaths;
+    uint64_t randomInputs = 0;
+    size_t maxLen = 4096;
+    uint64_t seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--random" && hasValue) {
+            randomInputs = std::strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--max-len" && hasValue) {
+            maxLen = std::max<size_t>(1, std::strtoull(argv[++i], nullptr, 0));
+        } else if (arg == "--seed" && hasValue) {
+            seed = std::strtoull(argv[++i], nullptr, 0);
+        } else if (arg[0] != '-') {
+            inputPaths.push_back(arg);
+        } else {
+            printf("Unknown argument \"%s\"\n", arg.c_str());
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (inputPaths.empty() && randomInputs == 0) {
+        printUsage();
+        return 1;
+    }
+
+    if (!initialise()) {
+        return 1;
+    }
+
+    for (const std::string& path : inputPaths) {
+        std::vector<uint8_t> input;
+        if (!readFile(path, input)) {
+            printf("Could not open input file \"%s\"\n", path.c_str());
+            return 1;
+        }
+
+        bjtcpu_fuzz_violation violation = runInput(input.data(), input.size());
+        printf("%s  %s at %04x  %llu cycles\n", path.c_str(), fuzzViolationName(violation),
+            context.cpu->getFuzzMonitor().getViolationAddr(), (unsigned long long)context.cpu->getCycleCount());
+    }
+
+    if (randomInputs > 0) {
+        std::mt19937_64 random(seed);
+        std::vector<uint8_t> input(maxLen);
+        std::vector<uint64_t> violations((size_t)bjtcpu_fuzz_violation::COUNT, 0);
+        uint64_t totalCycles = 0;
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (uint64_t i = 0; i < randomInputs; i++) {
+            size_t size = 1 + random() % maxLen;
+            for (size_t j = 0; j < size; j += 8) {
+                uint64_t bytes = random();
+                std::memcpy(&input[j], &bytes, std::min<size_t>(8, size - j));
+            }
+
+            violations[(size_t)runInput(input.data(), size)]++;
+            totalCycles += context.cpu->getCycleCount();
+        }
+
+        auto end = std::chrono::high_resolution_clock::now();
+        double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000000000.0;
+
+        const uint8_t* edges = context.cpu->getFuzzMonitor().getEdgeMap();
+        size_t edgesHit = 0;
+        for (size_t i = 0; i < BJTCPU_FUZZ_EDGES; i++) {
+            edgesHit += edges[i] != 0;
+        }
+
+        printf("%llu inputs  %.3f s  %.0f exec/s  %.1f MHz  %zu edges\n", (unsigned long long)randomInputs, seconds,
+            seconds > 0 ? randomInputs / seconds : 0.0, seconds > 0 ? totalCycles / seconds / 1000000.0 : 0.0, edgesHit);
+
+        for (size_t i = 0; i < violations.size(); i++) {
+            printf("  %-16s %llu\n", fuzzViolationName((bjtcpu_fuzz_violation)i), (unsigned long long)violations[i]);
+        }
+    }
+
+    return 0;
+}
+
+#endif
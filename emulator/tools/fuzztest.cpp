@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+#include <memory>
+
+#include "bjtcpu.hpp"
+
+// regression inputs for the fuzz monitor's invariant checks - each ROM runs
+// through the stepper, the interpreter and the block engine in chunks the
+// way bjtcpu-fuzz runs them, and must end with the expected violation
+
+#if !BJTCPU_FUZZ
+#error "bjtcpu-fuzztest needs the core built with BJTCPU_FUZZ"
+#endif
+
+static constexpr uint64_t MAX_CYCLES = 1000000;
+static constexpr uint64_t CHUNK_CYCLES = 4096;
+
+struct fuzz_case {
+    const char* name;
+    std::vector<uint8_t> rom;
+    uint8_t dmaByteCycles;
+    bjtcpu_fuzz_violation expected;
+};
+
+enum class fuzz_path { STEP, INTERPRETER, BLOCK };
+
+static const char* pathName(fuzz_path path) {
+    switch (path) {
+        case fuzz_path::STEP:
+            return "step";
+        case fuzz_path::INTERPRETER:
+            return "interp";
+        default:
+            return "block";
+    }
+}
+
+// start a 256 byte copy and poll rdma until it is idle - the registers and
+// flags repeat exactly while the transfer runs
+static const std::vector<uint8_t> DMA_WAIT = {
+    0xA7, 0x00,         // imm rdln 0x00
+    0xAC, 0x00,         // imm rdma 0x00
+    0xA2, 0x00,         // imm rc 0x00
+    0x12, 0xC2,         // .wait: cmp rdma rc
+    0xE1, 0x00, 0x0E,   // jmpz .end
+    0xE0, 0x00, 0x06,   // jmp .wait
+    0x00                // .end: stop
+};
+
+static const fuzz_case CASES[] = {
+    { "dma wait", DMA_WAIT, BJTCPU_DMA_BYTE_CYCLES, bjtcpu_fuzz_violation::NONE },
+    { "long dma wait", DMA_WAIT, 0xFF, bjtcpu_fuzz_violation::NONE },
+    { "jump to self", { 0xE0, 0x00, 0x00 }, BJTCPU_DMA_BYTE_CYCLES, bjtcpu_fuzz_violation::STUCK_LOOP },
+    { "counting loop", { 0xC0, 0x00, 0x01, 0xE0, 0x00, 0x00 }, BJTCPU_DMA_BYTE_CYCLES, bjtcpu_fuzz_violation::STUCK_LOOP },
+};
+
+int main() {
+    std::unique_ptr<bjtcpu> cpu = std::make_unique<bjtcpu>();
+    uint64_t cases = 0;
+    uint64_t failures = 0;
+
+    for (const fuzz_case& test : CASES) {
+        for (fuzz_path path : { fuzz_path::STEP, fuzz_path::INTERPRETER, fuzz_path::BLOCK }) {
+            cpu->loadROM(test.rom.data(), test.rom.size());
+            cpu->reset();
+            cpu->getDMA().setByteCycles(test.dmaByteCycles);
+            cpu->setEngine(path == fuzz_path::BLOCK ? bjtcpu_engine::BLOCK : bjtcpu_engine::INTERPRETER);
+
+            const bjtcpu_fuzz_monitor& monitor = cpu->getFuzzMonitor();
+
+            while (cpu->getCycleCount() < MAX_CYCLES && !cpu->isStopped() &&
+                monitor.getViolation() == bjtcpu_fuzz_violation::NONE) {
+                if (path == fuzz_path::STEP) {
+                    cpu->step();
+                } else {
+                    cpu->runCycles(CHUNK_CYCLES);
+                }
+            }
+
+            cases++;
+
+            // a case expected to pass must also get to its stop
+            bool stopped = test.expected != bjtcpu_fuzz_violation::NONE || cpu->isStopped();
+            if (monitor.getViolation() != test.expected || !stopped) {
+                printf("%s %s: %s at %04x after %llu cycles, expected %s\n", test.name, pathName(path),
+                    fuzzViolationName(monitor.getViolation()), monitor.getViolationAddr(),
+                    (unsigned long long)cpu->getCycleCount(), fuzzViolationName(test.expected));
+                failures++;
+            }
+        }
+    }
+
+    printf("%llu cases, %llu failed\n", (unsigned long long)cases, (unsigned long long)failures);
+
+    return failures == 0 ? 0 : 1;
+}
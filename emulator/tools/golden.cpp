@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <memory>
+
+#include "bjtcpu.hpp"
+#include "fileio.hpp"
+
+// golden-frame regression runner - runs each ROM headless under every engine,
+// records machine state at fixed cycle counts and compares it with checked-in
+// golden files (or rewrites them with --update)
+
+static constexpr uint64_t CHECKPOINTS[] = {10000, 100000, 1000000, 5000000};
+
+static const bjtcpu_engine ENGINES[] = {bjtcpu_engine::INTERPRETER, bjtcpu_engine::BLOCK};
+
+struct golden_job {
+    std::shared_ptr<const bjtcpu_rom_image> rom;
+    std::string name;
+    bjtcpu_engine engine;
+
+    std::string result;
+    bool ok = false;
+};
+
+static uint64_t fnv1a64(const uint8_t* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static const char* engineName(bjtcpu_engine engine) {
+    return engine == bjtcpu_engine::BLOCK ? "block" : "interp";
+}
+
+// one line per checkpoint: cycles, pc, instructions, registers, display and RAM hashes
+static std::string checkpointLine(bjtcpu& cpu) {
+    char buffer[256];
+    std::string line;
+
+    snprintf(buffer, sizeof(buffer), "cycles %llu pc %04x instrs %llu regs", (unsigned long long)cpu.getCycleCount(),
+        cpu.getPCValue(), (unsigned long long)cpu.getInstrCount());
+    line += buffer;
+
+    for (int i = 0; i < 0x10; i++) {
+        snprintf(buffer, sizeof(buffer), " %02x", cpu.getRegValue(i));
+        line += buffer;
+    }
+
+    std::vector<uint8_t> ram(0x10000);
+    for (int i = 0; i < 0x10000; i++) {
+        ram[i] = cpu.readRAM(i >> 8, i & 0xFF);
+    }
+
+    snprintf(buffer, sizeof(buffer), " fb %016llx ram %016llx%s\n",
+        (unsigned long long)fnv1a64(cpu.getDisplay().getPixels(), BJTCPU_DISPLAY_PIXELS / 2),
+        (unsigned long long)fnv1a64(ram.data(), ram.size()), cpu.isStopped() ? " stopped" : "");
+    line += buffer;
+
+    return line;
+}
+
+static void runJob(golden_job& job) {
+    if (!job.rom) {
+        job.result = "could not read ROM\n";
+        return;
+    }
+
+    bjtcpu cpu;
+    cpu.setROM(job.rom);
+    cpu.setEngine(job.engine);
+
+    job.result = "# " + job.name + "\n";
+    for (uint64_t checkpoint : CHECKPOINTS) {
+        cpu.runCycles(checkpoint - std::min(checkpoint, cpu.getCycleCount()));
+        job.result += checkpointLine(cpu);
+    }
+
+    job.ok = true;
+}
+
+static std::string romName(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+    return file.substr(0, file.find_last_of('.'));
+}
+
+static bool readText(const std::string& path, std::string& text) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    text = stream.str();
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string goldenDir;
+    std::vector<std::string> romPaths;
+    bool update = false;
+    unsigned jobCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--update") {
+            update = true;
+        } else if (arg == "--jobs" && i + 1 < argc) {
+            jobCount = std::max(1, atoi(argv[++i]));
+        } else if (goldenDir.empty()) {
+            goldenDir = arg;
+        } else {
+            romPaths.push_back(arg);
+        }
+    }
+
+    if (goldenDir.empty() || romPaths.empty()) {
+        printf("Usage: bjtcpu-golden <golden dir> <rom.bin>... [--update] [--jobs N]\n");
+        return 1;
+    }
+
+    std::vector<golden_job> jobs;
+    for (const std::string& path : romPaths) {
+        std::shared_ptr<const bjtcpu_rom_image> rom = bjtcpu_rom_image::load(path);
+
+        for (bjtcpu_engine engine : ENGINES) {
+            golden_job job;
+            job.rom = rom;
+            job.name = romName(path);
+            job.engine = engine;
+            jobs.push_back(job);
+        }
+    }
+
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < std::min<size_t>(jobCount, jobs.size()); i++) {
+        workers.emplace_back([&]() {
+            for (size_t index = next++; index < jobs.size(); index = next++) {
+                runJob(jobs[index]);
+            }
+        });
+    }
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    int failures = 0;
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const golden_job& job = jobs[i];
+        std::string goldenPath = goldenDir + "/" + job.name + ".golden";
+
+        if (!job.ok) {
+            printf("FAIL %s (%s): %s", job.name.c_str(), engineName(job.engine), job.result.c_str());
+            failures++;
+            continue;
+        }
+
+        // every engine must agree, the first one writes the golden file
+        if (update && job.engine == ENGINES[0]) {
+            if (!writeFile(goldenPath, job.result.data(), job.result.size())) {
+                printf("FAIL %s: could not write \"%s\"\n", job.name.c_str(), goldenPath.c_str());
+                failures++;
+            } else {
+                printf("updated %s\n", goldenPath.c_str());
+            }
+            continue;
+        }
+
+        std::string expected;
+        if (update) {
+            expected = jobs[i - 1].result;
+        } else if (!readText(goldenPath, expected)) {
+            printf("FAIL %s: no golden file \"%s\", run with --update\n", job.name.c_str(), goldenPath.c_str());
+            failures++;
+            continue;
+        }
+
+        if (job.result != expected) {
+            printf("FAIL %s (%s)\n--- expected\n%s--- got\n%s", job.name.c_str(), engineName(job.engine), expected.c_str(), job.result.c_str());
+            failures++;
+        } else if (!update) {
+            printf("ok   %s (%s)\n", job.name.c_str(), engineName(job.engine));
+        }
+    }
+
+    printf("%zu runs, %d failed\n", jobs.size(), failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <random>
+
+#include "bjtcpu.hpp"
+#include "fileio.hpp"
+#include "difftest.hpp"
+
+// differential check of the native stdlib routines - each routine is called
+// from a stub with random registers and RAM, once with HLE and once without,
+// under random cycle budgets on both engines. Registers, flags, PC, cycle and
+// instruction counts and all of RAM must come out the same
+
+static constexpr uint16_t STUB_ADDR = 0xFF00;
+static constexpr int CASES = 400;
+
+// a memcpy within the stack bank can overwrite its own count and never return
+static constexpr uint64_t MAX_CYCLES = 1000000;
+
+static uint8_t randomCount(std::mt19937& random) {
+    // mostly short runs, with the 0 (256 iterations) and wrap cases
+    switch (random() % 4) {
+        case 0:
+            return random() % 4;
+        case 1:
+            return 0xFC + random() % 4;
+        default:
+            return random();
+    }
+}
+
+static bjtcpu_state makeCase(bjtcpu& cpu, bjtcpu_hle_routine routine, std::mt19937& random) {
+    std::array<uint8_t, 0x10> regs = {};
+    regs[REG_A] = random();
+    regs[REG_B] = random();
+    regs[REG_C] = random();
+    regs[REG_ADDR] = random();
+    regs[REG_BNK] = random() % 4 == 0 ? 0xFF : random() % 8;
+    regs[REG_SP] = random() % 8 == 0 ? 0xFB + random() % 5 : random();
+    regs[REG_BP] = random();
+
+    switch (routine) {
+        case bjtcpu_hle_routine::MULTIPLY:
+        case bjtcpu_hle_routine::SHL:
+        case bjtcpu_hle_routine::SHLR:
+        case bjtcpu_hle_routine::SHR:
+        case bjtcpu_hle_routine::MEMSET:
+            regs[REG_B] = randomCount(random);
+            break;
+        case bjtcpu_hle_routine::MEMCPY:
+        case bjtcpu_hle_routine::MEMCMP:
+            regs[REG_A] = randomCount(random);
+            break;
+        default:
+            break;
+    }
+
+    cpu.reset();
+
+    std::vector<uint8_t> bank(0x100);
+    for (int b : { (int)regs[REG_BNK], 0xFF }) {
+        for (uint8_t& value : bank) {
+            value = random() % 4;
+        }
+        cpu.loadRAM(b << 8, bank.data(), bank.size());
+    }
+
+    // memcmp keeps going while the two ranges match
+    if (routine == bjtcpu_hle_routine::MEMCMP && random() % 2 == 0) {
+        for (int i = 0; i < 0x100; i++) {
+            uint8_t value = cpu.readRAM(regs[REG_BNK], regs[REG_ADDR] + i);
+            cpu.loadRAM((regs[REG_BNK] << 8) | (uint8_t)(regs[REG_B] + i), &value, 1);
+        }
+    }
+
+    bjtcpu_state state = cpu.saveState();
+    state.pcReg = STUB_ADDR;
+    state.regFile = regs;
+    state.flagsReg = random() & 0xF;
+
+    return state;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("Usage: bjtcpu-hletest <stdlib program.bin> <program.labels>\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> rom;
+    if (!readFile(argv[1], rom) || rom.size() > STUB_ADDR) {
+        printf("Could not open ROM file \"%s\" (or it reaches the stub at %04x)\n", argv[1], STUB_ADDR);
+        return 1;
+    }
+
+    bjtcpu_symbols symbols;
+    if (!symbols.load(argv[2])) {
+        printf("Could not open label file \"%s\"\n", argv[2]);
+        return 1;
+    }
+
+    rom.resize(0x10000, 0);
+
+    std::unique_ptr<bjtcpu> reference = std::make_unique<bjtcpu>();
+    std::unique_ptr<bjtcpu> native = std::make_unique<bjtcpu>();
+
+    size_t bound = 0;
+    std::mt19937 random(1);
+    uint64_t cases = 0;
+    uint64_t nativeRuns = 0;
+    uint64_t failures = 0;
+
+    for (size_t i = 1; i < (size_t)bjtcpu_hle_routine::COUNT; i++) {
+        bjtcpu_hle_routine routine = (bjtcpu_hle_routine)i;
+
+        uint16_t addr;
+        if (!symbols.find(hleRoutineName(routine), addr)) {
+            printf("%s: no label\n", hleRoutineName(routine));
+            return 1;
+        }
+
+        // call routine; stop
+        rom[STUB_ADDR] = OP_CALL;
+        rom[STUB_ADDR + 1] = addr >> 8;
+        rom[STUB_ADDR + 2] = addr & 0xFF;
+        rom[STUB_ADDR + 3] = OP_STOP;
+
+        std::shared_ptr<const bjtcpu_rom_image> image = bjtcpu_rom_image::create(rom.data(), rom.size());
+        reference->setROM(image);
+        native->setROM(image);
+
+        bound = native->enableHLE(symbols);
+
+        for (int c = 0; c < CASES; c++) {
+            bjtcpu_state state = makeCase(*reference, routine, random);
+            bjtcpu_engine engine = c % 2 ? bjtcpu_engine::BLOCK : bjtcpu_engine::INTERPRETER;
+
+            reference->resetTo(state);
+            native->resetTo(state);
+            reference->setEngine(engine);
+            native->setEngine(engine);
+
+            // a budget that runs out part way through the routine makes the
+            // native side fall back to the ROM code
+            bool failed = false;
+            while (!reference->isStopped() && reference->getCycleCount() < MAX_CYCLES && !failed) {
+                uint64_t budget = c % 4 < 2 ? MAX_CYCLES : 1 + random() % 400;
+                reference->runCycles(budget);
+                native->runCycles(budget);
+                failed = !sameState(*reference, *native);
+            }
+
+            nativeRuns += native->getHLECount(routine);
+            cases++;
+
+            if (failed) {
+                if (failures < 10) {
+                    printf("%s case %d %s: ra %02x rb %02x rc %02x radr %02x rbnk %02x rsp %02x rbp %02x, "
+                        "pc %04x/%04x cycles %llu/%llu\n", hleRoutineName(routine), c,
+                        engineName(engine), state.regFile[REG_A],
+                        state.regFile[REG_B], state.regFile[REG_C], state.regFile[REG_ADDR], state.regFile[REG_BNK],
+                        state.regFile[REG_SP], state.regFile[REG_BP], reference->getPCValue(),
+                        native->getPCValue(), (unsigned long long)reference->getCycleCount(),
+                        (unsigned long long)native->getCycleCount());
+                }
+                failures++;
+            }
+        }
+    }
+
+    printf("%zu routines bound, %llu cases, %llu run natively, %llu failed\n", bound, (unsigned long long)cases,
+        (unsigned long long)nativeRuns, (unsigned long long)failures);
+
+    #if BJTCPU_HLE
+    if (bound != (size_t)bjtcpu_hle_routine::COUNT - 1 || nativeRuns == 0) {
+        failures++;
+    }
+    #endif
+
+    return failures == 0 ? 0 : 1;
+}
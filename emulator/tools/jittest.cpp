@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <random>
+#include <algorithm>
+
+#include "bjtcpu.hpp"
+#include "difftest.hpp"
+
+// differential check of the block engine's native code - random programs of
+// every instruction a block body can hold, with conditional jumps to the next
+// instruction so FLAGS (and an addc or subc's carry) cross block ends, run by
+// step() alone and by run()/runCycles() on the block engine with random budgets.
+// A saved state of each CPU is held across most budgets, so stores and pushes
+// also hit banks still shared with it - the two must still agree afterwards,
+// and the zero bank must stay zero. Registers, PC, counts, FLAGS and all of
+// RAM must agree
+
+static constexpr int CASES = 1000;
+static constexpr uint64_t MAX_CYCLES = 20000;
+
+// the registers an address or the stack is built from, as well as ra to rc
+static uint8_t randomSource(std::mt19937& random) {
+    static constexpr uint8_t SOURCES[] = { REG_A, REG_B, REG_C, REG_SP, REG_BNK, REG_ADDR };
+    return SOURCES[random() % 6];
+}
+
+static uint8_t randomDest(std::mt19937& random) {
+    return random() % 8 == 0 ? randomSource(random) : randomReg(random);
+}
+
+static std::vector<uint8_t> buildProgram(std::mt19937& random) {
+    return buildLoopProgram(random, [&](std::vector<uint8_t>& rom, uint16_t& addr) {
+        uint8_t dest = randomDest(random);
+        uint8_t x = randomSource(random);
+        uint8_t y = randomSource(random);
+
+        switch (random() % 14) {
+            case 0:
+                emit(rom, addr, { OP_PUSH, (uint8_t)(x << 4) });
+                break;
+            case 1:
+                emit(rom, addr, { (uint8_t)(OP_POP | dest) });
+                break;
+            case 2:
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_BNK), (uint8_t)(random() % 2 ? random() % 4 : 0xFF) });
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_ADDR), (uint8_t)random() });
+                break;
+            case 3:
+                emit(rom, addr, { OP_STO, (uint8_t)(x << 4) });
+                break;
+            case 4:
+                emit(rom, addr, { OP_STRLA, (uint8_t)(x << 4 | y) });
+                break;
+            case 5:
+                emit(rom, addr, { (uint8_t)(OP_LDA | dest) });
+                break;
+            case 6:
+                emit(rom, addr, { (uint8_t)(OP_LDRL | dest), (uint8_t)(x << 4 | y) });
+                break;
+            case 7:
+                emit(rom, addr, { (uint8_t)(OP_PLDA | dest) });
+                break;
+            case 8: {
+                static constexpr uint8_t OPS[] = { OP_ADD, OP_ADDC, OP_SUB, OP_SUBC };
+                emit(rom, addr, { (uint8_t)(OPS[random() % 4] | dest), (uint8_t)(x << 4 | y) });
+                break;
+            }
+            case 9:
+                emit(rom, addr, { (uint8_t)((random() % 2 ? OP_IADD : OP_ISUB) | dest), (uint8_t)(x << 4),
+                    (uint8_t)random() });
+                break;
+            case 10:
+                emit(rom, addr, { OP_CMP, (uint8_t)(x << 4 | y) });
+                break;
+            case 11:
+                emit(rom, addr, { (uint8_t)(OP_NAND | dest), (uint8_t)(x << 4 | y) });
+                break;
+            case 12:
+                emit(rom, addr, { (uint8_t)(OP_IMM | dest), (uint8_t)random() });
+                break;
+            default: {
+                static constexpr uint8_t JUMPS[] = { OP_JMPZ, OP_JMPN, OP_JMPC, OP_JMPO };
+                emitJump(rom, addr, JUMPS[random() % 4], addr + 3);
+                break;
+            }
+        }
+    });
+}
+
+int main() {
+    std::unique_ptr<bjtcpu> reference = std::make_unique<bjtcpu>();
+    std::unique_ptr<bjtcpu> fast = std::make_unique<bjtcpu>();
+
+    std::mt19937 random(1);
+    uint64_t failures = 0;
+
+    for (int c = 0; c < CASES; c++) {
+        std::vector<uint8_t> rom = buildProgram(random);
+
+        std::shared_ptr<const bjtcpu_rom_image> image = bjtcpu_rom_image::create(rom.data(), rom.size());
+        for (bjtcpu* cpu : { reference.get(), fast.get() }) {
+            cpu->setROM(image);
+            cpu->reset();
+        }
+
+        fast->setEngine(bjtcpu_engine::BLOCK);
+        bool byInstrs = c % 2;
+        bool failed = false;
+
+        while (reference->getCycleCount() < MAX_CYCLES && !reference->isStopped() && !failed) {
+            uint64_t budget = random() % 3 == 0 ? 1 + random() % 8 : 1 + random() % 600;
+
+            bool holding = random() % 4 != 0;
+            bjtcpu_state heldReference;
+            bjtcpu_state heldFast;
+            if (holding) {
+                heldReference = reference->saveState();
+                heldFast = fast->saveState();
+            }
+
+            runBudget(*reference, *fast, byInstrs, budget, [&]() { reference->step(); });
+
+            // writing a held bank in place would show in its saved state
+            failed = !sameState(*reference, *fast) || (holding && !sameRAM(heldReference, heldFast));
+        }
+
+        const bjtcpu_ram_bank& zero = *bjtcpu_ram::zeroBank();
+        failed |= std::any_of(zero.begin(), zero.end(), [](uint8_t byte) { return byte != 0; });
+
+        if (failed) {
+            if (failures < 10) {
+                printf("case %d %s: pc %04x/%04x cycles %llu/%llu flags %x/%x\n", c, byInstrs ? "run" : "runCycles",
+                    reference->getPCValue(), fast->getPCValue(), (unsigned long long)reference->getCycleCount(),
+                    (unsigned long long)fast->getCycleCount(), reference->getFlagsValue(), fast->getFlagsValue());
+            }
+            failures++;
+        }
+    }
+
+    printf("%d cases, %llu failed\n", CASES, (unsigned long long)failures);
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+#include <stdio.h>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+
+#include "bjtcpu.hpp"
+#include "dump.hpp"
+
+// headless batch runner - runs a ROM as fast as the host allows, with no window
+
+static void printUsage() {
+    printf("Usage: bjtcpu-run <rom.bin> [options]\n");
+    printf("  --cycles N    stop after N cycles\n");
+    printf("  --instrs N    stop after N instructions retired\n");
+    printf("  --engine E    execution engine: interp (default) or block\n");
+    printf("  --regs FILE   dump final registers as text\n");
+    printf("  --ram FILE    dump final RAM (64 KiB raw)\n");
+    printf("  --load-state FILE  resume from a saved machine state\n");
+    printf("  --save-state FILE  save the final machine state\n");
+    printf("  --labels FILE label map from the assembler\n");
+    #if BJTCPU_HLE
+    printf("  --hle         run the stdlib routines in --labels natively\n");
+    #endif
+    #if BJTCPU_EXT_DISPLAY
+    printf("  --fb FILE     dump final framebuffer (PPM)\n");
+    #endif
+    #if BJTCPU_TRACE_LEVEL > BJTCPU_TRACE_NONE
+    printf("  --trace FILE  dump the trace ring (decode with bjtcpu-tracedump)\n");
+    #endif
+    #if BJTCPU_PROFILE
+    printf("  --histogram FILE  per-address executions and cycles (CSV)\n");
+    printf("  --folded FILE     folded call stacks with cycles, for flamegraph tools\n");
+    #endif
+    #if BJTCPU_MEMSTATS
+    printf("  --memstats-csv FILE  per-bank RAM reads and writes (CSV)\n");
+    printf("  --memstats-bin FILE  per-address RAM counters (binary)\n");
+    #endif
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    std::string romPath;
+    uint64_t maxCycles = UINT64_MAX;
+    uint64_t maxInstrs = UINT64_MAX;
+    bjtcpu_engine engine = bjtcpu_engine::INTERPRETER;
+    std::string regsPath;
+    std::string ramPath;
+    std::string loadStatePath;
+    std::string saveStatePath;
+    std::string fbPath;
+    std::string tracePath;
+    std::string labelsPath;
+    std::string histogramPath;
+    std::string foldedPath;
+    std::string memstatsCSVPath;
+    std::string memstatsBinPath;
+    bool hle = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (arg == "--cycles" && hasValue) {
+            maxCycles = std::strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--instrs" && hasValue) {
+            maxInstrs = std::strtoull(argv[++i], nullptr, 0);
+        } else if (arg == "--engine" && hasValue) {
+            std::string name = argv[++i];
+            if (name == "interp") {
+                engine = bjtcpu_engine::INTERPRETER;
+            } else if (name == "block") {
+                engine = bjtcpu_engine::BLOCK;
+            } else {
+                printf("Unknown engine \"%s\"\n", name.c_str());
+                return 1;
+            }
+        } else if (arg == "--regs" && hasValue) {
+            regsPath = argv[++i];
+        } else if (arg == "--ram" && hasValue) {
+            ramPath = argv[++i];
+        } else if (arg == "--load-state" && hasValue) {
+            loadStatePath = argv[++i];
+        } else if (arg == "--save-state" && hasValue) {
+            saveStatePath = argv[++i];
+        } else if (arg == "--fb" && hasValue) {
+            fbPath = argv[++i];
+        } else if (arg == "--trace" && hasValue) {
+            tracePath = argv[++i];
+        } else if (arg == "--labels" && hasValue) {
+            labelsPath = argv[++i];
+        } else if (arg == "--hle") {
+            hle = true;
+        } else if (arg == "--histogram" && hasValue) {
+            histogramPath = argv[++i];
+        } else if (arg == "--folded" && hasValue) {
+            foldedPath = argv[++i];
+        } else if (arg == "--memstats-csv" && hasValue) {
+            memstatsCSVPath = argv[++i];
+        } else if (arg == "--memstats-bin" && hasValue) {
+            memstatsBinPath = argv[++i];
+        } else if (romPath.empty() && arg[0] != '-') {
+            romPath = arg;
+        } else {
+            printf("Unknown argument \"%s\"\n", arg.c_str());
+            printUsage();
+            return 1;
+        }
+    }
+
+    std::shared_ptr<const bjtcpu_rom_image> rom = bjtcpu_rom_image::load(romPath);
+    if (romPath.empty() || !rom) {
+        printf("Could not open ROM file \"%s\" (or it is larger than 64 KiB)\n", romPath.c_str());
+        return 1;
+    }
+
+    bjtcpu_symbols symbols;
+    if (!labelsPath.empty() && !symbols.load(labelsPath)) {
+        printf("Could not open label file \"%s\"\n", labelsPath.c_str());
+        return 1;
+    }
+
+    if (hle && labelsPath.empty()) {
+        printf("--hle needs the label map (--labels)\n");
+        return 1;
+    }
+
+    bjtcpu cpu;
+    cpu.setROM(rom);
+    cpu.setEngine(engine);
+
+    if (hle) {
+        printf("Native routines       %zu\n", cpu.enableHLE(symbols));
+    }
+
+    if (!loadStatePath.empty()) {
+        bjtcpu_state state;
+        if (!readState(loadStatePath, state)) {
+            printf("Could not read state file \"%s\"\n", loadStatePath.c_str());
+            return 1;
+        }
+
+        if (!cpu.loadState(state)) {
+            printf("State file \"%s\" was saved with a different ROM\n", loadStatePath.c_str());
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    cpu.run(maxInstrs, maxCycles);
+
+    auto end = std::chrono::high_resolution_clock::now();
+    double seconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1000000000.0;
+
+    printf("%s after %llu cycles\n", cpu.isStopped() ? "Stopped" : "Budget reached", (unsigned long long)cpu.getCycleCount());
+    printf("Instructions retired  %llu\n", (unsigned long long)cpu.getInstrCount());
+    printf("Wall time             %.6f s\n", seconds);
+    printf("Effective speed       %.3f MHz\n", seconds > 0 ? cpu.getCycleCount() / seconds / 1000000.0 : 0.0);
+
+    #if BJTCPU_FUSION
+    for (size_t i = 1; i < (size_t)bjtcpu_fusion::COUNT; i++) {
+        bjtcpu_fusion fusion = (bjtcpu_fusion)i;
+        printf("Fused %-16s%llu\n", fusionInfo(fusion).name, (unsigned long long)cpu.getFusionCount(fusion));
+    }
+    #endif
+
+    #if BJTCPU_HLE
+    if (hle) {
+        for (size_t i = 1; i < (size_t)bjtcpu_hle_routine::COUNT; i++) {
+            bjtcpu_hle_routine routine = (bjtcpu_hle_routine)i;
+            printf("Native %-15s%llu\n", hleRoutineName(routine), (unsigned long long)cpu.getHLECount(routine));
+        }
+    }
+    #endif
+
+    #if BJTCPU_MEMSTATS
+    const bjtcpu_memstats& memstats = cpu.getMemStats();
+    printf("Peak stack pointer    %02x\n", memstats.getPeakSP());
+    printf("Peak call depth       %u\n", memstats.getPeakCallDepth());
+    printf("Bank switches         %llu\n", (unsigned long long)memstats.getBankSwitches());
+
+    if (!memstatsCSVPath.empty() && !memstats.writeCSV(memstatsCSVPath)) {
+        printf("Could not write memory stats to \"%s\"\n", memstatsCSVPath.c_str());
+        return 1;
+    }
+
+    if (!memstatsBinPath.empty() && !memstats.writeBinary(memstatsBinPath)) {
+        printf("Could not write memory stats to \"%s\"\n", memstatsBinPath.c_str());
+        return 1;
+    }
+    #endif
+
+    if (!regsPath.empty()) {
+        std::array<uint8_t, 3> instrReg;
+        std::array<uint8_t, 0x10> regFile;
+
+        for (int i = 0; i < 3; i++) {
+            instrReg[i] = cpu.getIRValue(i);
+        }
+        for (int i = 0; i < 0x10; i++) {
+            regFile[i] = cpu.getRegValue(i);
+        }
+
+        if (!dumpRegs(regsPath, cpu.getPCValue(), instrReg.data(), regFile.data(), cpu.getCycleCount(), cpu.getInstrCount())) {
+            printf("Could not write registers to \"%s\"\n", regsPath.c_str());
+            return 1;
+        }
+    }
+
+    if (!ramPath.empty()) {
+        std::vector<uint8_t> ram(0x10000);
+        for (int i = 0; i < 0x10000; i++) {
+            ram[i] = cpu.readRAM(i >> 8, i & 0xFF);
+        }
+
+        if (!dumpRAM(ramPath, ram.data())) {
+            printf("Could not write RAM to \"%s\"\n", ramPath.c_str());
+            return 1;
+        }
+    }
+
+    if (!saveStatePath.empty() && !writeState(saveStatePath, cpu.saveState())) {
+        printf("Could not write state to \"%s\"\n", saveStatePath.c_str());
+        return 1;
+    }
+
+    #if BJTCPU_EXT_DISPLAY
+    if (!fbPath.empty() && !dumpFramebuffer(fbPath, cpu.getDisplay().getPixels(), greyscalePalette())) {
+        printf("Could not write framebuffer to \"%s\"\n", fbPath.c_str());
+        return 1;
+    }
+    #endif
+
+    #if BJTCPU_TRACE_LEVEL > BJTCPU_TRACE_NONE
+    if (!tracePath.empty() && !cpu.getTrace().dump(tracePath)) {
+        printf("Could not write trace to \"%s\"\n", tracePath.c_str());
+        return 1;
+    }
+    #endif
+
+    #if BJTCPU_PROFILE
+    if (!histogramPath.empty() && !cpu.getProfiler().writeHistogram(histogramPath, symbols)) {
+        printf("Could not write histogram to \"%s\"\n", histogramPath.c_str());
+        return 1;
+    }
+
+    if (!foldedPath.empty() && !cpu.getProfiler().writeFolded(foldedPath, symbols)) {
+        printf("Could not write folded stacks to \"%s\"\n", foldedPath.c_str());
+        return 1;
+    }
+    #endif
+
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <random>
+
+#include "bjtcpu.hpp"
+#include "difftest.hpp"
+
+// differential check of the spin loop fast-forward - random loops of register
+// only code, counted delays, polls of a register that never changes and jumps
+// to themselves, each run by run()/runCycles() on both engines under random
+// budgets and by step() alone. Registers, flags, PC and the counts must agree
+
+static constexpr uint16_t EXIT_ADDR = 0xF000;
+static constexpr int CASES = 4000;
+static constexpr uint64_t MAX_CYCLES = 20000;
+
+// ra to rc and radr, never rdis
+static uint8_t randomLoopReg(std::mt19937& random) {
+    static const uint8_t REGS[4] = { REG_A, REG_B, REG_C, REG_ADDR };
+    return REGS[random() % 4];
+}
+
+static void emitFiller(std::vector<uint8_t>& rom, uint16_t& addr, std::mt19937& random) {
+    uint8_t dest = randomLoopReg(random);
+    uint8_t srcX = randomLoopReg(random);
+    uint8_t srcY = randomLoopReg(random);
+
+    switch (random() % 6) {
+        case 0:
+            emit(rom, addr, { 0x03 });
+            break;
+        case 1:
+            emit(rom, addr, { (uint8_t)(OP_IMM | dest), (uint8_t)random() });
+            break;
+        case 2:
+            emit(rom, addr, { (uint8_t)(OP_NAND | dest), (uint8_t)(srcX << 4 | srcY) });
+            break;
+        case 3:
+            emit(rom, addr, { (uint8_t)(OP_ADD | dest), (uint8_t)(srcX << 4 | srcY) });
+            break;
+        case 4:
+            emit(rom, addr, { (uint8_t)(OP_SUB | dest), (uint8_t)(srcX << 4 | srcY) });
+            break;
+        default:
+            emit(rom, addr, { OP_CMP, (uint8_t)(srcX << 4 | srcY) });
+            break;
+    }
+}
+
+static uint8_t randomCondition(std::mt19937& random) {
+    static const uint8_t JUMPS[4] = { OP_JMPZ, OP_JMPN, OP_JMPC, OP_JMPO };
+    return JUMPS[random() % 4];
+}
+
+// a loop at head, leaving to EXIT_ADDR or falling through to a stop
+static void buildLoop(std::vector<uint8_t>& rom, uint16_t head, std::mt19937& random) {
+    uint16_t addr = head;
+    uint8_t counter = randomLoopReg(random);
+
+    switch (random() % 4) {
+        case 0:
+            // jmp head
+            emitJump(rom, addr, OP_JMP, head);
+            break;
+        case 1: {
+            // counted: step the counter, compare, leave or go round
+            uint8_t step = random() % 4 == 0 ? random() : 1 + random() % 3;
+            emit(rom, addr, { (uint8_t)((random() % 2 ? OP_IADD : OP_ISUB) | counter), (uint8_t)(counter << 4), step });
+
+            for (int i = random() % 3; i > 0; i--) {
+                emit(rom, addr, { 0x03 });
+            }
+
+            emit(rom, addr, { OP_CMP, (uint8_t)(counter << 4 | randomLoopReg(random)) });
+            if (random() % 2) {
+                emitJump(rom, addr, randomCondition(random), EXIT_ADDR);
+                emitJump(rom, addr, OP_JMP, head);
+            } else {
+                emitJump(rom, addr, randomCondition(random), head);
+            }
+            break;
+        }
+        case 2: {
+            // poll a register nothing in the loop writes
+            emit(rom, addr, { OP_CMP, (uint8_t)(randomLoopReg(random) << 4 | randomLoopReg(random)) });
+            emitJump(rom, addr, randomCondition(random), head);
+            break;
+        }
+        default: {
+            // anything, which the analysis may well turn down
+            for (int i = random() % 6; i >= 0; i--) {
+                if (random() % 4 == 0) {
+                    uint8_t reg = randomLoopReg(random);
+                    emit(rom, addr, { (uint8_t)((random() % 2 ? OP_IADD : OP_ISUB) | reg), (uint8_t)(reg << 4),
+                        (uint8_t)random() });
+                } else if (random() % 8 == 0) {
+                    emitJump(rom, addr, randomCondition(random), EXIT_ADDR);
+                } else {
+                    emitFiller(rom, addr, random);
+                }
+            }
+            emitJump(rom, addr, random() % 2 ? OP_JMP : randomCondition(random), head);
+            break;
+        }
+    }
+
+    rom[addr] = OP_STOP;
+}
+
+int main() {
+    std::unique_ptr<bjtcpu> reference = std::make_unique<bjtcpu>();
+    std::unique_ptr<bjtcpu> fast = std::make_unique<bjtcpu>();
+
+    std::mt19937 random(1);
+    uint64_t spins = 0;
+    uint64_t failures = 0;
+
+    for (int c = 0; c < CASES; c++) {
+        std::vector<uint8_t> rom(0x10000, OP_STOP);
+        uint16_t head = 0x100 + random() % 0x1000;
+        buildLoop(rom, head, random);
+
+        std::shared_ptr<const bjtcpu_rom_image> image = bjtcpu_rom_image::create(rom.data(), rom.size());
+        reference->setROM(image);
+        fast->setROM(image);
+        reference->reset();
+
+        bjtcpu_state state = reference->saveState();
+        state.pcReg = head;
+        for (uint8_t reg : { REG_A, REG_B, REG_C, REG_ADDR }) {
+            state.regFile[reg] = random();
+        }
+        state.flagsReg = random() & 0xF;
+
+        bjtcpu_engine engine = c % 2 ? bjtcpu_engine::BLOCK : bjtcpu_engine::INTERPRETER;
+        bool byInstrs = c % 4 >= 2;
+
+        reference->resetTo(state);
+        fast->resetTo(state);
+        fast->setEngine(engine);
+
+        bool failed = false;
+        while (!reference->isStopped() && reference->getCycleCount() < MAX_CYCLES && !failed) {
+            uint64_t budget = random() % 3 == 0 ? 1 + random() % 40 : 1 + random() % 4000;
+
+            runBudget(*reference, *fast, byInstrs, budget, [&]() { reference->step(); });
+
+            failed = !sameState(*reference, *fast);
+        }
+
+        spins += fast->getFusionCount(bjtcpu_fusion::SPIN_LOOP);
+
+        if (failed) {
+            if (failures < 10) {
+                printf("case %d %s %s: head %04x ra %02x rb %02x rc %02x radr %02x flags %x, "
+                    "pc %04x/%04x cycles %llu/%llu\n", c, engineName(engine),
+                    byInstrs ? "run" : "runCycles", head, state.regFile[REG_A], state.regFile[REG_B],
+                    state.regFile[REG_C], state.regFile[REG_ADDR], state.flagsReg, reference->getPCValue(),
+                    fast->getPCValue(), (unsigned long long)reference->getCycleCount(),
+                    (unsigned long long)fast->getCycleCount());
+            }
+            failures++;
+        }
+    }
+
+    printf("%d cases, %llu loops skipped, %llu failed\n", CASES, (unsigned long long)spins,
+        (unsigned long long)failures);
+
+    #if BJTCPU_FUSION
+    if (spins == 0) {
+        failures++;
+    }
+    #endif
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <random>
+
+#include "bjtcpu.hpp"
+#include "difftest.hpp"
+
+// differential check of the timer waits - random programs that write rtim
+// between ordinary instructions run under random frame and tick periods, by
+// step() alone and by run()/runCycles() on both engines with random budgets,
+// hopping to a CPU restored from a saved state part way through. Registers,
+// PC, counts and the cycles left waiting must agree, and every wait must end
+// on a vsync or tick boundary
+
+static constexpr int CASES = 600;
+static constexpr uint64_t MAX_CYCLES = 30000;
+
+// a wait every few instructions
+static std::vector<uint8_t> buildProgram(std::mt19937& random) {
+    return buildLoopProgram(random, [&](std::vector<uint8_t>& rom, uint16_t& addr) {
+        uint8_t dest = randomReg(random);
+        uint8_t src = randomReg(random);
+        uint8_t ticks = random() % 3 == 0 ? 0 : 1 + random() % 6;
+
+        switch (random() % 8) {
+            case 0:
+                emit(rom, addr, { (uint8_t)(OP_IMM | REG_TIM), ticks });
+                break;
+            case 1:
+                emit(rom, addr, { (uint8_t)(OP_IMM | src), ticks });
+                emit(rom, addr, { OP_PUSH, (uint8_t)(src << 4) });
+                emit(rom, addr, { (uint8_t)(OP_POP | REG_TIM) });
+                break;
+            case 2:
+                emit(rom, addr, { (uint8_t)(OP_IADD | REG_TIM), (uint8_t)(src << 4), ticks });
+                break;
+            case 3:
+                emit(rom, addr, { (uint8_t)(OP_IMM | dest), (uint8_t)random() });
+                break;
+            case 4:
+                emit(rom, addr, { (uint8_t)(OP_ADD | dest), (uint8_t)(src << 4 | randomReg(random)) });
+                break;
+            case 5:
+                emit(rom, addr, { (uint8_t)(OP_NAND | dest), (uint8_t)(src << 4 | randomReg(random)) });
+                break;
+            case 6:
+                emit(rom, addr, { OP_PUSH, (uint8_t)(src << 4) });
+                emit(rom, addr, { (uint8_t)(OP_POP | dest) });
+                break;
+            default:
+                emit(rom, addr, { (uint8_t)(OP_ISUB | dest), (uint8_t)(dest << 4), 1 });
+                break;
+        }
+    });
+}
+
+static void setPeriods(bjtcpu& cpu, uint16_t frame, uint16_t tick) {
+    cpu.getTimer().setFramePeriod(frame);
+    cpu.getTimer().setTickPeriod(tick);
+}
+
+int main() {
+    std::unique_ptr<bjtcpu> reference = std::make_unique<bjtcpu>();
+    std::unique_ptr<bjtcpu> fast = std::make_unique<bjtcpu>();
+    std::unique_ptr<bjtcpu> restored = std::make_unique<bjtcpu>();
+
+    std::mt19937 random(1);
+    uint64_t waits = 0;
+    uint64_t failures = 0;
+
+    for (int c = 0; c < CASES; c++) {
+        std::vector<uint8_t> rom = buildProgram(random);
+        uint16_t frame = 1 + random() % 400;
+        uint16_t tick = 1 + random() % 40;
+
+        std::shared_ptr<const bjtcpu_rom_image> image = bjtcpu_rom_image::create(rom.data(), rom.size());
+        for (bjtcpu* cpu : { reference.get(), fast.get(), restored.get() }) {
+            cpu->setROM(image);
+            cpu->reset();
+            setPeriods(*cpu, frame, tick);
+        }
+
+        bjtcpu_engine engine = c % 2 ? bjtcpu_engine::BLOCK : bjtcpu_engine::INTERPRETER;
+        bool byInstrs = c % 4 >= 2;
+        fast->setEngine(engine);
+        restored->setEngine(engine);
+
+        bool failed = false;
+        bool wasWaiting = false;
+        const char* reason = "";
+
+        while (reference->getCycleCount() < MAX_CYCLES && !failed) {
+            uint64_t budget = random() % 3 == 0 ? 1 + random() % 8 : 1 + random() % 600;
+
+            auto stepReference = [&]() {
+                reference->step();
+
+                if (reference->isWaiting() && !wasWaiting) {
+                    uint64_t wake = reference->getCycleCount() + reference->getWaitCycles();
+                    if (wake % frame != 0 && wake % tick != 0) {
+                        failed = true;
+                        reason = "wait ends off a boundary";
+                    }
+                    waits++;
+                }
+                wasWaiting = reference->isWaiting();
+            };
+
+            runBudget(*reference, *fast, byInstrs, budget, stepReference);
+
+            if (!sameState(*reference, *fast)) {
+                failed = true;
+                reason = "state differs";
+            }
+
+            // carry on from a copy, which must pick up any wait in progress
+            if (random() % 4 == 0) {
+                restored->loadState(fast->saveState());
+                std::swap(fast, restored);
+            }
+        }
+
+        if (failed) {
+            if (failures < 10) {
+                printf("case %d %s %s frame %u tick %u: %s, pc %04x/%04x cycles %llu/%llu waiting %llu/%llu\n", c,
+                    engineName(engine), byInstrs ? "run" : "runCycles", frame, tick,
+                    reason, reference->getPCValue(), fast->getPCValue(),
+                    (unsigned long long)reference->getCycleCount(), (unsigned long long)fast->getCycleCount(),
+                    (unsigned long long)reference->getWaitCycles(), (unsigned long long)fast->getWaitCycles());
+            }
+            failures++;
+        }
+    }
+
+    printf("%d cases, %llu waits, %llu failed\n", CASES, (unsigned long long)waits, (unsigned long long)failures);
+
+    if (waits == 0) {
+        failures++;
+    }
+
+    return failures == 0 ? 0 : 1;
+}
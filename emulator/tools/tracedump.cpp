@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "trace.hpp"
+#include "decode.hpp"
+#include "symbols.hpp"
+#include "fileio.hpp"
+
+// decodes a binary trace dump (bjtcpu-run --trace) to text
+
+static const char* eventName(bjtcpu_trace_event event) {
+    switch (event) {
+        case bjtcpu_trace_event::FETCH:     return "fetch";
+        case bjtcpu_trace_event::EXEC:      return "exec";
+        case bjtcpu_trace_event::RAM_WRITE: return "ramw";
+        case bjtcpu_trace_event::DISPLAY:   return "dis";
+        case bjtcpu_trace_event::CALL:      return "call";
+        case bjtcpu_trace_event::RET:       return "ret";
+        case bjtcpu_trace_event::WAIT:      return "wait";
+        case bjtcpu_trace_event::DMA:       return "dma";
+    }
+
+    return "?";
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: bjtcpu-tracedump <trace.bin> [rom.labels]\n");
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    if (!readFile(argv[1], data) || data.size() < sizeof(bjtcpu_trace_header)) {
+        printf("Could not read trace file \"%s\"\n", argv[1]);
+        return 1;
+    }
+
+    bjtcpu_trace_header header;
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, "BJTT", 4) != 0 || header.version != BJTCPU_TRACE_VERSION) {
+        printf("\"%s\" is not a version %u trace file\n", argv[1], BJTCPU_TRACE_VERSION);
+        return 1;
+    }
+
+    if (data.size() < sizeof(header) + header.count * sizeof(bjtcpu_trace_record)) {
+        printf("Trace file \"%s\" is truncated\n", argv[1]);
+        return 1;
+    }
+
+    bjtcpu_symbols symbols;
+    bool haveSymbols = argc > 2 && symbols.load(argv[2]);
+
+    for (uint64_t i = 0; i < header.count; i++) {
+        bjtcpu_trace_record rec;
+        std::memcpy(&rec, data.data() + sizeof(header) + i * sizeof(rec), sizeof(rec));
+
+        printf("%12llu  %04x  %-5s", (unsigned long long)rec.cycle, rec.pc, eventName(rec.event));
+
+        switch (rec.event) {
+            case bjtcpu_trace_event::FETCH:
+                printf("  byte %d = %02x", rec.b, rec.a);
+                break;
+            case bjtcpu_trace_event::EXEC:
+                printf("  op %d  %04x", rec.a, rec.b);
+                break;
+            case bjtcpu_trace_event::RAM_WRITE:
+                printf("  [%02x:%02x] = %02x", rec.b >> 8, rec.b & 0xFF, rec.a);
+                break;
+            case bjtcpu_trace_event::DISPLAY:
+                printf("  %02x", rec.a);
+                break;
+            case bjtcpu_trace_event::WAIT:
+                printf("  %02x  %u cycles", rec.a, rec.b);
+                break;
+            case bjtcpu_trace_event::DMA:
+                printf("  %02x  %u bytes", rec.a, rec.b);
+                break;
+            case bjtcpu_trace_event::CALL:
+            case bjtcpu_trace_event::RET:
+                printf("  -> %04x", rec.b);
+                if (haveSymbols) {
+                    printf(" (%s)", symbols.functionName(rec.b).c_str());
+                }
+                break;
+        }
+
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -87,6 +87,8 @@ main:
     strla   rbp     rc              ; store updated ball y vel
 
 
+    call    stdv_wait_frame         ; one ball step per frame
+
     imm     rdis    0x01            ; clear display
 
     imm     ra      0x00
@@ -0,0 +1,45 @@
+    ; block copies and fills through the DMA versions of std_memcpy/std_memset
+
+#define STDLIB_DMA 1
+
+#include "stdlib/stdlib.asm"
+
+#define BUFFER_BANK 0x01
+#define FILL_BANK 0x02
+#define COPY_BANK 0x03
+
+
+main:
+    imm     rc      0x00            ; pass count
+
+.loop:
+    imm     rbnk    BUFFER_BANK
+    imm     radr    0x00
+    sto     rc                      ; newest byte at the front
+
+    imm     ra      0x7F
+    imm     rb      0x01
+    call    std_memcpy              ; overlapping, shifts the buffer up a byte
+
+    cpy     ra      rc
+    imm     rb      0x00            ; 256 bytes
+    imm     rbnk    FILL_BANK
+    call    std_memset
+
+    ; the back of the buffer into the top of another bank, wrapping round
+    imm     rdsb    BUFFER_BANK
+    imm     rdsa    0x40
+    imm     rddb    COPY_BANK
+    cpy     rdda    rc
+    imm     rdln    0x40
+    imm     rdma    0x00
+
+    imm     ra      0x00
+.wait:
+    cmp     rdma    ra
+    jmpz    .next
+    jmp     .wait
+
+.next:
+    iadd    rc      rc      0x01
+    jmp     .loop
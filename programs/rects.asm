@@ -0,0 +1,83 @@
+    ; filled shapes through the bulk display signals
+
+#include "stdlib/stdlib.asm"
+#include "stdlib/stdvideo.asm"
+
+#define BACKGROUND 0x01
+#define BOX_COLOUR 0x0A
+#define BOX_TOP 0x08
+#define BOX_BOTTOM 0x18
+#define LINE_Y 0x28
+
+
+main:
+    imm     rbnk    0xFF
+
+    imm     ra      0x00
+    push    ra                      ; frame count (rbp + 0)
+
+.loop:
+    call    stdv_wait_frame
+
+    imm     ra      BACKGROUND
+    call    stdv_clear
+
+
+    imm     ra      BOX_BOTTOM
+    push    ra                      ; y1
+    imm     ra      BOX_COLOUR
+    push    ra                      ; colour
+
+    imm     ra      0x00
+    ldrl    ra      rbp     ra      ; load frame count
+
+    imm     rc      0x1F
+    nand    ra      ra      rc
+    nand    ra      ra      ra      ; x0 = frame count & 0x1F
+
+    iadd    rc      ra      0x10    ; x1 = x0 + 16
+    imm     rb      BOX_TOP
+
+    call    stdv_fill_rect          ; box sliding to the right
+
+    pop     rc
+    pop     rc
+
+
+    imm     ra      0x0F
+    push    ra                      ; colour
+
+    imm     ra      0x00
+    imm     rb      0x3F
+    imm     rc      LINE_Y
+
+    call    stdv_hline              ; full width line
+
+    pop     rc
+
+
+    imm     rdis    0x40            ; cursor to (0, 50)
+    imm     rdis    0xB2
+    imm     rdis    0x03            ; auto-increment on
+
+    imm     ra      0xC0            ; write colour 0
+    imm     rb      0xD0
+
+.gradient:
+    cpy     rdis    ra              ; one signal per pixel, the cursor moves itself
+    iadd    ra      ra      0x01
+    cmp     ra      rb
+    jmpz    .gradient_end
+    jmp     .gradient
+
+.gradient_end:
+    imm     rdis    0x02            ; auto-increment off
+
+
+    imm     ra      0x00
+    ldrl    ra      rbp     ra
+    iadd    ra      ra      0x01
+    imm     rc      0x00
+    strla   rbp     rc              ; store frame count + 1
+
+    jmp     .loop
@@ -80,6 +80,53 @@ std_shr:                            ; right shift of ra by rb bits
     ret
 
 
+#ifdef STDLIB_DMA                   ; define before the include to copy and fill with rdma
+
+std_memset:                         ; memset of ra, rb bytes from addr
+    push    rc
+    imm     rc      0x00
+
+    cpy     rddb    rbnk
+    cpy     rdda    radr
+    cpy     rdsa    ra              ; fill value
+    cpy     rdln    rb
+    imm     rdma    0x01            ; start a fill
+
+.wait:
+    cmp     rdma    rc              ; busy until the bytes are written
+    jmpz    .end
+    jmp     .wait
+
+.end:
+    imm     rb      0x00            ; as left by the loop
+    pop     rc
+
+    ret
+
+
+std_memcpy:                         ; memcpy of ra bytes, from addr to rb
+    push    rc
+    imm     rc      0x00
+
+    cpy     rdsb    rbnk
+    cpy     rdsa    radr
+    cpy     rddb    rbnk
+    cpy     rdda    rb
+    cpy     rdln    ra
+    imm     rdma    0x00            ; start a copy
+
+.wait:
+    cmp     rdma    rc
+    jmpz    .end
+    jmp     .wait
+
+.end:
+    pop     rc
+
+    ret
+
+#else
+
 std_memset:                         ; memset of ra, rb bytes from addr
     push    radr
     push    rc
@@ -131,6 +178,8 @@ std_memcpy:                         ; memcpy of ra bytes, from addr to rb
     
     ret
 
+#endif
+
 
 std_memcmp:                         ; memcmp of ra bytes, starting at addr and rb
     push    rc
@@ -1,5 +1,10 @@
     ; --- video / display extension ---
 
+stdv_wait_frame:                    ; ()
+    vsync                           ; halt until the next frame starts
+    ret
+
+
 stdv_draw_pixel:                    ; (x, y, colour)
     push    rc
 
@@ -11,27 +16,62 @@ stdv_draw_pixel:                    ; (x, y, colour)
     nand    rb      rb      rc
     nand    rb      rb      rb      ; bitwise and y cursor
 
-    imm     rc      0x40            ; cursor x opcode
-    
-    push    ra
-    nand    rc      rc      rc
-    nand    ra      ra      ra
-    nand    rc      ra      rc      ; rc = ra | rc
-    pop     ra
+    iadd    rdis    ra      0x40    ; set cursor x to ra (no carry into the opcode bits)
+    iadd    rdis    rb      0x80    ; set cursor y to rb
 
-    cpy     rdis    rc              ; set cursor x to ra
+    pop     rc
+    cpy     rdis    rc              ; set pixel colour
 
-    imm     rc      0x80            ; cursor y opcode
-    
-    push    rb
-    nand    rc      rc      rc
-    nand    rb      rb      rb
-    nand    rc      rb      rc      ; rc = rb | rc
-    pop     rb
+    ret
+
+
+stdv_clear:                         ; (colour) - whole screen in one signal
+    iadd    rdis    ra      0x30
+
+    ret
+
+
+stdv_hline:                         ; (x0, x1, y) colour pushed by the caller - both ends drawn
+    push    rc
+    push    rbnk
 
-    cpy     rdis    rc              ; set cursor y to rb
+    iadd    rdis    ra      0x40    ; cursor to (x0, y)
+    iadd    rdis    rc      0x80
+    imm     rdis    0x04            ; anchor there
+    iadd    rdis    rb      0x40    ; cursor x to x1
 
+    imm     rbnk    0xFF
+    imm     rc      0xFC
+    ldrl    rc      rbp     rc      ; load colour from the caller's stack
+
+    iadd    rdis    rc      0x10    ; span fill
+
+    pop     rbnk
     pop     rc
-    cpy     rdis    rc              ; set pixel colour
+    ret
+
+
+stdv_fill_rect:                     ; (x0, y0, x1) y1 then colour pushed by the caller - corners drawn
+    push    rc
+    push    rbnk
 
+    iadd    rdis    ra      0x40    ; cursor to (x0, y0)
+    iadd    rdis    rb      0x80
+    imm     rdis    0x04            ; anchor there
+    iadd    rdis    rc      0x40    ; cursor x to x1
+
+    imm     rbnk    0xFF
+    imm     rc      0xFB
+    ldrl    rc      rbp     rc      ; load y1 from the caller's stack
+
+    iadd    rdis    rc      0x80    ; cursor y to y1
+
+    imm     rc      0xFC
+    ldrl    rc      rbp     rc      ; load colour from the caller's stack
+
+    iadd    rdis    rc      0x20    ; rectangle fill
+
+    pop     rbnk
+    pop     rc
     ret
+